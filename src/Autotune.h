@@ -0,0 +1,212 @@
+/*
+ * Filename: Autotune.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a startup autotuner that benchmarks the ways MLPNetwork can score many rows on the
+ * current machine, picks the fastest and caches the choice in a local file keyed by CPU model, compute backend and topology.
+ */
+
+#ifndef Autotune_h
+#define Autotune_h
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+
+#include "Network.h"
+#include "ThreadPool.h"
+
+#define AUTOTUNE_CACHE "autotune.cache"
+
+using namespace std;
+
+enum KERNEL {KERNEL_GEMV, KERNEL_GEMM, KERNEL_SMALL};
+
+//how to score a block of rows: which forward pass, how many rows per call and how many threads
+struct ExecutionConfig{
+    KERNEL kernel;
+    int batch_size;
+    int num_threads;
+    double ns_per_row; //measured when the config was tuned
+
+    ExecutionConfig(KERNEL kernel=KERNEL_GEMM, int batch_size=64, int num_threads=1, double ns_per_row=0){
+        this->kernel=kernel;
+        this->batch_size=batch_size;
+        this->num_threads=num_threads;
+        this->ns_per_row=ns_per_row;
+    }
+
+    static string kernel_name(KERNEL kernel){
+        switch(kernel){
+            case KERNEL_GEMV: return "gemv";
+            case KERNEL_GEMM: return "gemm";
+            case KERNEL_SMALL: return "small";
+        }
+        return "unknown";
+    }
+
+    string describe() const {
+        ostringstream os;
+        os<<kernel_name(kernel)<<" batch "<<batch_size<<" threads "<<num_threads<<" ("<<ns_per_row<<" ns/row)";
+        return os.str();
+    }
+};
+
+class Autotuner{
+
+private:
+
+    //a benchmark run does about BENCH_WORK multiply-adds, but never fewer rows than the biggest candidate batch
+    static const long BENCH_WORK = 1L<<24;
+    static const int BENCH_MIN_ROWS = 512;
+    static const int BENCH_MAX_ROWS = 4096;
+    static const int BENCH_REPEATS = 3;
+
+    static long bench_rows(const MLPNetwork& net){
+        long work_per_row=0;
+        for(int i=0;i<net.get_num_layers()-1;i++) work_per_row += (long)net.get_sizes()[i]*net.get_sizes()[i+1];
+        return min((long)BENCH_MAX_ROWS, max((long)BENCH_MIN_ROWS, BENCH_WORK/max(1L, work_per_row)));
+    }
+
+    static double time_config(const MLPNetwork& net, const ExecutionConfig& config, const vector<double>& inputs, vector<double>& outputs){
+        long rows = (long)(inputs.size()/net.get_input_size());
+        run(net, config, inputs.data(), rows, outputs.data()); //warm up caches and the workspaces
+        double best = numeric_limits<double>::infinity();
+        for(int rep=0;rep<BENCH_REPEATS;rep++){
+            auto start = chrono::steady_clock::now();
+            run(net, config, inputs.data(), rows, outputs.data());
+            best = min(best, chrono::duration<double, nano>(chrono::steady_clock::now()-start).count()/rows);
+        }
+        return best;
+    }
+
+    //scores rows [begin, end) on the calling thread
+    static void run_range(const MLPNetwork& net, const ExecutionConfig& config, const double* inputs, long begin, long end, double* outputs){
+        int in_size = net.get_input_size(), out_size = net.get_output_size();
+        MLPNetwork::Workspace& ws = net.local_workspace(config.batch_size);
+        if(config.kernel==KERNEL_GEMV){
+            for(long r=begin;r<end;r++){
+                const double* out = net.forward(inputs+r*in_size, ws);
+                memcpy(outputs+r*out_size, out, sizeof(double)*out_size);
+            }
+            return;
+        }
+        for(long r=begin;r<end;r+=config.batch_size){
+            int n = (int)min((long)config.batch_size, end-r);
+            if(config.kernel==KERNEL_SMALL) net.forward_small(inputs+r*in_size, n, outputs+r*out_size, ws);
+            else net.forward_batch(inputs+r*in_size, n, outputs+r*out_size, ws);
+        }
+    }
+
+public:
+
+    //the "model name" line of /proc/cpuinfo, spaces replaced so it can be used in a cache key
+    static string cpu_model(){
+        ifstream cpuinfo("/proc/cpuinfo");
+        string line, model="unknown";
+        while(getline(cpuinfo, line)){
+            if(line.compare(0, 10, "model name")==0 && line.find(':')!=string::npos){
+                model = line.substr(line.find(':')+1);
+                break;
+            }
+        }
+        model.erase(0, model.find_first_not_of(' '));
+        replace(model.begin(), model.end(), ' ', '_');
+        return model;
+    }
+
+    //cpu model, compute backend, hardware threads, thread limit, activation and layer sizes, the backend because the same
+    //machine ranks the kernels differently under mkl, cblas and native
+    static string cache_key(const MLPNetwork& net, int max_threads){
+        ostringstream os;
+        os<<cpu_model()<<"/"<<Backend::name()<<"/"<<thread::hardware_concurrency()<<"/"<<max_threads<<"/"<<net.get_activation()<<"/";
+        for(int i=0;i<net.get_num_layers();i++) os<<(i ? "-" : "")<<net.get_sizes()[i];
+        return os.str();
+    }
+
+    //scores num_rows contiguous input vectors into contiguous output vectors the way config says
+    //threads come from the shared pool, whose workers keep their workspaces from batch to batch, and every range
+    //starts on a batch boundary
+    static void run(const MLPNetwork& net, const ExecutionConfig& config, const double* inputs, long num_rows, double* outputs){
+        int num_threads = (int)min((long)config.num_threads, max(1L, num_rows/config.batch_size));
+        if(num_threads<=1){
+            run_range(net, config, inputs, 0, num_rows, outputs);
+            return;
+        }
+        ThreadPool::shared(num_threads).parallel_for(num_rows, [&net, &config, inputs, outputs](long begin, long end){
+            run_range(net, config, inputs, begin, end, outputs);
+        }, config.batch_size, num_threads);
+    }
+
+    //benchmarks every candidate on random inputs and returns the fastest, max_threads=0 allows every hardware thread
+    static ExecutionConfig benchmark(const MLPNetwork& net, int max_threads=0, bool verbose=false){
+
+        int hardware = max(1, (int)thread::hardware_concurrency());
+        if(max_threads<=0 || max_threads>hardware) max_threads = hardware;
+
+        mt19937 rng(420);
+        normal_distribution<double> dist(0, 1);
+        long rows = bench_rows(net);
+        vector<double> inputs(rows*net.get_input_size()), outputs(rows*net.get_output_size());
+        for(double& x : inputs) x = dist(rng);
+
+        vector<int> thread_counts;
+        for(int t=1;t<max_threads;t*=2) thread_counts.push_back(t);
+        thread_counts.push_back(max_threads);
+
+        vector<ExecutionConfig> candidates;
+        for(int t : thread_counts){
+            candidates.push_back(ExecutionConfig(KERNEL_GEMV, 1, t));
+            for(int b : {1, 8, 32}) candidates.push_back(ExecutionConfig(KERNEL_SMALL, b, t));
+            for(int b : {8, 32, 128, 512}) candidates.push_back(ExecutionConfig(KERNEL_GEMM, b, t));
+        }
+
+        ExecutionConfig best;
+        best.ns_per_row = numeric_limits<double>::infinity();
+        for(ExecutionConfig& c : candidates){
+            c.ns_per_row = time_config(net, c, inputs, outputs);
+            if(verbose) cerr<<"autotune: "<<c.describe()<<endl;
+            if(c.ns_per_row<best.ns_per_row) best=c;
+        }
+        return best;
+    }
+
+    //returns the cached config for this machine and topology, or benchmarks and appends the winner to cache_file
+    static ExecutionConfig tune(const MLPNetwork& net, string cache_file=AUTOTUNE_CACHE, int max_threads=0, bool verbose=false){
+
+        string key = cache_key(net, max_threads);
+
+        ifstream inFile(cache_file.c_str());
+        string line;
+        while(getline(inFile, line)){
+            istringstream is(line);
+            string cached_key;
+            int kernel;
+            ExecutionConfig config;
+            if(is>>cached_key>>kernel>>config.batch_size>>config.num_threads>>config.ns_per_row && cached_key==key){
+                config.kernel = (KERNEL)kernel;
+                if(verbose) cerr<<"autotune: cached "<<config.describe()<<endl;
+                return config;
+            }
+        }
+        inFile.close();
+
+        ExecutionConfig config = benchmark(net, max_threads, verbose);
+        ofstream outFile(cache_file.c_str(), ios::app);
+        if(!outFile) cerr<<"unable to write autotune cache: "<<cache_file<<endl;
+        else outFile<<key<<" "<<(int)config.kernel<<" "<<config.batch_size<<" "<<config.num_threads<<" "<<config.ns_per_row<<endl;
+        if(verbose) cerr<<"autotune: picked "<<config.describe()<<endl;
+        return config;
+    }
+};
+
+#endif /* Autotune_h */
@@ -0,0 +1,284 @@
+/*
+ * Filename: Backend.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains the compute backend every other file calls for aligned memory and the dense linear
+ * algebra and vector math kernels, so the library can be built against MKL, any CBLAS or its own portable kernels.
+ */
+
+#ifndef Backend_h
+#define Backend_h
+
+#ifndef DATA_ALIGNMENT
+#define DATA_ALIGNMENT 64
+#endif
+
+#include <cstdlib>
+#include <cstddef>
+#include <cmath>
+
+/*
+ * The backend is picked at build time (BACKEND in the Makefile):
+ *   default         Intel MKL
+ *   BACKEND_CBLAS   any CBLAS implementation (OpenBLAS, BLIS, Accelerate, ...) for the BLAS calls
+ *   BACKEND_NATIVE  the self contained kernels below, vectorized by the compiler (build with -fopenmp-simd)
+ */
+#if defined(BACKEND_CBLAS)
+#include <cblas.h>
+#elif !defined(BACKEND_NATIVE)
+#define BACKEND_MKL
+#include <mkl.h>
+#endif
+
+/*
+ * Every matrix is row major and every vector contiguous, the only layout the library uses.
+ * beta==0 never reads the output, like BLAS, so outputs can start out uninitialized.
+ */
+class Backend{
+
+public:
+
+    enum Transpose {NoTrans, Trans};
+
+#if defined(BACKEND_MKL)
+
+    static const char* name(){return "mkl";}
+
+    static void* aligned_malloc(size_t bytes, int alignment=DATA_ALIGNMENT){return MKL_malloc(bytes, alignment);}
+    static void aligned_free(void* p){MKL_free(p);}
+
+    //A is m x n, y = alpha op(A) x + beta y
+    static void gemv(Transpose trans, int m, int n, double alpha, const double* A, int lda, const double* x, double beta, double* y){
+        cblas_dgemv(CblasRowMajor, trans==Trans ? CblasTrans : CblasNoTrans, m, n, alpha, A, lda, x, 1, beta, y, 1);
+    }
+
+    //C (m x n) = alpha op(A) op(B) + beta C, op(A) is m x k and op(B) is k x n
+    static void gemm(Transpose trans_a, Transpose trans_b, int m, int n, int k, double alpha, const double* A, int lda,
+                     const double* B, int ldb, double beta, double* C, int ldc){
+        cblas_dgemm(CblasRowMajor, trans_a==Trans ? CblasTrans : CblasNoTrans, trans_b==Trans ? CblasTrans : CblasNoTrans,
+                    m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+    }
+
+    //A (m x n) += alpha x y^T
+    static void ger(int m, int n, double alpha, const double* x, const double* y, double* A, int lda){
+        cblas_dger(CblasRowMajor, m, n, alpha, x, 1, y, 1, A, lda);
+    }
+
+    static void axpy(int n, double alpha, const double* x, double* y){cblas_daxpy(n, alpha, x, 1, y, 1);}
+
+    static void tanh(int n, const double* a, double* r){vdTanh(n, a, r);}
+
+    //threads MKL may use for calls from this thread, returns the previous setting
+    static int set_num_threads_local(int n){return mkl_set_num_threads_local(n);}
+
+#else
+
+    static void* aligned_malloc(size_t bytes, int alignment=DATA_ALIGNMENT){
+        void* p = NULL;
+        if(posix_memalign(&p, alignment, bytes>0 ? bytes : alignment)!=0) return NULL;
+        return p;
+    }
+    static void aligned_free(void* p){free(p);}
+
+    static void tanh(int n, const double* a, double* r){
+        for(int i=0;i<n;i++) r[i] = std::tanh(a[i]);
+    }
+
+    //only MKL has per thread control, other backends keep their own threading
+    static int set_num_threads_local(int /*n*/){return 0;}
+
+#if defined(BACKEND_CBLAS)
+
+    static const char* name(){return "cblas";}
+
+    static void gemv(Transpose trans, int m, int n, double alpha, const double* A, int lda, const double* x, double beta, double* y){
+        cblas_dgemv(CblasRowMajor, trans==Trans ? CblasTrans : CblasNoTrans, m, n, alpha, A, lda, x, 1, beta, y, 1);
+    }
+
+    static void gemm(Transpose trans_a, Transpose trans_b, int m, int n, int k, double alpha, const double* A, int lda,
+                     const double* B, int ldb, double beta, double* C, int ldc){
+        cblas_dgemm(CblasRowMajor, trans_a==Trans ? CblasTrans : CblasNoTrans, trans_b==Trans ? CblasTrans : CblasNoTrans,
+                    m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+    }
+
+    static void ger(int m, int n, double alpha, const double* x, const double* y, double* A, int lda){
+        cblas_dger(CblasRowMajor, m, n, alpha, x, 1, y, 1, A, lda);
+    }
+
+    static void axpy(int n, double alpha, const double* x, double* y){cblas_daxpy(n, alpha, x, 1, y, 1);}
+
+#else
+
+private:
+
+    //alpha*sum + beta*y without reading y when beta is 0
+    static double scale(double alpha, double sum, double beta, double y){
+        return beta==0 ? alpha*sum : alpha*sum + beta*y;
+    }
+
+    static double dot(int n, const double* __restrict a, const double* __restrict b){
+        double sum=0;
+        #pragma omp simd reduction(+:sum)
+        for(int k=0;k<n;k++) sum+=a[k]*b[k];
+        return sum;
+    }
+
+public:
+
+    static const char* name(){return "native";}
+
+    static void gemv(Transpose trans, int m, int n, double alpha, const double* A, int lda, const double* x, double beta, double* y){
+        if(trans==NoTrans){
+            //four rows at a time so every load of x feeds four multiply-adds
+            int i=0;
+            for(;i+4<=m;i+=4){
+                const double* __restrict a0 = A+(long)i*lda;
+                const double* __restrict a1 = a0+lda;
+                const double* __restrict a2 = a1+lda;
+                const double* __restrict a3 = a2+lda;
+                double s0=0, s1=0, s2=0, s3=0;
+                #pragma omp simd reduction(+:s0,s1,s2,s3)
+                for(int k=0;k<n;k++){
+                    s0+=a0[k]*x[k];
+                    s1+=a1[k]*x[k];
+                    s2+=a2[k]*x[k];
+                    s3+=a3[k]*x[k];
+                }
+                y[i]=scale(alpha, s0, beta, y[i]);
+                y[i+1]=scale(alpha, s1, beta, y[i+1]);
+                y[i+2]=scale(alpha, s2, beta, y[i+2]);
+                y[i+3]=scale(alpha, s3, beta, y[i+3]);
+            }
+            for(;i<m;i++) y[i]=scale(alpha, dot(n, A+(long)i*lda, x), beta, y[i]);
+            return;
+        }
+        //y (n) = alpha A^T x + beta y, one scaled row of A added at a time
+        for(int j=0;j<n;j++) y[j] = beta==0 ? 0 : beta*y[j];
+        for(int i=0;i<m;i++) axpy(n, alpha*x[i], A+(long)i*lda, y);
+    }
+
+    static void gemm(Transpose trans_a, Transpose trans_b, int m, int n, int k, double alpha, const double* A, int lda,
+                     const double* B, int ldb, double beta, double* C, int ldc){
+        if(trans_a==NoTrans && trans_b==Trans){
+            //C[i][j] is the dot product of row i of A and row j of B, 2x4 blocks of them share their loads
+            int i=0;
+            for(;i+2<=m;i+=2){
+                const double* __restrict a0 = A+(long)i*lda;
+                const double* __restrict a1 = a0+lda;
+                int j=0;
+                for(;j+4<=n;j+=4){
+                    const double* __restrict b0 = B+(long)j*ldb;
+                    const double* __restrict b1 = b0+ldb;
+                    const double* __restrict b2 = b1+ldb;
+                    const double* __restrict b3 = b2+ldb;
+                    double s00=0, s01=0, s02=0, s03=0, s10=0, s11=0, s12=0, s13=0;
+                    #pragma omp simd reduction(+:s00,s01,s02,s03,s10,s11,s12,s13)
+                    for(int p=0;p<k;p++){
+                        s00+=a0[p]*b0[p];
+                        s01+=a0[p]*b1[p];
+                        s02+=a0[p]*b2[p];
+                        s03+=a0[p]*b3[p];
+                        s10+=a1[p]*b0[p];
+                        s11+=a1[p]*b1[p];
+                        s12+=a1[p]*b2[p];
+                        s13+=a1[p]*b3[p];
+                    }
+                    double* c0 = C+(long)i*ldc+j;
+                    double* c1 = c0+ldc;
+                    c0[0]=scale(alpha, s00, beta, c0[0]);
+                    c0[1]=scale(alpha, s01, beta, c0[1]);
+                    c0[2]=scale(alpha, s02, beta, c0[2]);
+                    c0[3]=scale(alpha, s03, beta, c0[3]);
+                    c1[0]=scale(alpha, s10, beta, c1[0]);
+                    c1[1]=scale(alpha, s11, beta, c1[1]);
+                    c1[2]=scale(alpha, s12, beta, c1[2]);
+                    c1[3]=scale(alpha, s13, beta, c1[3]);
+                }
+                for(;j<n;j++){
+                    const double* b = B+(long)j*ldb;
+                    C[(long)i*ldc+j] = scale(alpha, dot(k, a0, b), beta, C[(long)i*ldc+j]);
+                    C[(long)(i+1)*ldc+j] = scale(alpha, dot(k, a1, b), beta, C[(long)(i+1)*ldc+j]);
+                }
+            }
+            for(;i<m;i++) gemv(NoTrans, n, k, alpha, B, ldb, A+(long)i*lda, beta, C+(long)i*ldc);
+            return;
+        }
+        //the library only multiplies by transposed weights, the other forms are plain loops
+        for(int i=0;i<m;i++){
+            for(int j=0;j<n;j++){
+                double sum=0;
+                for(int p=0;p<k;p++){
+                    double a = trans_a==NoTrans ? A[(long)i*lda+p] : A[(long)p*lda+i];
+                    double b = trans_b==NoTrans ? B[(long)p*ldb+j] : B[(long)j*ldb+p];
+                    sum+=a*b;
+                }
+                C[(long)i*ldc+j] = scale(alpha, sum, beta, C[(long)i*ldc+j]);
+            }
+        }
+    }
+
+    static void ger(int m, int n, double alpha, const double* x, const double* y, double* A, int lda){
+        for(int i=0;i<m;i++) axpy(n, alpha*x[i], y, A+(long)i*lda);
+    }
+
+    static void axpy(int n, double alpha, const double* __restrict x, double* __restrict y){
+        #pragma omp simd
+        for(int k=0;k<n;k++) y[k]+=alpha*x[k];
+    }
+
+#endif
+#endif
+
+    /*
+     * y (n) = A^T x with the A from before the call, then A (m x n) += alpha x z^T: the backward step of a connection in
+     * one pass over A instead of a gemv over it followed by a ger. A is walked in column tiles narrow enough that the
+     * tiles of y and z stay in L1, four rows at a time so each element of y is loaded and stored once per four rows.
+     * The rows are added to y in order, so y is the same as from the native gemv.
+     */
+    static void gemv_trans_ger(int m, int n, double alpha, const double* x, double* __restrict y, const double* __restrict z,
+                               double* A, int lda){
+        const int tile = 256;
+        for(int k0=0;k0<n;k0+=tile){
+            int width = n-k0<tile ? n-k0 : tile;
+            double* __restrict yt = y+k0;
+            const double* __restrict zt = z+k0;
+            for(int k=0;k<width;k++) yt[k]=0;
+            int i=0;
+            for(;i+4<=m;i+=4){
+                double* __restrict a0 = A+(long)i*lda+k0;
+                double* __restrict a1 = a0+lda;
+                double* __restrict a2 = a1+lda;
+                double* __restrict a3 = a2+lda;
+                double x0=x[i], x1=x[i+1], x2=x[i+2], x3=x[i+3];
+                double b0=alpha*x0, b1=alpha*x1, b2=alpha*x2, b3=alpha*x3;
+                #pragma omp simd
+                for(int k=0;k<width;k++){
+                    double w0=a0[k], w1=a1[k], w2=a2[k], w3=a3[k];
+                    double acc=yt[k];
+                    acc+=x0*w0;
+                    acc+=x1*w1;
+                    acc+=x2*w2;
+                    acc+=x3*w3;
+                    yt[k]=acc;
+                    a0[k]=w0+b0*zt[k];
+                    a1[k]=w1+b1*zt[k];
+                    a2[k]=w2+b2*zt[k];
+                    a3[k]=w3+b3*zt[k];
+                }
+            }
+            for(;i<m;i++){
+                double* __restrict a = A+(long)i*lda+k0;
+                double xi=x[i], bi=alpha*x[i];
+                #pragma omp simd
+                for(int k=0;k<width;k++){
+                    double w=a[k];
+                    yt[k]+=xi*w;
+                    a[k]=w+bi*zt[k];
+                }
+            }
+        }
+    }
+};
+
+#endif /* Backend_h */
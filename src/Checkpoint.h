@@ -0,0 +1,259 @@
+/*
+ * Filename: Checkpoint.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains the training state saved by cross_validate and a checkpointer that writes it to disk
+ * on a background thread, so a long run can be resumed where its last completed checkpoint left off.
+ */
+
+#ifndef Checkpoint_h
+#define Checkpoint_h
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <streambuf>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+
+#define CHECKPOINT_MAGIC "FNC1"
+
+using namespace std;
+
+//everything cross_validate needs to continue a run: the next fold and epoch to run, the epoch ordering of that fold,
+//the scores of the folds that are done and the network as written by save
+struct TrainingState{
+    int32_t num_folds;
+    int32_t random_state;
+    int32_t num_epochs;
+    int32_t fold;
+    int32_t epoch;
+    double train_time;  //nanoseconds spent training so far
+    string rng;         //CounterRNG::name(), the orderings themselves are keyed by (seed, purpose, fold, epoch)
+    vector<long> train_rows;
+    map<string, double> scores;
+    vector<char> model;
+};
+
+//streambuf appending to a vector<char>, so a snapshot can reuse the capacity of the previous one
+class VectorStreamBuf : public streambuf{
+
+private:
+    vector<char>& out;
+
+protected:
+    int_type overflow(int_type c) override {
+        if(c!=traits_type::eof()) out.push_back((char)c);
+        return c;
+    }
+
+    streamsize xsputn(const char* s, streamsize n) override {
+        out.insert(out.end(), s, s+n);
+        return n;
+    }
+
+public:
+    VectorStreamBuf(vector<char>& out) : out(out) {}
+};
+
+/*
+ * Two TrainingState buffers: the trainer fills one with begin_snapshot() and hands it over with commit_snapshot(), the writer
+ * thread writes the other to path.tmp, fsyncs it and renames it over path, so path always holds a complete checkpoint.
+ * If the trainer commits again before the writer got to the previous snapshot, the newer snapshot replaces it.
+ */
+class Checkpointer{
+
+private:
+    string path;
+    int every_epochs;
+
+    TrainingState buffers[2];
+    int pending;    //buffer committed but not yet picked up by the writer, -1 if none
+    int in_flight;  //buffer being written, -1 if none
+    bool stopping;
+    long written;
+    mutex m;
+    condition_variable cv;
+    thread writer;
+
+    static void put(vector<char>& out, const void* p, size_t n){
+        const char* c = (const char*)p;
+        out.insert(out.end(), c, c+n);
+    }
+
+    static bool get(const vector<char>& in, size_t& pos, void* p, size_t n){
+        if(pos+n>in.size()) return false;
+        memcpy(p, in.data()+pos, n);
+        pos+=n;
+        return true;
+    }
+
+    static void serialize(const TrainingState& s, vector<char>& out){
+        out.clear();
+        put(out, CHECKPOINT_MAGIC, 4);
+        int32_t header[5] = {s.num_folds, s.random_state, s.num_epochs, s.fold, s.epoch};
+        put(out, header, sizeof(header));
+        put(out, &s.train_time, sizeof(double));
+        int64_t n = (int64_t)s.rng.size();
+        put(out, &n, sizeof(n));
+        put(out, s.rng.data(), s.rng.size());
+        n = (int64_t)s.train_rows.size();
+        put(out, &n, sizeof(n));
+        put(out, s.train_rows.data(), sizeof(long)*s.train_rows.size());
+        n = (int64_t)s.scores.size();
+        put(out, &n, sizeof(n));
+        for(const auto& pair : s.scores){
+            int64_t len = (int64_t)pair.first.size();
+            put(out, &len, sizeof(len));
+            put(out, pair.first.data(), pair.first.size());
+            put(out, &pair.second, sizeof(double));
+        }
+        n = (int64_t)s.model.size();
+        put(out, &n, sizeof(n));
+        put(out, s.model.data(), s.model.size());
+    }
+
+    static bool deserialize(const vector<char>& in, TrainingState& s){
+        size_t pos=0;
+        char magic[4];
+        int32_t header[5];
+        int64_t n;
+        if(!get(in, pos, magic, 4) || memcmp(magic, CHECKPOINT_MAGIC, 4)!=0) return false;
+        if(!get(in, pos, header, sizeof(header)) || !get(in, pos, &s.train_time, sizeof(double))) return false;
+        s.num_folds=header[0];
+        s.random_state=header[1];
+        s.num_epochs=header[2];
+        s.fold=header[3];
+        s.epoch=header[4];
+        if(!get(in, pos, &n, sizeof(n)) || n<0 || pos+n>in.size()) return false;
+        s.rng.assign(in.data()+pos, n);
+        pos+=n;
+        if(!get(in, pos, &n, sizeof(n)) || n<0 || pos+n*sizeof(long)>in.size()) return false;
+        s.train_rows.resize(n);
+        get(in, pos, s.train_rows.data(), sizeof(long)*n);
+        if(!get(in, pos, &n, sizeof(n)) || n<0) return false;
+        s.scores.clear();
+        for(int64_t i=0;i<n;i++){
+            int64_t len;
+            double value;
+            if(!get(in, pos, &len, sizeof(len)) || len<0 || pos+len>in.size()) return false;
+            string key(in.data()+pos, len);
+            pos+=len;
+            if(!get(in, pos, &value, sizeof(double))) return false;
+            s.scores[key]=value;
+        }
+        if(!get(in, pos, &n, sizeof(n)) || n<0 || pos+n>in.size()) return false;
+        s.model.assign(in.data()+pos, in.data()+pos+n);
+        return pos+n==in.size();
+    }
+
+    bool write_file(const vector<char>& bytes){
+        string tmp = path+".tmp";
+        FILE* f = fopen(tmp.c_str(), "wb");
+        if(f==NULL) return false;
+        bool ok = fwrite(bytes.data(), 1, bytes.size(), f)==bytes.size() && fflush(f)==0 && fsync(fileno(f))==0;
+        ok = fclose(f)==0 && ok;
+        return ok && rename(tmp.c_str(), path.c_str())==0;
+    }
+
+    void write_loop(){
+        vector<char> bytes;
+        unique_lock<mutex> lock(m);
+        while(true){
+            cv.wait(lock, [this]{return pending>=0 || stopping;});
+            if(pending<0) break;
+            in_flight=pending;
+            pending=-1;
+            lock.unlock();
+
+            serialize(buffers[in_flight], bytes);
+            if(!write_file(bytes)) cerr<<"Error. Unable to write checkpoint "<<path<<endl;
+
+            lock.lock();
+            in_flight=-1;
+            written++;
+            cv.notify_all();
+        }
+    }
+
+public:
+
+    //checkpoints to path after every every_epochs epochs and after every fold
+    Checkpointer(string path, int every_epochs=1){
+        this->path=path;
+        this->every_epochs = every_epochs<1 ? 1 : every_epochs;
+        pending=-1;
+        in_flight=-1;
+        stopping=false;
+        written=0;
+        writer = thread(&Checkpointer::write_loop, this);
+    }
+
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator=(const Checkpointer&) = delete;
+
+    string get_path() const {return path;}
+    int get_every_epochs() const {return every_epochs;}
+    long get_written() {
+        lock_guard<mutex> lock(m);
+        return written;
+    }
+
+    //the buffer to fill for the next snapshot, never the one the writer is working on
+    TrainingState& begin_snapshot(){
+        lock_guard<mutex> lock(m);
+        int free_buffer = (in_flight==0) ? 1 : 0;
+        if(pending==free_buffer) pending=-1; //replaced by the snapshot about to be filled
+        return buffers[free_buffer];
+    }
+
+    //hands the buffer returned by begin_snapshot to the writer thread and returns right away
+    void commit_snapshot(const TrainingState& state){
+        {
+            lock_guard<mutex> lock(m);
+            pending = (int)(&state-buffers);
+        }
+        cv.notify_all();
+    }
+
+    //blocks until every committed snapshot is on disk
+    void wait(){
+        unique_lock<mutex> lock(m);
+        cv.wait(lock, [this]{return pending<0 && in_flight<0;});
+    }
+
+    //reads the last completed checkpoint, false if there is none
+    bool load(TrainingState& state){
+        FILE* f = fopen(path.c_str(), "rb");
+        if(f==NULL) return false;
+        vector<char> bytes;
+        char chunk[1<<16];
+        size_t n;
+        while((n=fread(chunk, 1, sizeof(chunk), f))>0) bytes.insert(bytes.end(), chunk, chunk+n);
+        fclose(f);
+        if(!deserialize(bytes, state)){
+            cerr<<"Error. "<<path<<" is not a complete checkpoint\n";
+            throw invalid_argument("invalid checkpoint file\n");
+        }
+        return true;
+    }
+
+    ~Checkpointer(){
+        {
+            lock_guard<mutex> lock(m);
+            stopping=true;
+        }
+        cv.notify_all();
+        writer.join();
+    }
+};
+
+#endif /* Checkpoint_h */
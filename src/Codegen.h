@@ -0,0 +1,269 @@
+/*
+ * Filename: Codegen.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains an exporter that writes a trained MLP network, the encoding of its ARFF attributes and
+ * its input normalization out as a standalone C++ header for scoring rows without this library or a BLAS.
+ */
+
+#ifndef Codegen_h
+#define Codegen_h
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include "Network.h"
+
+using namespace std;
+
+/*
+ * The generated header defines a namespace with the (transposed) weights and biases as constexpr aligned arrays, one call
+ * per layer to a kernel whose sizes are template arguments (so the compiler unrolls and vectorizes it for exactly this topology),
+ * the activation inlined, and the encoding of every attribute baked in. Nothing is allocated: the layers live on the stack.
+ *   void forward(const double* input, double* output)    encoded, normalized input -> output layer
+ *   int classify_index(const double* input)               most probable class
+ *   const char* classify(const double* input)
+ *   double predict(const double* input)                   regression value
+ *   void encode(const char* const* values, double* input) raw text of every non-class attribute in header order ("?" if missing)
+ *   const char* classify_row(const char* const* values) / double predict_row(const char* const* values)
+ * Weights are written with 17 significant digits, so they are exactly the trained ones. The outputs match
+ * MLPNetwork::forward up to the order of the floating point additions, which the BLAS kernels are free to pick.
+ */
+class ModelExporter{
+
+private:
+
+    static string literal(double x){
+        if(isnan(x)) return "NAN";
+        if(isinf(x)) return x>0 ? "INFINITY" : "-INFINITY";
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.17g", x);
+        string s(buf);
+        if(s.find_first_of(".en")==string::npos) s+=".0";
+        return s;
+    }
+
+    static string quoted(const string& s){
+        string out = "\"";
+        for(char c : s){
+            if(c=='"' || c=='\\') out+='\\';
+            out+=c;
+        }
+        return out+"\"";
+    }
+
+    static void write_array(ostream& os, const string& name, const double* values, long n){
+        os<<"alignas(64) constexpr double "<<name<<"["<<n<<"] = {";
+        for(long i=0;i<n;i++){
+            if(i%8==0) os<<"\n    ";
+            os<<literal(values[i])<<(i+1<n ? ", " : "");
+        }
+        os<<"\n};\n\n";
+    }
+
+    static string activation_expr(Network::ACTIVATION activation){
+        switch(activation){
+            case Network::LOGISTIC: return "1/(1+std::exp(-1*x))";
+            case Network::TANH: return "std::tanh(x)";
+            default: return "std::fmax(0, x)";
+        }
+    }
+
+public:
+
+    //norm is the normalization the network was trained with (ARFFDataset::getNormalization), it may be empty
+    static void write_header(const MLPNetwork& net, ARFFMetaData& meta, const NormalizationStats& norm, const string& name, ostream& os){
+
+        const vector<int>& sizes = net.get_sizes();
+        int num_layers = net.get_num_layers();
+        bool classification = sizes.back()>1;
+        if(meta.get_input_layer_size()!=sizes.front() || meta.get_output_layer_size()!=sizes.back()){
+            cerr<<"Error. Network layout does not match the metadata given to ModelExporter\n";
+            throw invalid_argument("invalid network architecture\n");
+        }
+        string guard = name;
+        transform(guard.begin(), guard.end(), guard.begin(), ::toupper);
+
+        os<<"/*\n * Generated by ModelExporter from the "<<meta.getRelation()<<" network ";
+        for(int i=0;i<num_layers;i++) os<<sizes[i]<<(i+1<num_layers ? "-" : "");
+        os<<", do not edit.\n */\n\n";
+        os<<"#ifndef "<<guard<<"_MODEL_H\n#define "<<guard<<"_MODEL_H\n\n";
+        os<<"#include <cmath>\n#include <cstdint>\n#include <cstdlib>\n#include <cstring>\n\n";
+        os<<"namespace "<<name<<"{\n\n";
+        os<<"constexpr int INPUT_SIZE = "<<sizes.front()<<";\n";
+        os<<"constexpr int OUTPUT_SIZE = "<<sizes.back()<<";\n\n";
+
+        for(int i=0;i<num_layers-1;i++){
+            vector<double> transposed((long)sizes[i+1]*sizes[i]);
+            for(int j=0;j<sizes[i+1];j++){
+                for(int k=0;k<sizes[i];k++) transposed[(long)k*sizes[i+1]+j] = net.get_weights(i)[(long)j*sizes[i]+k];
+            }
+            write_array(os, "W"+to_string(i), transposed.data(), (long)transposed.size());
+            write_array(os, "B"+to_string(i), net.get_biases(i), sizes[i+1]);
+        }
+
+        os<<"//out = W in + b with W stored transposed (COLS rows of ROWS weights), so every input scales one contiguous row\n";
+        os<<"//and the loop over the outputs vectorizes without reordering any sum\n";
+        os<<"template<int ROWS, int COLS>\n";
+        os<<"inline void dense(const double* __restrict wt, const double* __restrict b, const double* __restrict in, double* __restrict out){\n";
+        os<<"    for(int j=0;j<ROWS;j++) out[j]=0;\n";
+        os<<"    for(int k=0;k<COLS;k++){\n";
+        os<<"        const double* row = wt+k*ROWS;\n";
+        os<<"        double x = in[k];\n";
+        os<<"        for(int j=0;j<ROWS;j++) out[j]+=row[j]*x;\n";
+        os<<"    }\n";
+        os<<"    for(int j=0;j<ROWS;j++) out[j]+=b[j];\n";
+        os<<"}\n\n";
+
+        os<<"inline double activation(double x){return "<<activation_expr(net.get_activation())<<";}\n\n";
+
+        os<<"inline void forward(const double* input, double* output){\n";
+        for(int i=1;i<num_layers-1;i++) os<<"    alignas(64) double h"<<i<<"["<<sizes[i]<<"];\n";
+        for(int i=0;i<num_layers-1;i++){
+            string in = i==0 ? "input" : "h"+to_string(i);
+            string out = i==num_layers-2 ? "output" : "h"+to_string(i+1);
+            os<<"    dense<"<<sizes[i+1]<<", "<<sizes[i]<<">(W"<<i<<", B"<<i<<", "<<in<<", "<<out<<");\n";
+            if(i<num_layers-2) os<<"    for(int j=0;j<"<<sizes[i+1]<<";j++) "<<out<<"[j]=activation("<<out<<"[j]);\n";
+        }
+        if(classification){
+            os<<"    double total=0;\n";
+            os<<"    for(int i=0;i<OUTPUT_SIZE;i++) total+=std::exp(output[i]);\n";
+            os<<"    for(int i=0;i<OUTPUT_SIZE;i++){\n";
+            os<<"        if(total>=INFINITY) output[i] = output[i]>=INFINITY ? 1 : 0;\n";
+            os<<"        else if(total==0) output[i]=0;\n";
+            os<<"        else output[i]=std::exp(output[i])/total;\n";
+            os<<"    }\n";
+        }
+        os<<"}\n\n";
+
+        if(classification){
+            vector<string>& labels = meta.get_class_values();
+            os<<"constexpr const char* CLASS_VALUES[OUTPUT_SIZE] = {";
+            for(size_t i=0;i<labels.size();i++) os<<quoted(labels[i])<<(i+1<labels.size() ? ", " : "");
+            os<<"};\n\n";
+            os<<"inline int classify_index(const double* input){\n";
+            os<<"    double output[OUTPUT_SIZE];\n";
+            os<<"    forward(input, output);\n";
+            os<<"    int best=0;\n";
+            os<<"    for(int i=1;i<OUTPUT_SIZE;i++) if(output[i]>output[best]) best=i;\n";
+            os<<"    return best;\n";
+            os<<"}\n\n";
+            os<<"inline const char* classify(const double* input){return CLASS_VALUES[classify_index(input)];}\n\n";
+        }
+        else{
+            os<<"inline double predict(const double* input){\n";
+            os<<"    double output[OUTPUT_SIZE];\n";
+            os<<"    forward(input, output);\n";
+            os<<"    return output[0];\n";
+            os<<"}\n\n";
+        }
+
+        //the encoding: sorted value tables for one hot attributes, the hash for hashed ones
+        map<int, pair<double,double>> transform_of; //data index -> shift, scale
+        for(int i=0;i<norm.size();i++) transform_of[norm.get_indices()[i]] = make_pair(norm.get_shift()[i], norm.get_scale()[i]);
+
+        os<<"struct Slot{\n    const char* value;\n    int slot;\n};\n\n";
+        os<<"//slot of value in a table sorted by value, -1 if it isn't listed\n";
+        os<<"inline int lookup(const Slot* table, int n, const char* value){\n";
+        os<<"    int lo=0, hi=n;\n";
+        os<<"    while(lo<hi){\n";
+        os<<"        int mid=(lo+hi)/2;\n";
+        os<<"        int c=std::strcmp(table[mid].value, value);\n";
+        os<<"        if(c==0) return table[mid].slot;\n";
+        os<<"        if(c<0) lo=mid+1;\n";
+        os<<"        else hi=mid;\n";
+        os<<"    }\n";
+        os<<"    return -1;\n";
+        os<<"}\n\n";
+        os<<"inline int hash_slot(const char* value, int buckets){\n";
+        os<<"    uint64_t h = 14695981039346656037ULL;\n";
+        os<<"    for(;*value;value++){\n";
+        os<<"        h ^= (unsigned char)*value;\n";
+        os<<"        h *= 1099511628211ULL;\n";
+        os<<"    }\n";
+        os<<"    return (int)(h%(uint64_t)buckets);\n";
+        os<<"}\n\n";
+
+        int a=0;
+        for(Attribute& attr : meta.getAttributes()){
+            if(attr.getLabel()==CLASSLABEL || attr.getType()!=CATEGORICAL || attr.isHashed()) continue;
+            vector<pair<string,int>> table;
+            for(int v=0;v<(int)attr.getValues().size();v++) table.push_back(make_pair(attr.getValues()[v], v));
+            sort(table.begin(), table.end());
+            os<<"constexpr Slot VALUES_"<<a++<<"["<<max((size_t)1, table.size())<<"] = {";
+            for(size_t i=0;i<table.size();i++) os<<(i%4==0 ? "\n    " : " ")<<"{"<<quoted(table[i].first)<<", "<<table[i].second<<"}"<<(i+1<table.size() ? "," : "");
+            if(table.empty()) os<<"{\"\", -1}";
+            os<<"\n};\n\n";
+        }
+
+        os<<"inline bool missing(const char* value){return std::strcmp(value, "<<quoted(STR_MISSING_VAL)<<")==0;}\n\n";
+        os<<"inline void encode(const char* const* values, double* input){\n";
+        os<<"    std::memset(input, 0, sizeof(double)*INPUT_SIZE);\n";
+        bool has_numeric=false, has_categorical=false;
+        for(Attribute& attr : meta.getAttributes()){
+            if(attr.getLabel()==CLASSLABEL) continue;
+            if(attr.getType()==NUMERIC) has_numeric=true;
+            else has_categorical=true;
+        }
+        if(has_numeric) os<<"    char* end;\n";
+        if(has_categorical) os<<"    int slot;\n";
+        int column=0, index=0;
+        a=0;
+        for(Attribute& attr : meta.getAttributes()){
+            if(attr.getLabel()==CLASSLABEL) continue;
+            os<<"    //"<<attr.getLabel()<<"\n";
+            if(attr.getType()==NUMERIC){
+                double shift=0, scale=1;
+                if(transform_of.count(index)){
+                    shift = transform_of[index].first;
+                    scale = transform_of[index].second;
+                }
+                //missing values become the mean, which normalizes to 0
+                os<<"    input["<<index<<"] = std::strtof(values["<<column<<"], &end);\n";
+                os<<"    input["<<index<<"] = (end==values["<<column<<"] || missing(values["<<column<<"])) ? 0 : (input["<<index<<"]-"
+                  <<literal(shift)<<")/"<<literal(scale)<<";\n";
+            }
+            else{
+                if(attr.isHashed()) os<<"    slot = missing(values["<<column<<"]) ? -1 : hash_slot(values["<<column<<"], "<<attr.getHashBuckets()<<");\n";
+                else os<<"    slot = lookup(VALUES_"<<a++<<", "<<attr.getValues().size()<<", values["<<column<<"]);\n";
+                os<<"    if(slot>=0) input["<<index<<"+slot] = 1;\n";
+            }
+            index+=attr.getEncodedSize();
+            column++;
+        }
+        os<<"}\n\n";
+        os<<"constexpr int NUM_ATTRIBUTES = "<<column<<";\n\n";
+
+        os<<"inline "<<(classification ? "const char* classify_row" : "double predict_row")<<"(const char* const* values){\n";
+        os<<"    alignas(64) double input[INPUT_SIZE];\n";
+        os<<"    encode(values, input);\n";
+        os<<"    return "<<(classification ? "classify" : "predict")<<"(input);\n";
+        os<<"}\n\n";
+
+        os<<"} // namespace "<<name<<"\n\n";
+        os<<"#endif /* "<<guard<<"_MODEL_H */\n";
+    }
+
+    static void write_header(const MLPNetwork& net, ARFFMetaData& meta, const NormalizationStats& norm, const string& name, string filename){
+        ofstream outFile(filename.c_str());
+        if(!outFile){
+            cerr<<"unable to open file: "<<filename<<endl;
+            throw invalid_argument("unable to open file\n");
+        }
+        write_header(net, meta, norm, name, outFile);
+        if(!outFile){
+            cerr<<"Error. Unable to write "<<filename<<endl;
+            throw runtime_error("write failed\n");
+        }
+    }
+};
+
+#endif /* Codegen_h */
@@ -0,0 +1,356 @@
+/*
+ * Filename: CompactDataset.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a compact in-memory ARFF dataset that stores categorical attributes as small integer codes and numeric attributes as floats.
+ */
+
+#ifndef CompactDataset_h
+#define CompactDataset_h
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+
+#include "Dataset.h"
+
+using namespace std;
+
+/*
+ * Every row is stored as a fixed size record: one float per numeric attribute followed by one code per categorical
+ * attribute (the index of its value or hash bucket, all ones if missing) and finally the class, a code or a float for regression.
+ * Codes are one byte when every categorical attribute has fewer than 255 values (or hash buckets), two bytes when every one
+ * has fewer than 65535 and four bytes otherwise, so no value's code can reach the missing code.
+ * Numeric values are read with single precision by the ARFF loader anyway, so floats hold them exactly.
+ * Rows are decoded on the fly into the "one hot encoded" arrays of an Entry for training and inference.
+ */
+class CompactARFFDataset : public Dataset{
+
+private:
+
+    struct Column{
+        bool numeric;
+        int offset;     //byte offset of the value in a record
+        int data_index; //first index in the one hot encoded data array
+        int num_values;
+    };
+
+    ARFFMetaData meta;
+    vector<Column> columns; //every attribute but the class
+    Column class_column;
+    bool has_class;
+    vector<string> class_values;    //looked up once, the metadata searches every attribute for them
+    int code_size;
+    int record_size;
+    vector<uint8_t> records;
+    long num_rows;
+    NormalizationStats norm;
+
+    uint32_t readCode(const uint8_t* p) const {
+        if(code_size==1) return *p;
+        if(code_size==2){
+            uint16_t code;
+            memcpy(&code, p, sizeof(code));
+            return code;
+        }
+        uint32_t code;
+        memcpy(&code, p, sizeof(code));
+        return code;
+    }
+
+    void writeCode(uint8_t* p, uint32_t code) const {
+        if(code_size==1) *p = (uint8_t)code;
+        else if(code_size==2){
+            uint16_t c = (uint16_t)code;
+            memcpy(p, &c, sizeof(c));
+        }
+        else memcpy(p, &code, sizeof(code));
+    }
+
+    uint32_t missingCode() const {return code_size==1 ? 0xFF : code_size==2 ? 0xFFFF : 0xFFFFFFFF;}
+
+    float readFloat(const uint8_t* p) const {
+        float f;
+        memcpy(&f, p, sizeof(f));
+        return f;
+    }
+
+    void writeFloat(uint8_t* p, float f) const {memcpy(p, &f, sizeof(f));}
+
+    const uint8_t* record(long i) const {return records.data()+i*record_size;}
+    uint8_t* record(long i) {return records.data()+i*record_size;}
+
+    const string empty_class;
+
+    //9 significant digits read back as the same float, so stof(getClass()) is the stored target
+    static void formatClass(float value, char* out){
+        snprintf(out, 32, "%.9g", value);
+    }
+
+    //index of the active slot of a one hot encoded block, -1 if none is set
+    static int activeSlot(const double* block, int num_values){
+        for(int v=0;v<num_values;v++) if(block[v]==1) return v;
+        return -1;
+    }
+
+public:
+
+    CompactARFFDataset(){
+        code_size=1;
+        record_size=0;
+        num_rows=0;
+        has_class=false;
+    }
+
+    //lays out the records for the attributes of meta, the dataset starts out empty
+    CompactARFFDataset(ARFFMetaData& meta){
+        setMeta(meta);
+    }
+
+    //copies and compresses every entry of a dense dataset, including its normalization statistics
+    CompactARFFDataset(ARFFDataset& data){
+        setMeta(data.getMeta());
+        records.reserve((size_t)record_size*data.getSize());
+        for(Entry& e : data.getData()) addEntry(e);
+        norm = data.getNormalization();
+    }
+
+    void setMeta(ARFFMetaData& meta){
+        this->meta=meta;
+        columns.clear();
+        records.clear();
+        num_rows=0;
+        has_class=false;
+        class_values.clear();
+
+        code_size=1;
+        for(Attribute& a : meta.getAttributes()){
+            if(a.getType()!=CATEGORICAL) continue;
+            if(a.getEncodedSize()>=0xFFFF) code_size=4;
+            else if(a.getEncodedSize()>=0xFF) code_size=max(code_size, 2);
+        }
+
+        //floats first so they stay 4 byte aligned within a record
+        int offset=0, data_index=0;
+        for(Attribute& a : meta.getAttributes()){
+            if(a.getLabel()==CLASSLABEL){
+                has_class=true;
+                class_column.numeric = a.getType()==NUMERIC;
+                class_column.num_values = class_column.numeric ? 1 : (int)a.getValues().size();
+                class_column.data_index = 0;
+                if(!class_column.numeric) class_values = a.getValues();
+                continue;
+            }
+            Column c;
+            c.numeric = a.getType()==NUMERIC;
+            c.num_values = a.getEncodedSize();
+            c.data_index = data_index;
+            data_index += c.num_values;
+            if(c.numeric){
+                c.offset = offset;
+                offset += sizeof(float);
+            }
+            columns.push_back(c);
+        }
+        for(Column& c : columns){
+            if(!c.numeric){
+                c.offset = offset;
+                offset += code_size;
+            }
+        }
+        if(has_class){
+            if(class_column.numeric) offset = (offset+3)/4*4;
+            class_column.offset = offset;
+            offset += class_column.numeric ? sizeof(float) : code_size;
+        }
+        record_size = (offset+3)/4*4;
+    }
+
+    ARFFMetaData& getMeta() override {return meta;}
+
+    long getSize() override {return num_rows;}
+
+    string get_classlabel() override {return meta.get_classlabel();}
+
+    //compact datasets don't keep entries, use getEntry or decode instead
+    vector<Entry>& getData() override {
+        cerr<<"Error. CompactARFFDataset does not store entries, use getEntry or decode\n";
+        throw logic_error("compact datasets have no entries\n");
+    }
+
+    //compresses one "one hot encoded" entry and appends it
+    void addEntry(Entry& e) override {
+        records.resize(records.size()+record_size, 0);
+        uint8_t* r = record(num_rows);
+        for(Column& c : columns){
+            if(c.numeric) writeFloat(r+c.offset, (float)e.data[c.data_index]);
+            else{
+                int slot = activeSlot(e.data+c.data_index, c.num_values);
+                writeCode(r+c.offset, slot<0 ? missingCode() : (uint32_t)slot);
+            }
+        }
+        if(has_class){
+            if(class_column.numeric) writeFloat(r+class_column.offset, (float)e.expected[0]);
+            else{
+                int slot = activeSlot(e.expected, class_column.num_values);
+                writeCode(r+class_column.offset, slot<0 ? missingCode() : (uint32_t)slot);
+            }
+        }
+        num_rows++;
+    }
+
+    //decodes row i into the dense arrays data (input layer size) and expected (output layer size)
+    void decode(long i, double* data, double* expected) const {
+        const uint8_t* r = record(i);
+        for(const Column& c : columns){
+            if(c.numeric) data[c.data_index] = readFloat(r+c.offset);
+            else{
+                double* block = data+c.data_index;
+                for(int v=0;v<c.num_values;v++) block[v]=0;
+                uint32_t code = readCode(r+c.offset);
+                if(code!=missingCode()) block[code]=1;
+            }
+        }
+        if(has_class){
+            if(class_column.numeric) expected[0] = readFloat(r+class_column.offset);
+            else{
+                for(int v=0;v<class_column.num_values;v++) expected[v]=0;
+                uint32_t code = readCode(r+class_column.offset);
+                if(code!=missingCode()) expected[code]=1;
+            }
+        }
+    }
+
+    //the class label is copied into the entry's own string, which keeps its capacity from row to row, and numeric classes
+    //are formatted on the stack, so decoding a row doesn't allocate
+    Entry& getEntry(long i, Entry& scratch) override {
+        decode(i, scratch.data, scratch.expected);
+        if(!has_class) return scratch;
+        const uint8_t* r = record(i);
+        if(class_column.numeric){
+            char number[32];
+            formatClass(readFloat(r+class_column.offset), number);
+            scratch.setClass(number);
+        }
+        else{
+            uint32_t code = readCode(r+class_column.offset);
+            scratch.setClass(code==missingCode() ? empty_class : class_values.at(code));
+        }
+        return scratch;
+    }
+
+    string getEntryClass(long i) override {
+        if(!has_class) return "";
+        const uint8_t* r = record(i);
+        if(class_column.numeric){
+            char number[32];
+            formatClass(readFloat(r+class_column.offset), number);
+            return number;
+        }
+        uint32_t code = readCode(r+class_column.offset);
+        return code==missingCode() ? "" : class_values.at(code);
+    }
+
+    void prefetchEntry(long i) override {__builtin_prefetch(record(i));}
+
+    //bytes used by the records, compare with getSize()*(input+output layer size)*sizeof(double) for the dense layout
+    long getMemoryBytes() const {return (long)records.capacity();}
+
+    int getRecordSize() const {return record_size;}
+
+    //replace missing numeric values with the mean and missing categorical values with the mode
+    void replaceMissingValues(){
+        for(Column& c : columns){
+            if(c.numeric){
+                double mean=0, total=0;
+                for(long i=0;i<num_rows;i++){
+                    float f = readFloat(record(i)+c.offset);
+                    if(!isnan(f)){
+                        mean+=f;
+                        total++;
+                    }
+                }
+                mean = total>0 ? mean/total : 0;
+                for(long i=0;i<num_rows;i++) if(isnan(readFloat(record(i)+c.offset))) writeFloat(record(i)+c.offset, (float)mean);
+            }
+            else{
+                vector<long> freq(c.num_values, 0);
+                for(long i=0;i<num_rows;i++){
+                    uint32_t code = readCode(record(i)+c.offset);
+                    if(code!=missingCode()) freq[code]++;
+                }
+                uint32_t mode = (uint32_t)(max_element(freq.begin(), freq.end())-freq.begin());
+                for(long i=0;i<num_rows;i++) if(readCode(record(i)+c.offset)==missingCode()) writeCode(record(i)+c.offset, mode);
+            }
+        }
+    }
+
+    //z-score normalize all numeric attributes, same statistics and transform as ARFFDataset::normalize
+    void normalize(){
+        vector<int> indices;
+        vector<int> offsets;
+        for(Column& c : columns){
+            if(c.numeric){
+                indices.push_back(c.data_index);
+                offsets.push_back(c.offset);
+            }
+        }
+        norm = NormalizationStats(indices);
+
+        vector<double> raw(meta.get_input_layer_size(), 0);
+        for(long i=0;i<num_rows;i++){
+            for(int k=0;k<(int)offsets.size();k++) raw[indices[k]] = readFloat(record(i)+offsets[k]);
+            norm.add(raw.data());
+        }
+        norm.update_transform();
+        for(long i=0;i<num_rows;i++){
+            for(int k=0;k<(int)offsets.size();k++){
+                float f = readFloat(record(i)+offsets[k]);
+                writeFloat(record(i)+offsets[k], (float)((f-norm.get_shift()[k])/norm.get_scale()[k]));
+            }
+        }
+    }
+
+    NormalizationStats& getNormalization() {return norm;}
+
+    //load an arff file straight into compact records, only one dense row is ever held in memory
+    static void loadARFF(string filename, CompactARFFDataset& data){
+        ifstream inFile;
+        inFile.open(filename.c_str());
+
+        if(!inFile) {
+            cerr<<"unable to open file: "<<filename<<endl;
+            return;
+        }
+
+        ARFFMetaData meta;
+        meta.setEncodingOptions(data.getMeta());
+        ARFFDataset::readHeader(inFile, meta);
+        data.setMeta(meta);
+
+        ARFFRowEncoder encoder(data.getMeta());
+        Entry e(encoder.get_data_length(), encoder.get_expected_length());
+
+        string line;
+        while(getline(inFile,line)){
+            const char* begin = line.data();
+            const char* end = begin+line.size();
+            if(!ARFFRowEncoder::trim(begin, end)) continue;
+            encoder.encode(begin, end, e);
+            data.addEntry(e);
+        }
+        data.records.shrink_to_fit();
+    }
+
+};
+
+#endif /* CompactDataset_h */
@@ -17,9 +17,23 @@
 #include <sstream>
 #include <random>
 #include <algorithm>
+#include <cmath>
 #include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
 #include "Entry.h"
 #include "MetaData.h"
+#include "Random.h"
+
+//bytes the stream operator formats before handing them to the stream
+#define WRITE_CHUNK (1<<20)
+//bytes of the data section loadARFFParallel reads and parses at a time
+#define LOAD_BLOCK (16<<20)
 
 
 class Dataset{
@@ -32,6 +46,364 @@ public:
     virtual string get_classlabel()=0;
     virtual void addEntry(Entry& e)=0;
     
+    //row level access for code that has to work on datasets that don't keep an Entry per row
+    //getEntry returns entry i, such datasets decode it into scratch (sized for the dataset's metadata) and return scratch
+    virtual Entry& getEntry(long i, Entry& /*scratch*/){return getData()[i];}
+    virtual string getEntryClass(long i){return getData()[i].getClass();}
+    virtual void prefetchEntry(long i){getData()[i].prefetch();}
+    
+};
+
+//precomputed per-attribute plan for turning one line of an ARFF @data section into the "one hot encoded" arrays of an Entry
+//encode only reads the plan, so one encoder can be shared by every loader thread
+class ARFFRowEncoder{
+    
+private:
+    struct Column{
+        bool is_class;
+        bool numeric;
+        int hash_buckets;
+        vector<string> values;
+    };
+    
+    vector<Column> columns;
+    int data_length;
+    int expected_length;
+    int class_field;
+    
+    static float parseFloat(const string& s){
+        char* end;
+        float val = strtof(s.c_str(), &end);
+        if(end==s.c_str()){
+            cerr<<"Error. Unable to read numeric value \""<<s<<"\"\n";
+            throw invalid_argument("invalid numeric value\n");
+        }
+        return val;
+    }
+    
+public:
+    
+    //how rows carry the class: parsed into expected (training), a field that is skipped, or no field at all (unlabeled rows)
+    enum ClassField {CLASS_READ, CLASS_IGNORED, CLASS_ABSENT};
+    
+    ARFFRowEncoder(ARFFMetaData& meta, ClassField class_field=CLASS_READ){
+        this->class_field=class_field;
+        for(Attribute& a : meta.getAttributes()){
+            Column c;
+            c.is_class = a.getLabel()==CLASSLABEL;
+            c.numeric = a.getType()==NUMERIC;
+            c.hash_buckets = a.getHashBuckets();
+            if(!c.numeric && !a.isHashed()) c.values = a.getValues();
+            columns.push_back(c);
+        }
+        data_length = meta.calcEntryVectorLength();
+        expected_length = meta.calcExpectedVectorLength();
+    }
+    
+    int get_data_length() const {return data_length;}
+    int get_expected_length() const {return expected_length;}
+    
+    //drops one trailing whitespace character (the '\r' of windows line endings) and returns false if nothing is left
+    static bool trim(const char* begin, const char*& end){
+        if(end>begin && isspace(end[-1])) end--;
+        return end>begin;
+    }
+    
+    //encodes the line [begin, end) into e, which must already be sized for this encoder
+    void encode(const char* begin, const char* end, Entry& e) const {
+        
+        int data_index=0;
+        string s;
+        for(const Column& c : columns){
+            
+            if(c.is_class && class_field==CLASS_ABSENT) continue;
+            const char* field_end = begin;
+            while(field_end<end && *field_end!=DATA_DELIM) field_end++;
+            s.assign(begin, field_end);
+            begin = field_end<end ? field_end+1 : end;
+            if(s[0]==' ') s.erase(0,1);
+            
+            if(c.is_class && class_field==CLASS_IGNORED) continue;
+            if(c.numeric){
+                if(c.is_class){
+                    e.expected[0]=parseFloat(s);
+                    e.setClass(s);
+                }
+                else{
+                    e.data[data_index] = (s==NUM_MISSING_VAL) ? nanf("") : parseFloat(s);
+                    data_index++;
+                }
+            }
+            else if(c.is_class){
+                int i=0;
+                for(const string& val : c.values){
+                    if(s==val){
+                        e.expected[i]=1;
+                        e.setClass(val);
+                    }
+                    else e.expected[i]=0;
+                    i++;
+                }
+            }
+            else if(c.hash_buckets>0){
+                double* block = e.data+data_index;
+                for(int i=0;i<c.hash_buckets;i++) block[i]=0;
+                if(s!=STR_MISSING_VAL) block[Attribute::hashSlot(s.data(), s.size(), c.hash_buckets)]=1;
+                data_index+=c.hash_buckets;
+            }
+            else{
+                for(const string& val : c.values){
+                    e.data[data_index] = (s==val) ? 1 : 0;
+                    data_index++;
+                }
+            }
+        }//end of for column c : columns
+    }
+};
+
+//the inverse of ARFFRowEncoder: a precomputed per-attribute plan for turning an Entry back into a line of an ARFF @data section
+//rows are appended to a string so a whole dataset can be formatted without touching a stream
+class ARFFRowWriter{
+    
+private:
+    struct Column{
+        bool is_class;
+        bool numeric;
+        int index;                  //first index in data (or expected for the class)
+        vector<string> values;      //the value written for every slot, "" for buckets no listed value hashes to
+    };
+    
+    vector<Column> columns;
+    
+    //powers of ten for the exponents formatDouble handles without snprintf
+    static const double* powers(){
+        static double table[2*FORMAT_MAX_EXP+1];
+        static bool filled = false;
+        if(!filled){
+            for(int e=-FORMAT_MAX_EXP;e<=FORMAT_MAX_EXP;e++) table[e+FORMAT_MAX_EXP] = stod("1e"+to_string(e));
+            filled = true;
+        }
+        return table;
+    }
+    
+    static char* writeDigits(unsigned long v, char* out){
+        char digits[20];
+        int n=0;
+        do{
+            digits[n++] = (char)('0'+v%10);
+            v/=10;
+        }while(v>0);
+        while(n>0) *out++ = digits[--n];
+        return out;
+    }
+    
+    //first value of a one hot block set to 1, -1 if none is (a missing value)
+    static int activeSlot(const double* block, int num_values){
+        for(int v=0;v<num_values;v++) if(block[v]==1) return v;
+        return -1;
+    }
+    
+public:
+    
+    static const int FORMAT_MAX_EXP = 22;
+    
+    ARFFRowWriter(ARFFMetaData& meta){
+        powers();
+        int data_index=0;
+        for(Attribute& a : meta.getAttributes()){
+            Column c;
+            c.is_class = a.getLabel()==CLASSLABEL;
+            c.numeric = a.getType()==NUMERIC;
+            if(!c.numeric){
+                c.values = a.isHashed() ? vector<string>(a.getHashBuckets()) : a.getValues();
+                if(a.isHashed()) for(int slot=0;slot<a.getHashBuckets();slot++) c.values[slot] = a.getSlotValue(slot);
+            }
+            c.index = c.is_class ? 0 : data_index;
+            if(!c.is_class) data_index += c.numeric ? 1 : (int)c.values.size();
+            columns.push_back(c);
+        }
+    }
+    
+    /*
+     * writes x like printf("%g") (6 significant digits, trailing zeros dropped, exponent notation below 1e-4 and from 1e6)
+     * to out and returns the end, NaN is written as the missing value. Numbers whose exponent is out of the range of the
+     * power table, and the rare ones that land exactly on a rounding boundary, go through snprintf
+     */
+    static char* formatDouble(double x, char* out){
+        if(isnan(x)){
+            memcpy(out, NUM_MISSING_VAL, strlen(NUM_MISSING_VAL));
+            return out+strlen(NUM_MISSING_VAL);
+        }
+        if(x==0){
+            if(signbit(x)) *out++='-';
+            *out='0';
+            return out+1;
+        }
+        double a = fabs(x);
+        int e = (int)floor(log10(a));
+        if(e<-FORMAT_MAX_EXP+5 || e>FORMAT_MAX_EXP-5 || isinf(a)) return out+snprintf(out, 32, "%g", x);
+        
+        //the six significant digits as an integer: scale into [1e5, 1e6), fixed up if log10 was off by one, then round
+        //and only move to the next exponent if rounding carried into a seventh digit, near ties go through snprintf
+        double scaled = a*powers()[5-e+FORMAT_MAX_EXP];
+        if(scaled>=1e6){
+            e++;
+            scaled = a*powers()[5-e+FORMAT_MAX_EXP];
+        }
+        else if(scaled<1e5){
+            e--;
+            scaled = a*powers()[5-e+FORMAT_MAX_EXP];
+        }
+        double rounded = floor(scaled+0.5);
+        if(fabs(scaled-rounded)>0.4999 || rounded>1e6 || rounded<1e5) return out+snprintf(out, 32, "%g", x);
+        if(rounded==1e6){
+            rounded=1e5;
+            e++;
+        }
+        unsigned long m = (unsigned long)rounded;
+        
+        if(x<0) *out++='-';
+        
+        char digits[6];
+        for(int i=5;i>=0;i--){
+            digits[i] = (char)('0'+m%10);
+            m/=10;
+        }
+        int num_digits=6;
+        while(num_digits>1 && digits[num_digits-1]=='0') num_digits--;
+        
+        if(e<-4 || e>=6){
+            *out++ = digits[0];
+            if(num_digits>1){
+                *out++ = '.';
+                for(int i=1;i<num_digits;i++) *out++ = digits[i];
+            }
+            *out++ = 'e';
+            *out++ = e<0 ? '-' : '+';
+            int abs_e = e<0 ? -e : e;
+            if(abs_e<10) *out++ = '0';
+            return writeDigits(abs_e, out);
+        }
+        if(e<0){
+            *out++ = '0';
+            *out++ = '.';
+            for(int i=-1;i>e;i--) *out++ = '0';
+            for(int i=0;i<num_digits;i++) *out++ = digits[i];
+            return out;
+        }
+        for(int i=0;i<=e;i++) *out++ = digits[i];
+        if(num_digits>e+1){
+            *out++ = '.';
+            for(int i=e+1;i<num_digits;i++) *out++ = digits[i];
+        }
+        return out;
+    }
+    
+    //appends e as one line, fields separated by ", " like the ARFFDataset stream operator always wrote them
+    void write(const Entry& e, string& out) const {
+        char number[32];
+        for(int i=0;i<(int)columns.size();i++){
+            const Column& c = columns[i];
+            if(i>0) out.append(", ", 2);
+            const double* values = c.is_class ? e.expected : e.data;
+            if(c.numeric){
+                char* end = formatDouble(values[c.index], number);
+                out.append(number, end-number);
+            }
+            else{
+                int slot = activeSlot(values+c.index, (int)c.values.size());
+                out.append(slot<0 || c.values[slot].empty() ? STR_MISSING_VAL : c.values[slot]);
+            }
+        }
+        out.push_back('\n');
+    }
+    
+    //the @relation, @attribute and @data lines
+    static void writeHeader(ARFFMetaData& meta, string& out){
+        ostringstream os;
+        os<<"@relation "<<meta.getRelation()<<"\n\n"<<meta<<"\n@data\n";
+        out.append(os.str());
+    }
+};
+
+//running mean and variance (Welford) of every numeric input plus the z-score transform currently applied to the data
+//keeping the running statistics lets rows added later update the normalization without another pass over the dataset
+class NormalizationStats{
+    
+private:
+    vector<int> indices; //data index of every numeric attribute
+    vector<long> counts;
+    vector<double> means;
+    vector<double> m2s;
+    vector<double> shift;
+    vector<double> scale;
+    
+public:
+    
+    NormalizationStats(){}
+    
+    NormalizationStats(vector<int> numeric_indices){
+        indices = numeric_indices;
+        counts = vector<long>(indices.size(), 0);
+        means = vector<double>(indices.size(), 0);
+        m2s = vector<double>(indices.size(), 0);
+        shift = vector<double>(indices.size(), 0);
+        scale = vector<double>(indices.size(), 1);
+    }
+    
+    //adds the raw (not normalized) values of one row, missing values are skipped
+    void add(const double* raw){
+        for(int i=0;i<(int)indices.size();i++){
+            double x = raw[indices[i]];
+            if(isnan(x)) continue;
+            counts[i]++;
+            double delta = x-means[i];
+            means[i] += delta/counts[i];
+            m2s[i] += delta*(x-means[i]);
+        }
+    }
+    
+    double getMean(int i) const {return counts[i] ? means[i] : NAN;}
+    double getStdDev(int i) const {return counts[i] ? sqrt(m2s[i]/counts[i]) : NAN;}
+    
+    //makes the transform the z-score of the current statistics
+    //attributes that are constant or never present are only shifted (or left alone) instead of being divided by zero
+    void update_transform(){
+        for(int i=0;i<(int)indices.size();i++){
+            double mean = getMean(i), std = getStdDev(i);
+            shift[i] = isnan(mean) ? 0 : mean;
+            scale[i] = (isnan(std) || std==0) ? 1 : std;
+        }
+    }
+    
+    //normalizes a raw row in place with the current transform
+    void apply(double* row) const {
+        for(int i=0;i<(int)indices.size();i++) row[indices[i]] = (row[indices[i]]-shift[i])/scale[i];
+    }
+    
+    //turns a row normalized with the transform of other back into raw values and normalizes it with this transform
+    void reapply(double* row, const NormalizationStats& other) const {
+        for(int i=0;i<(int)indices.size();i++){
+            double raw = row[indices[i]]*other.scale[i]+other.shift[i];
+            row[indices[i]] = (raw-shift[i])/scale[i];
+        }
+    }
+    
+    //sets the transform directly, e.g. to one saved with a model, the running statistics are left alone
+    void set_transform(const vector<double>& shift, const vector<double>& scale){
+        if(shift.size()!=indices.size() || scale.size()!=indices.size()){
+            cerr<<"Error. Normalization has "<<indices.size()<<" numeric attributes but the transform has "<<shift.size()<<endl;
+            throw invalid_argument("normalization size mismatch\n");
+        }
+        this->shift = shift;
+        this->scale = scale;
+    }
+    
+    bool empty() const {return indices.empty();}
+    int size() const {return (int)indices.size();}
+    const vector<int>& get_indices() const {return indices;}
+    const vector<double>& get_shift() const {return shift;}
+    const vector<double>& get_scale() const {return scale;}
 };
 
 class ARFFDataset : public Dataset{
@@ -39,6 +411,7 @@ class ARFFDataset : public Dataset{
 private:
     vector<Entry> data;
     ARFFMetaData meta;
+    NormalizationStats norm;
     
 public:
     
@@ -139,6 +512,7 @@ public:
         
         double mean = getMean(label);
         double std = getStdDev(label);
+        if(std==0) std=1; //constant attributes are only shifted
         
         if(!isnan(mean) && !isnan(std)){
             for(Entry& e : data){
@@ -149,11 +523,21 @@ public:
     }
 
     //z-score normalize all numeric attributes
+    //the statistics are kept (see getNormalization) so rows added later can be normalized the same way
     void normalize(){
+        vector<int> indices;
         for(Attribute& a : meta.getAttributes()){
-            if(a.getType()==NUMERIC && a.getLabel()!=CLASSLABEL) normalizeAttribute(a.getLabel());
+            if(a.getType()==NUMERIC && a.getLabel()!=CLASSLABEL) indices.push_back(meta.calcNumericDataIndex(a.getLabel()));
         }
+        
+        norm = NormalizationStats(indices);
+        for(Entry& e : data) norm.add(e.data);
+        norm.update_transform();
+        for(Entry& e : data) norm.apply(e.data);
     }
+    
+    //statistics and transform of the last call to normalize, empty if the dataset was never normalized
+    NormalizationStats& getNormalization() {return norm;}
 
     //returns the index of the mode value in ARFFMetaData::getValues() for the attribute with specified label
     int getModeIndex(string label){
@@ -197,6 +581,12 @@ public:
         int start = get<0>(range);
         int end = get<1>(range);
         
+        //hashed attributes are counted by bucket, the values in a bucket aren't told apart
+        if(meta.getAttribute(label).isHashed()){
+            values.clear();
+            for(int i=start;i<end;i++) values.push_back(to_string(i-start));
+        }
+        
         for(string classlabel : classlabels){
             
             unordered_map<string, int> freq_map;
@@ -227,6 +617,7 @@ public:
     }
     
     //returns the mode for each class in ARFFMetaData::getValues() for the attribute with specified label
+    //for a hashed attribute that is the first listed value in the most frequent bucket
     //output[classlabel] = mode_for_that_class
     unordered_map<string, string> getModeByClass(string label){
         
@@ -235,7 +626,7 @@ public:
         for(Attribute& a : meta.getAttributes()){
             if(a.getType()==CATEGORICAL && a.getLabel()==label){
                 for(string classlabel : meta.get_class_values()){
-                    modes[classlabel] = a.getValues().at(indices[classlabel]);
+                    modes[classlabel] = a.getSlotValue(indices[classlabel]);
                 }
             }
         }
@@ -302,12 +693,13 @@ public:
         }
     }
 
-    //shuffle data
+    //shuffle data, slot i takes entry perm(i) of the counter based permutation keyed by seed
     void shuffle(unsigned seed = 420){
-        std::random_device rd;
-        std::mt19937 rng(rd());
-        rng.seed(seed);
-        std::shuffle(data.begin(), data.end(), rng);
+        CounterPermutation perm(CounterRNG(seed, RNG_DATA_SHUFFLE), data.size());
+        vector<Entry> shuffled;
+        shuffled.reserve(data.size());
+        for(size_t i=0;i<data.size();i++) shuffled.push_back(move(data[perm(i)]));
+        data.swap(shuffled);
     }
     
     //load arff file into data
@@ -333,9 +725,8 @@ public:
         
     }
     
-    friend istream& operator>>(istream& inFile, ARFFDataset& data){
-        
-        ARFFMetaData meta;
+    //reads the @relation and @attribute lines into meta and leaves the stream at the first line after @data
+    static void readHeader(istream& inFile, ARFFMetaData& meta){
         
         string relation;
         while(relation[0]!='@') {
@@ -375,116 +766,208 @@ public:
         }
         meta.update_input_layer_size();
         meta.update_output_layer_size();
-        data.setMeta(meta);
         
-        if(isspace(line[line.length()-1])) line.pop_back();
+        if(!line.empty() && isspace(line[line.length()-1])) line.pop_back();
         while(line[0]!='@') getline(inFile,line);
+    }
+    
+    friend istream& operator>>(istream& inFile, ARFFDataset& data){
+        
+        ARFFMetaData meta;
+        meta.setEncodingOptions(data.getMeta());
+        readHeader(inFile, meta);
+        data.setMeta(meta);
         
-        int entry_data_length = meta.calcEntryVectorLength();
-        int entry_class_length = meta.calcExpectedVectorLength();
+        ARFFRowEncoder encoder(data.getMeta());
+        
+        string line;
         while(getline(inFile,line)){
-            if(isspace(line[line.length()-1])) line.pop_back();
-            if(line.empty()) continue;
-            
-            stringstream l(line);
-            
-            Entry e(entry_data_length, entry_class_length);
-            
-            int data_index=0;
-            for(Attribute& a : meta.getAttributes()){
-                
-                string s;
-                getline(l,s,DATA_DELIM);
-                if(s[0]==' ') s.erase(0,1);
-                //cout<<s<<endl;
-                if(a.getType()==NUMERIC){
-                    if(a.getLabel()==CLASSLABEL){
-                        e.expected[0]=stof(s);
-                        e.setClass(s);
-                    }
-                    else{
-                        if(s==NUM_MISSING_VAL){
-                            e.data[data_index] = nanf("");
-                            data_index++;
-                        }
-                        else{
-                            e.data[data_index]=stof(s);
-                            data_index++;
-                        }
-                    }
-                }
-                else if(a.getType()==CATEGORICAL){
-                    
-                    if(a.getLabel()==CLASSLABEL){
-                        int i=0;
-                        for(string val : a.getValues()){
-                            if(s==val){
-                                e.expected[i]=1;
-                                e.setClass(val);
-                            }
-                            else e.expected[i]=0;
-                            i++;
-                        }
-                    }
-                    else{
-                        for(string val : a.getValues()){
-                            e.data[data_index] = (s==val) ? 1 : 0;
-                            data_index++;
-                        }
-                    }
-                }
-            }//end of for attribute a : attributes
+            const char* begin = line.data();
+            const char* end = begin+line.size();
+            if(!ARFFRowEncoder::trim(begin, end)) continue;
             
+            Entry e(encoder.get_data_length(), encoder.get_expected_length());
+            encoder.encode(begin, end, e);
             data.addEntry(e);
         }//end of while
         
         return inFile;
     }
     
-    friend ostream& operator<<(ostream& os, ARFFDataset& data){
+    //loads an arff file by parsing the @data section on num_threads threads (0 uses every core)
+    //the data section is read block_bytes at a time and every block is split into chunks at line boundaries, each chunk is
+    //encoded into its own preallocated range of rows, so the rows end up in file order and ARFFDataset::shuffle gives the
+    //same result as with loadARFF, and the text held in memory is one block no matter how big the file is
+    static void loadARFFParallel(string filename, ARFFDataset& data, int num_threads=0, size_t block_bytes=LOAD_BLOCK){
+        ifstream inFile;
+        inFile.open(filename.c_str(), ios::binary);
         
-        auto meta = data.getMeta();
-        os<<meta<<endl;
+        if(!inFile) {
+            cerr<<"unable to open file: "<<filename<<endl;
+            return;
+        }
         
-        os<<"@data\n"<<endl;
-        for(Entry& e : data.getData()){
-            int data_index=0;
-            bool end_of_line=false;
-            for(Attribute& a : meta.getAttributes()){
-                if(a.getLabel()==meta.getAttributes().back().getLabel()) end_of_line=true;
-                
-                if(a.getType()==NUMERIC){
-                    if(a.getLabel()==CLASSLABEL) os<<e.expected[0]<<((end_of_line) ? "" : ", ");
-                    else{
-                        os<<e.data[data_index]<<((end_of_line) ? "" : ", ");
-                        data_index++;
-                    }
+        ARFFMetaData meta;
+        meta.setEncodingOptions(data.getMeta());
+        readHeader(inFile, meta);
+        data.setMeta(meta);
+        
+        if(num_threads<=0) num_threads = max(1u, thread::hardware_concurrency());
+        block_bytes = max((size_t)1, block_bytes);
+        ARFFRowEncoder encoder(data.getMeta());
+        
+        //the unfinished last line of a block is carried over to the start of the next one
+        string block, carry;
+        bool eof=false;
+        while(!eof){
+            block.swap(carry);
+            carry.clear();
+            //read until the block holds at least one whole line, a line longer than block_bytes grows the block
+            while(true){
+                size_t size = block.size();
+                block.resize(size+block_bytes);
+                inFile.read(&block[size], block_bytes);
+                size_t n = (size_t)inFile.gcount();
+                block.resize(size+n);
+                if(n<block_bytes){
+                    eof=true;
+                    break;
                 }
-                else{
-                    if(a.getLabel()==CLASSLABEL){
-                        int i=0;
-                        for(string val : a.getValues()){
-                            if(e.expected[i]==1) os<<val<<((end_of_line) ? "" : ", ");
-                            i++;
-                        }
+                if(memchr(block.data()+size, '\n', n)!=NULL) break;
+            }
+            if(!eof){
+                size_t last = block.rfind('\n');
+                carry.assign(block, last+1, string::npos);
+                block.resize(last+1);
+            }
+            loadBlock(block.data(), block.data()+block.size(), data, encoder, num_threads);
+        }
+        inFile.close();
+    }
+    
+    //encodes the rows of [text, text_end), which ends at a line boundary, and appends them to data on num_threads threads
+    static void loadBlock(const char* text, const char* text_end, ARFFDataset& data, const ARFFRowEncoder& encoder, int num_threads){
+        
+        //a few chunks per thread so uneven lines still balance out
+        int num_chunks = num_threads*4;
+        size_t size = text_end-text;
+        vector<const char*> bounds(num_chunks+1);
+        bounds[0] = text;
+        for(int c=1;c<num_chunks;c++){
+            const char* p = max(bounds[c-1], text+size*c/num_chunks);
+            while(p>text && p<text_end && p[-1]!='\n') p++;
+            bounds[c] = p;
+        }
+        bounds[num_chunks] = text_end;
+        
+        //first pass counts the rows in every chunk, second pass encodes them into their slots
+        vector<long> offsets(num_chunks+1, 0);
+        parallel_chunks(num_threads, num_chunks, [&](int c){
+            offsets[c+1] = forEachLine(bounds[c], bounds[c+1], [](const char*, const char*){});
+        });
+        for(int c=0;c<num_chunks;c++) offsets[c+1]+=offsets[c];
+        
+        //the empty entries are just placeholders, the arrays get allocated by the worker that fills them
+        long first_row = data.data.size();
+        data.data.resize(first_row+offsets[num_chunks]);
+        
+        parallel_chunks(num_threads, num_chunks, [&](int c){
+            long row = first_row+offsets[c];
+            forEachLine(bounds[c], bounds[c+1], [&](const char* begin, const char* end){
+                Entry& e = data.data[row++];
+                e = Entry(encoder.get_data_length(), encoder.get_expected_length());
+                encoder.encode(begin, end, e);
+            });
+        });
+    }
+    
+    //calls fn(begin, end) for every non empty line in [begin, end) and returns how many there were
+    template<typename F>
+    static long forEachLine(const char* begin, const char* end, F fn){
+        long count=0;
+        while(begin<end){
+            const char* line_end = (const char*)memchr(begin, '\n', end-begin);
+            if(line_end==NULL) line_end=end;
+            const char* b = begin;
+            const char* e = line_end;
+            if(ARFFRowEncoder::trim(b, e)){
+                fn(b, e);
+                count++;
+            }
+            begin = line_end+1;
+        }
+        return count;
+    }
+    
+    //runs fn(chunk) for every chunk, handing chunks out to num_threads threads
+    //rethrows the first exception thrown by any chunk on the calling thread
+    template<typename F>
+    static void parallel_chunks(int num_threads, int num_chunks, F fn){
+        atomic<int> next(0);
+        exception_ptr error;
+        mutex error_lock;
+        vector<thread> threads;
+        for(int t=0;t<num_threads;t++){
+            threads.push_back(thread([&]{
+                for(int c=next++; c<num_chunks; c=next++){
+                    try{
+                        fn(c);
                     }
-                    else{
-                        bool missing=true;
-                        for(string val : a.getValues()){
-                            if(e.data[data_index]==1){
-                                os<<val<<((end_of_line) ? "" : ", ");
-                                missing=false;
-                            }
-                            data_index++;
-                        }
-                        if(missing) os<<STR_MISSING_VAL<<((end_of_line) ? "" : ", ");
+                    catch(...){
+                        lock_guard<mutex> lock(error_lock);
+                        if(!error) error = current_exception();
                     }
                 }
-            }//end for attribute a
-            os<<endl;
-        }//end for entry e
+            }));
+        }
+        for(thread& t : threads) t.join();
+        if(error) rethrow_exception(error);
+    }
+    
+    //formats the dataset in chunks of about WRITE_CHUNK bytes, so the stream sees a few large writes instead of one flush per row
+    friend ostream& operator<<(ostream& os, ARFFDataset& data){
+        
+        ARFFRowWriter writer(data.getMeta());
+        string buffer;
+        buffer.reserve(WRITE_CHUNK+4096);
+        ARFFRowWriter::writeHeader(data.getMeta(), buffer);
+        for(Entry& e : data.getData()){
+            writer.write(e, buffer);
+            if(buffer.size()>=WRITE_CHUNK){
+                os.write(buffer.data(), buffer.size());
+                buffer.clear();
+            }
+        }
+        os.write(buffer.data(), buffer.size());
         return os;
+    }
+    
+    //formats the whole dataset into one buffer and hands it to the file with one bulk write
+    static void saveARFF(string filename, ARFFDataset& data){
+        
+        ARFFRowWriter writer(data.getMeta());
+        string buffer;
+        ARFFRowWriter::writeHeader(data.getMeta(), buffer);
+        if(data.getSize()>0){
+            //reserve from the size of the first row so the buffer doesn't keep reallocating
+            size_t header = buffer.size();
+            writer.write(data.getData()[0], buffer);
+            buffer.reserve(header+(buffer.size()-header)*(data.getSize()+data.getSize()/8+1));
+            for(long i=1;i<data.getSize();i++) writer.write(data.getData()[i], buffer);
+        }
         
+        FILE* f = fopen(filename.c_str(), "wb");
+        if(f==NULL){
+            cerr<<"unable to open file: "<<filename<<endl;
+            throw invalid_argument("unable to open file\n");
+        }
+        setvbuf(f, NULL, _IONBF, 0);
+        bool ok = fwrite(buffer.data(), 1, buffer.size(), f)==buffer.size();
+        ok = fclose(f)==0 && ok;
+        if(!ok){
+            cerr<<"Error. Unable to write "<<filename<<endl;
+            throw runtime_error("write failed\n");
+        }
     }
     
 };
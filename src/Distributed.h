@@ -0,0 +1,443 @@
+/*
+ * Filename: Distributed.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains data parallel training across processes: every worker trains an MLPNetwork replica
+ * on its shard of the rows and a parameter server averages the replicas' updates over unix domain or TCP sockets.
+ */
+
+#ifndef Distributed_h
+#define Distributed_h
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <signal.h>
+
+#include "Network.h"
+#include "Socket.h"
+
+using namespace std;
+
+//how updates are encoded on the wire, both ways
+//FLOAT halves the bytes, TOPK only sends the largest topk_fraction of a worker's update as (index, float) pairs
+enum COMPRESSION {COMPRESS_NONE, COMPRESS_FLOAT, COMPRESS_TOPK};
+
+/*
+ * Every message is a 20 byte header followed by a payload:
+ *   HELLO    worker -> server  int64 number of parameters, int64 rows in the worker's shard, then rank 0's initial parameters
+ *   WELCOME  server -> worker  int64 rows in the largest shard, then the initial parameters every replica starts from
+ *   PUSH     worker -> server  the worker's update since the last round, count values in the encoding of the header
+ *   UPDATE   server -> worker  the average of the round's updates, same encoding
+ *   DONE     worker -> server  no payload, sent by every worker in place of its last PUSH
+ */
+struct SyncHeader{
+    uint32_t type;
+    uint32_t rank;
+    uint32_t encoding;
+    uint32_t count;
+    uint32_t rows;      //rows a PUSH trained on since the last round
+};
+
+enum SYNC_TYPE {SYNC_HELLO=1, SYNC_WELCOME=2, SYNC_PUSH=3, SYNC_UPDATE=4, SYNC_DONE=5};
+
+struct DistributedOptions{
+    int sync_rows;                  //rows every worker trains on between two synchronizations
+    COMPRESSION compression;
+    double topk_fraction;
+    double connect_timeout_secs;    //how long workers retry while the server isn't listening yet
+    double accept_timeout_secs;     //how long the server waits for every worker to connect (workers load their data first)
+
+    DistributedOptions(){
+        sync_rows=256;
+        compression=COMPRESS_NONE;
+        topk_fraction=0.01;
+        connect_timeout_secs=30;
+        accept_timeout_secs=300;
+    }
+};
+
+struct SyncStats{
+    long rounds;
+    long rows;
+    long bytes_sent;
+    long bytes_received;
+    double compute_secs;
+    double sync_secs;
+
+    SyncStats(){
+        rounds=0;
+        rows=0;
+        bytes_sent=0;
+        bytes_received=0;
+        compute_secs=0;
+        sync_secs=0;
+    }
+
+    double rows_per_sec() const {return compute_secs+sync_secs>0 ? rows/(compute_secs+sync_secs) : 0;}
+
+    void print(ostream& os) const {
+        os<<"rounds "<<rounds<<" rows "<<rows<<" ("<<rows_per_sec()<<" rows/s) compute "<<compute_secs<<"s sync "<<sync_secs
+          <<"s sent "<<bytes_sent<<" bytes received "<<bytes_received<<" bytes"<<endl;
+    }
+};
+
+//the wire encodings of an update, shared by the workers and the server
+class UpdateCodec{
+
+private:
+
+    struct SparseValue{
+        uint32_t index;
+        float value;
+    };
+
+public:
+
+    static size_t value_bytes(COMPRESSION c){
+        return c==COMPRESS_NONE ? sizeof(double) : c==COMPRESS_FLOAT ? sizeof(float) : sizeof(SparseValue);
+    }
+
+    static const char* name(COMPRESSION c){
+        return c==COMPRESS_NONE ? "none" : c==COMPRESS_FLOAT ? "float" : "topk";
+    }
+
+    //encodes the n values into buf and returns how many were encoded
+    //whatever the encoding loses is left in values, so it goes out with a later update instead of getting dropped
+    static uint32_t encode(COMPRESSION c, double* values, long n, double fraction, vector<char>& buf, vector<uint32_t>& order){
+        if(c==COMPRESS_NONE){
+            buf.resize(sizeof(double)*n);
+            memcpy(buf.data(), values, sizeof(double)*n);
+            memset(values, 0, sizeof(double)*n);
+            return (uint32_t)n;
+        }
+        if(c==COMPRESS_FLOAT){
+            buf.resize(sizeof(float)*n);
+            float* out = (float*)buf.data();
+            for(long i=0;i<n;i++){
+                out[i] = (float)values[i];
+                values[i] -= out[i];
+            }
+            return (uint32_t)n;
+        }
+        long k = min(n, max(1L, (long)ceil(fraction*n)));
+        order.resize(n);
+        iota(order.begin(), order.end(), 0);
+        nth_element(order.begin(), order.begin()+(k-1), order.end(), [values](uint32_t a, uint32_t b){
+            return fabs(values[a])>fabs(values[b]);
+        });
+        buf.resize(sizeof(SparseValue)*k);
+        SparseValue* out = (SparseValue*)buf.data();
+        for(long j=0;j<k;j++){
+            out[j].index = order[j];
+            out[j].value = (float)values[order[j]];
+            values[order[j]] -= out[j].value;
+        }
+        return (uint32_t)k;
+    }
+
+    //sparse encoding of just the entries listed in indices, with the same error feedback
+    static uint32_t encode_sparse(double* values, const vector<uint32_t>& indices, vector<char>& buf){
+        buf.resize(sizeof(SparseValue)*indices.size());
+        SparseValue* out = (SparseValue*)buf.data();
+        for(size_t j=0;j<indices.size();j++){
+            out[j].index = indices[j];
+            out[j].value = (float)values[indices[j]];
+            values[indices[j]] -= out[j].value;
+        }
+        return (uint32_t)indices.size();
+    }
+
+    //adds scale times the decoded values to out, touched (if given) collects the indices of sparse values it hasn't seen yet
+    static void add(COMPRESSION c, const char* buf, uint32_t count, long n, double scale, double* out,
+                    vector<uint32_t>* touched=NULL, vector<char>* seen=NULL){
+        if(c==COMPRESS_NONE){
+            const double* in = (const double*)buf;
+            for(uint32_t i=0;i<count;i++) out[i] += scale*in[i];
+        }
+        else if(c==COMPRESS_FLOAT){
+            const float* in = (const float*)buf;
+            for(uint32_t i=0;i<count;i++) out[i] += scale*in[i];
+        }
+        else{
+            const SparseValue* in = (const SparseValue*)buf;
+            for(uint32_t j=0;j<count;j++){
+                if(in[j].index>=n) throw runtime_error("sparse update index out of range\n");
+                out[in[j].index] += scale*in[j].value;
+                if(touched && !(*seen)[in[j].index]){
+                    (*seen)[in[j].index]=1;
+                    touched->push_back(in[j].index);
+                }
+            }
+        }
+    }
+};
+
+//sends a header and its payload, returns false if the connection is gone
+static bool send_sync(int fd, long& bytes, uint32_t type, uint32_t rank, uint32_t encoding, uint32_t count, uint32_t rows,
+                      const void* payload, size_t payload_bytes){
+    SyncHeader h = {type, rank, encoding, count, rows};
+    bytes += sizeof(h)+payload_bytes;
+    return write_full(fd, &h, sizeof(h)) && (payload_bytes==0 || write_full(fd, payload, payload_bytes));
+}
+
+/*
+ * Synchronous rounds: every worker pushes its update, the server averages them into one update and sends it back to
+ * every worker, which applies it to the parameters of the last round and continues from there. The server only keeps
+ * the running average (and the bits its own encoding lost), so any number of parameters fit, and every replica
+ * applies exactly the same decoded update, so they all agree on the parameters after every round.
+ */
+class ParameterServer{
+
+private:
+    string address;
+    int num_workers;
+    double accept_timeout_secs;
+    SyncStats stats;
+
+    void fail(const string& what){
+        cerr<<"Error. Parameter server: "<<what<<endl;
+        throw runtime_error(what+"\n");
+    }
+
+public:
+
+    ParameterServer(string address, int num_workers, double accept_timeout_secs=300){
+        if(num_workers<1){
+            cerr<<"Error. A parameter server needs at least one worker\n";
+            throw invalid_argument("invalid number of workers\n");
+        }
+        this->address=address;
+        this->num_workers=num_workers;
+        this->accept_timeout_secs=accept_timeout_secs;
+    }
+
+    //accepts every worker, then averages their updates until all of them are done
+    //fails if not every worker connected within accept_timeout_secs, e.g. because one of them died while loading
+    void serve(){
+
+        signal(SIGPIPE, SIG_IGN);
+        int listen_fd = SocketAddress::listen_on(address, num_workers);
+
+        //the workers in rank order
+        vector<int> fds(num_workers, -1);
+        long num_params=-1, max_rows=0;
+        COMPRESSION compression=COMPRESS_NONE;
+        vector<double> initial;
+        auto deadline = chrono::steady_clock::now()+chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(accept_timeout_secs));
+        for(int i=0;i<num_workers;i++){
+            int fd = SocketAddress::accept_on(listen_fd, deadline);
+            if(fd<0 && errno==ETIMEDOUT){
+                close(listen_fd);
+                fail("only "+to_string(i)+" of "+to_string(num_workers)+" workers connected within "+to_string((int)accept_timeout_secs)+"s");
+            }
+            SyncHeader h;
+            int64_t hello[2];
+            if(fd<0 || !read_full(fd, &h, sizeof(h)) || h.type!=SYNC_HELLO || !read_full(fd, hello, sizeof(hello))) fail("invalid hello");
+            if(h.rank>=(uint32_t)num_workers || fds[h.rank]>=0) fail("invalid or duplicate rank "+to_string(h.rank));
+            if(i>0 && (hello[0]!=num_params || h.encoding!=compression)) fail("workers disagree on the parameters or compression");
+            fds[h.rank]=fd;
+            num_params = hello[0];
+            compression = (COMPRESSION)h.encoding;
+            max_rows = max(max_rows, (long)hello[1]);
+            if(h.count>0){
+                if(h.count!=num_params) fail("invalid initial parameters");
+                initial.resize(num_params);
+                if(!read_full(fd, initial.data(), sizeof(double)*num_params)) fail("connection lost");
+            }
+            stats.bytes_received += sizeof(h)+sizeof(hello)+sizeof(double)*h.count;
+        }
+        close(listen_fd);
+        if(initial.empty()) fail("rank 0 sent no initial parameters");
+
+        vector<char> welcome(sizeof(int64_t)+sizeof(double)*num_params);
+        int64_t rows64 = max_rows;
+        memcpy(welcome.data(), &rows64, sizeof(rows64));
+        memcpy(welcome.data()+sizeof(rows64), initial.data(), sizeof(double)*num_params);
+        for(int r=0;r<num_workers;r++){
+            if(!send_sync(fds[r], stats.bytes_sent, SYNC_WELCOME, r, compression, (uint32_t)num_params, 0, welcome.data(), welcome.size())){
+                fail("connection lost");
+            }
+        }
+
+        auto start = chrono::steady_clock::now();
+        vector<double> average(num_params, 0);
+        vector<char> buf, out;
+        vector<uint32_t> order, touched;
+        vector<char> seen(compression==COMPRESS_TOPK ? num_params : 0, 0);
+        while(true){
+            int done=0;
+            for(int r=0;r<num_workers;r++){
+                SyncHeader h;
+                if(!read_full(fds[r], &h, sizeof(h))) fail("connection to worker "+to_string(r)+" lost");
+                stats.bytes_received += sizeof(h);
+                if(h.type==SYNC_DONE){
+                    done++;
+                    continue;
+                }
+                if(h.type!=SYNC_PUSH || h.encoding!=compression || h.count>num_params) fail("invalid update from worker "+to_string(r));
+                buf.resize(UpdateCodec::value_bytes(compression)*h.count);
+                if(!read_full(fds[r], buf.data(), buf.size())) fail("connection to worker "+to_string(r)+" lost");
+                stats.bytes_received += buf.size();
+                stats.rows += h.rows;
+                UpdateCodec::add(compression, buf.data(), h.count, num_params, 1.0/num_workers, average.data(), &touched, &seen);
+            }
+            if(done==num_workers) break;
+            if(done>0) fail("workers disagree on the number of rounds");
+
+            uint32_t count;
+            if(compression==COMPRESS_TOPK){
+                count = UpdateCodec::encode_sparse(average.data(), touched, out);
+                for(uint32_t i : touched) seen[i]=0;
+                touched.clear();
+            }
+            else count = UpdateCodec::encode(compression, average.data(), num_params, 1, out, order);
+            for(int r=0;r<num_workers;r++){
+                if(!send_sync(fds[r], stats.bytes_sent, SYNC_UPDATE, r, compression, count, 0, out.data(), out.size())){
+                    fail("connection to worker "+to_string(r)+" lost");
+                }
+            }
+            stats.rounds++;
+        }
+        stats.sync_secs = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+
+        for(int fd : fds) close(fd);
+    }
+
+    //rows are the total over all workers and sync_secs the time from the first round to the last
+    const SyncStats& get_stats() const {return stats;}
+};
+
+class DistributedWorker{
+
+private:
+    MLPNetwork& net;
+    string address;
+    int rank;
+    DistributedOptions options;
+    SyncStats stats;
+
+    int fd;
+    long num_params;
+    vector<double> params;
+    vector<double> global;  //parameters after the last round, the same on every worker
+    vector<double> update;  //the change since then plus whatever earlier encodings lost
+    vector<char> buf;
+    vector<uint32_t> order;
+
+    DistributedWorker(const DistributedWorker&);
+    DistributedWorker& operator=(const DistributedWorker&);
+
+    void fail(const string& what){
+        cerr<<"Error. Worker "<<rank<<": "<<what<<endl;
+        throw runtime_error(what+"\n");
+    }
+
+    //connects, agrees on the shard size with the other workers and starts from rank 0's parameters
+    long join(long shard_rows){
+        signal(SIGPIPE, SIG_IGN);
+        fd = SocketAddress::connect_to(address, options.connect_timeout_secs);
+
+        int64_t hello[2] = {num_params, shard_rows};
+        vector<char> payload(sizeof(hello)+(rank==0 ? sizeof(double)*num_params : 0));
+        memcpy(payload.data(), hello, sizeof(hello));
+        if(rank==0){
+            net.get_parameters(params.data());
+            memcpy(payload.data()+sizeof(hello), params.data(), sizeof(double)*num_params);
+        }
+        if(!send_sync(fd, stats.bytes_sent, SYNC_HELLO, rank, options.compression, rank==0 ? (uint32_t)num_params : 0, 0,
+                      payload.data(), payload.size())) fail("connection to parameter server lost");
+
+        SyncHeader h;
+        int64_t max_rows;
+        if(!read_full(fd, &h, sizeof(h)) || h.type!=SYNC_WELCOME || h.count!=num_params || !read_full(fd, &max_rows, sizeof(max_rows))
+           || !read_full(fd, global.data(), sizeof(double)*num_params)) fail("invalid welcome from parameter server");
+        stats.bytes_received += sizeof(h)+sizeof(max_rows)+sizeof(double)*num_params;
+        net.set_parameters(global.data());
+        return max_rows;
+    }
+
+    void sync(uint32_t rows){
+        net.get_parameters(params.data());
+        for(long i=0;i<num_params;i++) update[i] += params[i]-global[i];
+        uint32_t count = UpdateCodec::encode(options.compression, update.data(), num_params, options.topk_fraction, buf, order);
+        if(!send_sync(fd, stats.bytes_sent, SYNC_PUSH, rank, options.compression, count, rows, buf.data(), buf.size())){
+            fail("connection to parameter server lost");
+        }
+
+        SyncHeader h;
+        if(!read_full(fd, &h, sizeof(h)) || h.type!=SYNC_UPDATE || h.encoding!=options.compression || h.count>num_params){
+            fail("invalid update from parameter server");
+        }
+        buf.resize(UpdateCodec::value_bytes(options.compression)*h.count);
+        if(!read_full(fd, buf.data(), buf.size())) fail("connection to parameter server lost");
+        stats.bytes_received += sizeof(h)+buf.size();
+        UpdateCodec::add(options.compression, buf.data(), h.count, num_params, 1, global.data());
+        net.set_parameters(global.data());
+        stats.rounds++;
+    }
+
+public:
+
+    //rank runs from 0 to the number of workers the server waits for, rank 0's parameters are the ones every replica starts from
+    DistributedWorker(MLPNetwork& net, string address, int rank, const DistributedOptions& options=DistributedOptions()) : net(net){
+        if(options.sync_rows<1 || options.topk_fraction<=0 || options.topk_fraction>1){
+            cerr<<"Error. DistributedWorker needs a positive number of sync rows and a top-k fraction in (0, 1]\n";
+            throw invalid_argument("invalid distributed options\n");
+        }
+        this->address=address;
+        this->rank=rank;
+        this->options=options;
+        fd=-1;
+        num_params = net.get_num_parameters();
+        params = vector<double>(num_params);
+        global = vector<double>(num_params);
+        update = vector<double>(num_params, 0);
+    }
+
+    //trains num_epochs over rows (this worker's shard of data, reshuffled every epoch) and syncs every sync_rows rows
+    //every worker runs as many rounds as the largest shard needs, so shards may differ in size
+    void train(Dataset& data, vector<long> rows, int num_epochs, unsigned seed=420){
+        long max_rows = join((long)rows.size());
+        long rounds = (max_rows+options.sync_rows-1)/options.sync_rows;
+        long n = (long)rows.size();
+        Entry scratch(data.getMeta().get_input_layer_size(), data.getMeta().get_output_layer_size());
+
+        for(int epoch=0;epoch<num_epochs;epoch++){
+            FoldPlan::shuffle_indices(rows, CounterRNG(seed, RNG_WORKER_SHUFFLE, rank, epoch));
+            for(long round=0;round<rounds;round++){
+                auto start = chrono::steady_clock::now();
+                long begin = min(n, round*options.sync_rows), end = min(n, begin+options.sync_rows);
+                for(long j=begin;j<end;j++){
+                    if(j+PREFETCH_DISTANCE<end) data.prefetchEntry(rows[j+PREFETCH_DISTANCE]);
+                    net.train(data.getEntry(rows[j], scratch));
+                }
+                auto trained = chrono::steady_clock::now();
+                sync((uint32_t)(end-begin));
+                stats.rows += end-begin;
+                stats.compute_secs += chrono::duration<double>(trained-start).count();
+                stats.sync_secs += chrono::duration<double>(chrono::steady_clock::now()-trained).count();
+            }
+        }
+
+        if(!send_sync(fd, stats.bytes_sent, SYNC_DONE, rank, options.compression, 0, 0, NULL, 0)) fail("connection to parameter server lost");
+        close(fd);
+        fd=-1;
+    }
+
+    const SyncStats& get_stats() const {return stats;}
+
+    ~DistributedWorker(){
+        if(fd>=0) close(fd);
+    }
+};
+
+#endif /* Distributed_h */
@@ -0,0 +1,268 @@
+/*
+ * Filename: Ensemble.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains an ensemble of MLP networks with the same topology (e.g. the fold models of cross_validate)
+ * that scores all members at once and averages their outputs.
+ */
+
+#ifndef Ensemble_h
+#define Ensemble_h
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <limits>
+#include <cstring>
+#include <stdexcept>
+#include "Backend.h"
+
+#include "Network.h"
+#include "MemoryPlan.h"
+
+using namespace std;
+
+//weight bytes of the members stacked into one first layer GEMM, more members per GEMM stream their weights from memory
+//once per pair of rows with the native kernels instead of reading them from cache
+#ifndef ENSEMBLE_GEMM_BYTES
+#define ENSEMBLE_GEMM_BYTES (1L<<20)
+#endif
+
+/*
+ * The parameters of every layer are the members' parameters one after the other. For the first layer that is one
+ * (K*hidden) x inputs matrix, so the members read a batch of inputs in one wide GEMM (one per ENSEMBLE_GEMM_BYTES of
+ * weights). The activations of layer i are rows of K*sizes[i] values, member k owning columns [k*sizes[i], (k+1)*sizes[i]),
+ * and every later layer is still one GEMM per member on its column slice, with the stacked biases and the activation
+ * function applied to all members together. Single rows use gemv instead of GEMM.
+ */
+class MLPEnsemble{
+
+private:
+    vector<int> sizes;
+    Network::ACTIVATION activation;
+    int num_members;
+    int capacity;            //members the stacked arrays have room for
+    vector<int> stacked;     //stacked layer widths, the input is shared by all members
+
+    vector<double*> weights; //weights[i] holds every member's weights from layer i to layer i+1
+    vector<double*> biases;  //biases[i] holds every member's biases of layer i+1
+
+    static double* grow(double* stacked, long used, long size){
+        double* grown = (double*)Backend::aligned_malloc(sizeof(double)*size, DATA_ALIGNMENT);
+        if(used>0) memcpy(grown, stacked, sizeof(double)*used);
+        Backend::aligned_free(stacked);
+        return grown;
+    }
+
+    MLPEnsemble(const MLPEnsemble&);
+    MLPEnsemble& operator=(const MLPEnsemble&);
+
+    //out (num_rows x n, row stride ldo) += in (num_rows x k, row stride ldi) W^T, a gemv for a single row, which the BLAS
+    //libraries handle much faster than a gemm with one row
+    static void product(int num_rows, int n, int k, const double* in, int ldi, const double* w, double* out, int ldo){
+        if(num_rows==1) Backend::gemv(Backend::NoTrans, n, k, 1, w, k, in, 1, out);
+        else Backend::gemm(Backend::NoTrans, Backend::Trans, num_rows, n, k, 1, in, ldi, w, k, 1, out, ldo);
+    }
+
+public:
+
+    //activations of every member for up to capacity rows, planned like MLPNetwork::Workspace
+    class Workspace{
+
+    private:
+        int capacity;
+        vector<int> sizes;
+        Arena arena;
+
+        Workspace(const Workspace&);
+        Workspace& operator=(const Workspace&);
+
+    public:
+
+        Workspace(){
+            capacity=0;
+        }
+
+        Workspace(const MLPEnsemble& ensemble, int rows=1) : Workspace() {reserve(ensemble, rows);}
+
+        //replans if the ensemble's stacked layers differ (other members or another ensemble) or more rows are needed
+        void reserve(const MLPEnsemble& ensemble, int num_rows){
+            if(num_rows>capacity || sizes!=ensemble.stacked){
+                capacity = max(num_rows, capacity);
+                sizes = ensemble.stacked;
+                arena.reset(MemoryPlan::inference(sizes, capacity));
+            }
+        }
+
+        int get_capacity() const {return capacity;}
+
+        //true if the workspace was planned for the ensemble's current stacked layers and holds num_rows rows
+        bool fits(const MLPEnsemble& ensemble, int num_rows) const {return num_rows<=capacity && sizes==ensemble.stacked;}
+        double* layer(int i) const {return arena.get(MemoryPlan::layer_buffer(i));}
+    };
+
+    MLPEnsemble(){
+        num_members=0;
+        capacity=0;
+        activation=Network::LOGISTIC;
+    }
+
+    //makes room for num_members members without copying the stacked arrays again, add grows them by doubling otherwise
+    void reserve(int num_members){
+        if(num_members<=capacity || sizes.empty()) return;
+        for(int i=0;i<(int)sizes.size()-1;i++){
+            long w = (long)sizes[i]*sizes[i+1], b = sizes[i+1];
+            weights[i] = grow(weights[i], w*this->num_members, w*num_members);
+            biases[i] = grow(biases[i], b*this->num_members, b*num_members);
+        }
+        capacity = num_members;
+    }
+
+    //adds a copy of net, every member must have the same layer sizes and activation
+    void add(const MLPNetwork& net){
+        if(num_members>0 && (net.get_sizes()!=sizes || net.get_activation()!=activation)){
+            cerr<<"Error. Ensemble members must have the same topology and activation\n";
+            throw invalid_argument("ensemble member shape mismatch\n");
+        }
+        if(num_members==0){
+            sizes = net.get_sizes();
+            activation = net.get_activation();
+            weights = vector<double*>(sizes.size()-1, (double*)NULL);
+            biases = vector<double*>(sizes.size()-1, (double*)NULL);
+        }
+        if(num_members==capacity) reserve(max(4, 2*capacity));
+        for(int i=0;i<(int)sizes.size()-1;i++){
+            long w = (long)sizes[i]*sizes[i+1], b = sizes[i+1];
+            memcpy(weights[i]+w*num_members, net.get_weights(i), sizeof(double)*w);
+            memcpy(biases[i]+b*num_members, net.get_biases(i), sizeof(double)*b);
+        }
+        num_members++;
+        stacked = sizes;
+        for(size_t i=1;i<stacked.size();i++) stacked[i]*=num_members;
+    }
+
+    //adds any Network that writes the MLPNetwork model format
+    void add(const Network& net){
+        stringstream model;
+        net.save(model);
+        MLPNetwork copy(model);
+        add(copy);
+    }
+
+    //a CVOptions::fold_trained callback that keeps every fold model of a cross_validate run
+    function<void(int, const Network&)> collector(){
+        return [this](int, const Network& net){add(net);};
+    }
+
+    int get_num_members() const {return num_members;}
+    const vector<int>& get_sizes() const {return sizes;}
+    int get_input_size() const {return sizes.front();}
+    int get_output_size() const {return sizes.back();}
+
+    //averaged outputs (class probabilities or regression values) of every member for num_rows contiguous inputs
+    void forward_batch(const double* inputs, int num_rows, double* outputs, Workspace& ws) const {
+
+        if(num_members==0){
+            cerr<<"Error. Can't score with an empty ensemble\n";
+            throw logic_error("empty ensemble\n");
+        }
+        if(!ws.fits(*this, num_rows)){
+            cerr<<"Error. Workspace given to forward_batch was not reserved for this ensemble or holds fewer than "<<num_rows<<" rows\n";
+            throw invalid_argument("workspace does not fit ensemble or batch\n");
+        }
+
+        int K = num_members, num_layers = (int)sizes.size();
+        bool classification = sizes.back()>1;
+        const double* in = inputs;
+        for(int i=0;i<num_layers-1;i++){
+
+            double* out = ws.layer(i+1);
+            int n_in = sizes[i], n_out = sizes[i+1];
+            int wide_out = K*n_out;
+
+            for(int r=0;r<num_rows;r++) memcpy(out+(long)r*wide_out, biases[i], sizeof(double)*wide_out);
+
+            if(i==0){
+                //every member reads the same inputs: X W^T with the rows of a group of members stacked in W
+                int group = (int)max(1L, min((long)K, ENSEMBLE_GEMM_BYTES/((long)sizeof(double)*n_out*n_in)));
+                for(int k=0;k<K;k+=group){
+                    product(num_rows, min(group, K-k)*n_out, n_in, in, n_in, weights[0]+(long)k*n_out*n_in, out+(long)k*n_out, wide_out);
+                }
+            }
+            else{
+                //member k only reads its own column slice of the previous layer
+                for(int k=0;k<K;k++){
+                    product(num_rows, n_out, n_in, in+(long)k*n_in, K*n_in, weights[i]+(long)k*n_out*n_in, out+(long)k*n_out, wide_out);
+                }
+            }
+
+            if(i<num_layers-2) MLPNetwork::apply_activation(activation, out, num_rows*wide_out);
+            in = out;
+        }
+
+        //average the members' outputs, softmax is fused in so every exp is taken once
+        int n_out = sizes.back();
+        for(int r=0;r<num_rows;r++){
+            double* member_outputs = ws.layer(num_layers-1)+(long)r*K*n_out;
+            double* avg = outputs+(long)r*n_out;
+            for(int j=0;j<n_out;j++) avg[j]=0;
+            for(int k=0;k<K;k++){
+                double* o = member_outputs+(long)k*n_out;
+                if(!classification){
+                    avg[0]+=o[0]/K;
+                    continue;
+                }
+                double max = -numeric_limits<double>::infinity();
+                for(int j=0;j<n_out;j++) max = o[j]>max ? o[j] : max;
+                double total=0;
+                for(int j=0;j<n_out;j++){
+                    o[j]=exp(o[j]-max);
+                    total+=o[j];
+                }
+                for(int j=0;j<n_out;j++) avg[j]+=o[j]/(total*K);
+            }
+        }
+    }
+
+    //sparse entries are rejected, the first layer GEMM reads dense rows
+    static void check_dense(const Entry& e){
+        if(e.isSparse()){
+            cerr<<"Error. MLPEnsemble scores dense entries only\n";
+            throw invalid_argument("sparse entry given to ensemble\n");
+        }
+    }
+
+    string classify(const Entry& e, const vector<string>& classlabels, Workspace& ws) const {
+        check_dense(e);
+        if((int)classlabels.size()!=sizes.back()){
+            cerr<<"Error. Classlabel list must be the same size as output layer\n";
+            throw invalid_argument("invalid label list or network architecture\n");
+        }
+        vector<double> probabilities(sizes.back());
+        forward_batch(e.data, 1, probabilities.data(), ws);
+        int prediction_index=0;
+        for(int i=1;i<(int)probabilities.size();i++) if(probabilities[i]>probabilities[prediction_index]) prediction_index=i;
+        return classlabels.at(prediction_index);
+    }
+
+    double predict(const Entry& e, Workspace& ws) const {
+        check_dense(e);
+        if(sizes.back()!=1){
+            cerr<<"Error. Regression tasks can only have one output. Use MLPEnsemble::classify for classification tasks\n";
+            throw invalid_argument("invalid network architecture\n");
+        }
+        double prediction;
+        forward_batch(e.data, 1, &prediction, ws);
+        return prediction;
+    }
+
+    ~MLPEnsemble(){
+        for(double* w : weights) Backend::aligned_free(w);
+        for(double* b : biases) Backend::aligned_free(b);
+    }
+};
+
+#endif /* Ensemble_h */
@@ -9,14 +9,10 @@
 #ifndef Entry_h
 #define Entry_h
 
-#ifndef DATA_ALIGNMENT
-#define DATA_ALIGNMENT 64
-#endif
-
 #include <string>
 #include <functional>
 
-#include <mkl.h>
+#include "Backend.h"
 
 using namespace std;
 
@@ -31,36 +27,50 @@ public:
     double* data;
     double* expected;
     
+    //optional compressed sparse view of the input, set by datasets that store rows sparsely (data is then not filled)
+    //the view doesn't own its arrays, nnz is -1 when the entry is dense
+    const int* sparse_indices;
+    const double* sparse_values;
+    int nnz;
+    
     Entry(){
         data_size=0;
         expected_size=0;
         classlabel="";
         data=NULL;
         expected=NULL;
+        clearSparse();
     }
     
     Entry(int input_vector_size, int expected_vector_size){
         data_size=input_vector_size;
         expected_size=expected_vector_size;
-        data = (double*)MKL_malloc(sizeof(double)*data_size, DATA_ALIGNMENT);
-        expected = (double*)MKL_malloc(sizeof(double)*expected_size, DATA_ALIGNMENT);
+        clearSparse();
+        data = (double*)Backend::aligned_malloc(sizeof(double)*data_size, DATA_ALIGNMENT);
+        expected = (double*)Backend::aligned_malloc(sizeof(double)*expected_size, DATA_ALIGNMENT);
     }
     
     Entry(const Entry& other){
         data_size=other.get_data_size();
         expected_size=other.get_expected_size();
-        data = (double*)MKL_malloc(sizeof(double)*data_size, DATA_ALIGNMENT);
-        expected = (double*)MKL_malloc(sizeof(double)*expected_size, DATA_ALIGNMENT);
+        data = (double*)Backend::aligned_malloc(sizeof(double)*data_size, DATA_ALIGNMENT);
+        expected = (double*)Backend::aligned_malloc(sizeof(double)*expected_size, DATA_ALIGNMENT);
         
         for(int i=0;i<data_size;i++) data[i]=other.data[i];
         for(int i=0;i<expected_size;i++) expected[i]=other.expected[i];
         classlabel = other.getClass();
+        sparse_indices = other.sparse_indices;
+        sparse_values = other.sparse_values;
+        nnz = other.nnz;
         
     }
     
-    Entry(Entry&& other) //noexcept
-      : data(nullptr), expected(nullptr), data_size(0), expected_size(0), classlabel("")
+    Entry(Entry&& other) noexcept
+      : data_size(0), expected_size(0), classlabel(""), data(nullptr), expected(nullptr), sparse_indices(nullptr), sparse_values(nullptr), nnz(-1)
     {
+        swap(sparse_indices, other.sparse_indices);
+        swap(sparse_values, other.sparse_values);
+        swap(nnz, other.nnz);
         swap(data, other.data);
         swap(expected, other.expected);
         swap(data_size, other.data_size);
@@ -68,6 +78,11 @@ public:
         swap(classlabel, other.classlabel);
     }
     
+    Entry& operator=(Entry other){
+        swap(*this, other);
+        return *this;
+    }
+    
     friend void swap(Entry& first, Entry& second) noexcept {
         using std::swap;
         swap(first.data_size, second.data_size);
@@ -75,9 +90,27 @@ public:
         swap(first.classlabel, second.classlabel);
         swap(first.data, second.data);
         swap(first.expected, second.expected);
+        swap(first.sparse_indices, second.sparse_indices);
+        swap(first.sparse_values, second.sparse_values);
+        swap(first.nnz, second.nnz);
+    }
+    
+    //points the entry at the nnz (index, value) pairs of a sparse row, indices ascending
+    void setSparse(const int* indices, const double* values, int nnz){
+        sparse_indices=indices;
+        sparse_values=values;
+        this->nnz=nnz;
     }
     
-    void setClass(string classlabel){ this->classlabel=classlabel;}
+    void clearSparse(){
+        sparse_indices=NULL;
+        sparse_values=NULL;
+        nnz=-1;
+    }
+    
+    bool isSparse() const {return nnz>=0;}
+    
+    void setClass(const string& classlabel){ this->classlabel=classlabel;}
     
     string getClass() const{ return classlabel;}
     
@@ -90,6 +123,19 @@ public:
     void inc_data_size() {data_size++;}
     void inc_expected_size() {expected_size++;}
 
+    //pulls the arrays into cache ahead of training on this entry
+    void prefetch() const {
+        if(isSparse()){
+            __builtin_prefetch(sparse_indices);
+            __builtin_prefetch(sparse_values);
+            __builtin_prefetch(expected);
+            return;
+        }
+        const char* bytes = (const char*)data;
+        for(int offset=0; offset<data_size*(int)sizeof(double); offset+=64) __builtin_prefetch(bytes+offset);
+        __builtin_prefetch(expected);
+    }
+    
     bool isMissing(int data_index_start, int data_index_end){
         
         if(data_index_end-1==data_index_start) return isnan(data[data_index_start]);
@@ -100,8 +146,8 @@ public:
     }
     
     ~Entry(){
-        MKL_free(data);
-        MKL_free(expected);
+        Backend::aligned_free(data);
+        Backend::aligned_free(expected);
     }
     
 };
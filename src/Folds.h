@@ -0,0 +1,94 @@
+/*
+ * Filename: Folds.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains index permutation views of a dataset used to build cross validation folds and epoch orderings without moving entries.
+ */
+
+#ifndef Folds_h
+#define Folds_h
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <unordered_map>
+
+#include "Dataset.h"
+#include "Random.h"
+
+#ifndef PREFETCH_DISTANCE
+#define PREFETCH_DISTANCE 4
+#endif
+
+using namespace std;
+
+//splits the rows of a dataset into folds as one permutation of row indices, fold f is order[bounds[f], bounds[f+1])
+//stratified folds deal the rows of every class out round robin so each fold keeps the class proportions of the dataset
+class FoldPlan{
+
+private:
+    vector<long> order;
+    vector<long> bounds;
+
+public:
+
+    FoldPlan(Dataset& data, int num_folds, unsigned seed=420, bool stratified=false){
+
+        long num_entries = data.getSize();
+
+        if(stratified){
+            //group rows by class in the order the class values are declared so the plan only depends on the seed
+            unordered_map<string, vector<long>> by_class;
+            for(long i=0;i<num_entries;i++) by_class[data.getEntryClass(i)].push_back(i);
+
+            vector<vector<long>> folds(num_folds);
+            int next_fold=0;
+            vector<string>& class_values = data.getMeta().get_class_values();
+            for(size_t c=0;c<class_values.size();c++){
+                vector<long>& rows = by_class[class_values[c]];
+                shuffle_indices(rows, CounterRNG(seed, RNG_FOLDS, (uint32_t)c+1));
+                for(long row : rows){
+                    folds[next_fold].push_back(row);
+                    next_fold = (next_fold+1)%num_folds;
+                }
+            }
+
+            bounds.push_back(0);
+            for(vector<long>& fold : folds){
+                order.insert(order.end(), fold.begin(), fold.end());
+                bounds.push_back((long)order.size());
+            }
+        }
+        else{
+            order = vector<long>(num_entries);
+            CounterPermutation perm(CounterRNG(seed, RNG_FOLDS), num_entries);
+            for(long i=0;i<num_entries;i++) order[i]=(long)perm(i);
+            for(int f=0;f<=num_folds;f++) bounds.push_back(num_entries*f/num_folds);
+        }
+    }
+
+    int get_num_folds() const {return (int)bounds.size()-1;}
+
+    //rows held out for testing in fold f
+    const long* test_begin(int f) const {return order.data()+bounds.at(f);}
+    const long* test_end(int f) const {return order.data()+bounds.at(f+1);}
+    long test_size(int f) const {return bounds.at(f+1)-bounds.at(f);}
+
+    //every row not held out in fold f
+    void train_indices(int f, vector<long>& out) const {
+        out.clear();
+        out.insert(out.end(), order.begin(), order.begin()+bounds.at(f));
+        out.insert(out.end(), order.begin()+bounds.at(f+1), order.end());
+    }
+
+    //reorders the rows of an epoch by the permutation rng keys, O(n) index copies instead of moving entries
+    //every slot is computed on its own so the order is the same for any num_threads
+    static void shuffle_indices(vector<long>& rows, const CounterRNG& rng, int num_threads=1){
+        vector<long> shuffled(rows.size());
+        CounterPermutation(rng, rows.size()).gather(rows.data(), shuffled.data(), num_threads);
+        rows.swap(shuffled);
+    }
+};
+
+#endif /* Folds_h */
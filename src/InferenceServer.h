@@ -0,0 +1,374 @@
+/*
+ * Filename: InferenceServer.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a local inference server that collects concurrent scoring requests into micro-batches
+ * and runs them through MLPNetwork's batched forward pass, the framed protocol it speaks, and a small client for it.
+ */
+
+#ifndef InferenceServer_h
+#define InferenceServer_h
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "Autotune.h"
+#include "Socket.h"
+
+using namespace std;
+
+/*
+ * Every message in either direction is a 12 byte header followed by count doubles:
+ *   uint32 type | uint32 id | uint32 count | double[count]
+ * SCORE requests carry one encoded input vector and are answered with the output layer (probabilities or the regression value).
+ * STATS and INFO requests carry no payload. ERROR responses carry no payload and echo the request id.
+ */
+struct FrameHeader{
+    uint32_t type;
+    uint32_t id;
+    uint32_t count;
+};
+
+enum FRAME_TYPE {SCORE=1, STATS=2, INFO=3, FRAME_ERROR=4};
+
+//order of the doubles in a STATS response
+enum STATS_FIELD {STAT_REQUESTS, STAT_BATCHES, STAT_MEAN_BATCH, STAT_P50_US, STAT_P99_US, STAT_THROUGHPUT, NUM_STATS};
+
+//request latencies and throughput since the server started
+class LatencyStats{
+
+private:
+    mutex m;
+    vector<double> samples; //ring of the most recent latencies in microseconds
+    long next;
+    long requests;
+    long batches;
+    chrono::steady_clock::time_point start;
+
+public:
+
+    LatencyStats(int window=1<<16){
+        samples = vector<double>(window);
+        next=0;
+        requests=0;
+        batches=0;
+        start = chrono::steady_clock::now();
+    }
+
+    void record_batch(const double* latencies_us, int n){
+        lock_guard<mutex> lock(m);
+        for(int i=0;i<n;i++) samples[(next++)%samples.size()] = latencies_us[i];
+        requests+=n;
+        batches++;
+    }
+
+    vector<double> snapshot(){
+        vector<double> out(NUM_STATS, 0);
+        vector<double> window;
+        {
+            lock_guard<mutex> lock(m);
+            long n = min(next, (long)samples.size());
+            window.assign(samples.begin(), samples.begin()+n);
+            out[STAT_REQUESTS]=requests;
+            out[STAT_BATCHES]=batches;
+            out[STAT_MEAN_BATCH]= batches ? (double)requests/batches : 0;
+        }
+        if(!window.empty()){
+            size_t p50 = window.size()/2, p99 = min(window.size()-1, (size_t)(window.size()*0.99));
+            nth_element(window.begin(), window.begin()+p50, window.end());
+            out[STAT_P50_US]=window[p50];
+            nth_element(window.begin(), window.begin()+p99, window.end());
+            out[STAT_P99_US]=window[p99];
+        }
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+        out[STAT_THROUGHPUT] = elapsed>0 ? out[STAT_REQUESTS]/elapsed : 0;
+        return out;
+    }
+
+    static void print(ostream& os, const vector<double>& s){
+        os<<"requests "<<s[STAT_REQUESTS]<<" batches "<<s[STAT_BATCHES]<<" mean batch "<<s[STAT_MEAN_BATCH]
+          <<" p50 "<<s[STAT_P50_US]<<"us p99 "<<s[STAT_P99_US]<<"us throughput "<<s[STAT_THROUGHPUT]<<" req/s"<<endl;
+    }
+};
+
+class InferenceServer{
+
+private:
+
+    //an owned socket is closed when the last reference goes, i.e. after the reader returned and every queued request of the
+    //client was answered, so a response can never go to a later client that was given the same fd number
+    struct Connection{
+        int in_fd;
+        int out_fd;
+        bool owned;
+        mutex write_lock;
+
+        Connection(int in, int out, bool owned=false){in_fd=in; out_fd=out; this->owned=owned;}
+        ~Connection(){if(owned) close(in_fd);}
+
+        bool send(uint32_t type, uint32_t id, const double* payload, uint32_t count){
+            FrameHeader h = {type, id, count};
+            lock_guard<mutex> lock(write_lock);
+            return write_full(out_fd, &h, sizeof(h)) && write_full(out_fd, payload, sizeof(double)*count);
+        }
+    };
+
+    struct Request{
+        shared_ptr<Connection> conn;
+        uint32_t id;
+        chrono::steady_clock::time_point arrival;
+        vector<double> input;
+    };
+
+    const MLPNetwork& net;
+    int max_batch;
+    chrono::microseconds budget;
+    ExecutionConfig execution; //kernel and threads for scoring a batch, the batch size is max_batch
+
+    deque<Request> queue;
+    mutex queue_lock;
+    condition_variable queue_cv;
+    atomic<bool> running;
+
+    LatencyStats stats;
+
+    //waits for a first request, then keeps collecting until the batch is full or the oldest request has used up the latency budget
+    void batch_loop(){
+
+        int in_size = net.get_input_size(), out_size = net.get_output_size();
+        double* batch_in = (double*)Backend::aligned_malloc(sizeof(double)*max_batch*in_size, DATA_ALIGNMENT);
+        double* batch_out = (double*)Backend::aligned_malloc(sizeof(double)*max_batch*out_size, DATA_ALIGNMENT);
+        ExecutionConfig config = execution;
+        config.batch_size = max_batch;
+        vector<Request> batch;
+        vector<double> latencies(max_batch);
+
+        while(true){
+            {
+                unique_lock<mutex> lock(queue_lock);
+                queue_cv.wait(lock, [this]{return !queue.empty() || !running;});
+                if(queue.empty()) break;
+
+                auto deadline = queue.front().arrival + budget;
+                while(running && (int)queue.size()<max_batch && chrono::steady_clock::now()<deadline){
+                    queue_cv.wait_until(lock, deadline);
+                }
+
+                int n = min((int)queue.size(), max_batch);
+                for(int i=0;i<n;i++){
+                    batch.push_back(move(queue.front()));
+                    queue.pop_front();
+                }
+            }
+
+            int n = (int)batch.size();
+            for(int i=0;i<n;i++) memcpy(batch_in+(long)i*in_size, batch[i].input.data(), sizeof(double)*in_size);
+
+            Autotuner::run(net, config, batch_in, n, batch_out);
+
+            auto done = chrono::steady_clock::now();
+            for(int i=0;i<n;i++){
+                batch[i].conn->send(SCORE, batch[i].id, batch_out+(long)i*out_size, out_size);
+                latencies[i] = chrono::duration<double, micro>(done-batch[i].arrival).count();
+            }
+            stats.record_batch(latencies.data(), n);
+            batch.clear();
+        }
+
+        Backend::aligned_free(batch_in);
+        Backend::aligned_free(batch_out);
+    }
+
+    //reads frames from one client until it disconnects
+    void read_loop(shared_ptr<Connection> conn){
+
+        int in_size = net.get_input_size();
+        FrameHeader h;
+        while(read_full(conn->in_fd, &h, sizeof(h))){
+
+            if(h.type==SCORE && (int)h.count==in_size){
+                Request r;
+                r.conn=conn;
+                r.id=h.id;
+                r.input = vector<double>(h.count);
+                if(!read_full(conn->in_fd, r.input.data(), sizeof(double)*h.count)) break;
+                r.arrival = chrono::steady_clock::now();
+                {
+                    lock_guard<mutex> lock(queue_lock);
+                    queue.push_back(move(r));
+                }
+                queue_cv.notify_one();
+            }
+            else if(h.type==STATS){
+                vector<double> s = stats.snapshot();
+                conn->send(STATS, h.id, s.data(), (uint32_t)s.size());
+            }
+            else if(h.type==INFO){
+                double info[2] = {(double)in_size, (double)net.get_output_size()};
+                conn->send(INFO, h.id, info, 2);
+            }
+            else{
+                //the payload can't be trusted after a malformed frame, so drop the client
+                cerr<<"Error. Malformed frame of type "<<h.type<<" with "<<h.count<<" values from client\n";
+                conn->send(FRAME_ERROR, h.id, NULL, 0);
+                break;
+            }
+        }
+    }
+
+    void stop_batcher(thread& batcher, thread& reporter){
+        running=false;
+        queue_cv.notify_all();
+        batcher.join();
+        if(reporter.joinable()) reporter.join();
+    }
+
+    void start_batcher(thread& batcher, thread& reporter, int report_secs){
+        running=true;
+        batcher = thread(&InferenceServer::batch_loop, this);
+        if(report_secs>0){
+            reporter = thread([this, report_secs]{
+                while(running){
+                    this_thread::sleep_for(chrono::seconds(report_secs));
+                    LatencyStats::print(cerr, stats.snapshot());
+                }
+            });
+        }
+    }
+
+public:
+
+    InferenceServer(const MLPNetwork& net, int max_batch=64, int budget_us=500) : net(net){
+        if(max_batch<1){
+            cerr<<"Error. The maximum batch size must be at least 1\n";
+            throw invalid_argument("max_batch < 1\n");
+        }
+        this->max_batch=max_batch;
+        this->budget=chrono::microseconds(budget_us);
+        running=false;
+    }
+    
+    //picks the forward pass and thread count used for every batch, e.g. from Autotuner::tune
+    void set_execution(const ExecutionConfig& config){
+        if(running){
+            cerr<<"Error. The execution config can't be changed while the server is running\n";
+            throw logic_error("server already running\n");
+        }
+        execution=config;
+    }
+
+    LatencyStats& get_stats(){return stats;}
+
+    //serves a single client over stdin/stdout until stdin is closed
+    void serve_stdio(int report_secs=0){
+        thread batcher, reporter;
+        start_batcher(batcher, reporter, report_secs);
+
+        read_loop(make_shared<Connection>(STDIN_FILENO, STDOUT_FILENO));
+
+        stop_batcher(batcher, reporter);
+    }
+
+    //accepts clients on a unix domain socket, one reader thread per client, until the process is killed
+    void serve_unix(string path, int report_secs=0){
+
+        signal(SIGPIPE, SIG_IGN);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if(fd<0 || path.size()>=sizeof(addr.sun_path)){
+            cerr<<"Error. Unable to create socket "<<path<<endl;
+            throw invalid_argument("invalid socket path\n");
+        }
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path)-1);
+        unlink(path.c_str());
+        if(::bind(fd, (sockaddr*)&addr, sizeof(addr))<0 || listen(fd, 128)<0){
+            cerr<<"Error. Unable to listen on socket "<<path<<endl;
+            throw runtime_error("unable to listen on socket\n");
+        }
+
+        thread batcher, reporter;
+        start_batcher(batcher, reporter, report_secs);
+
+        while(true){
+            int client = accept(fd, NULL, NULL);
+            if(client<0){
+                if(errno==EINTR || errno==ECONNABORTED) continue;
+                //out of descriptors or memory, wait for clients to disconnect instead of spinning
+                if(errno==EMFILE || errno==ENFILE || errno==ENOBUFS || errno==ENOMEM){
+                    this_thread::sleep_for(chrono::milliseconds(100));
+                    continue;
+                }
+                cerr<<"Error. accept failed on socket "<<path<<": "<<strerror(errno)<<endl;
+                close(fd);
+                stop_batcher(batcher, reporter);
+                throw runtime_error("accept failed\n");
+            }
+            shared_ptr<Connection> conn = make_shared<Connection>(client, client, true);
+            thread([this, conn]{read_loop(conn);}).detach();
+        }
+    }
+
+};
+
+//blocking client for a single connection, used by the load generator
+class InferenceClient{
+
+private:
+    int fd;
+    uint32_t next_id;
+
+    vector<double> request(uint32_t type, const double* payload, uint32_t count){
+        FrameHeader h = {type, next_id++, count};
+        if(!write_full(fd, &h, sizeof(h)) || !write_full(fd, payload, sizeof(double)*count) || !read_full(fd, &h, sizeof(h))){
+            throw runtime_error("connection to inference server lost\n");
+        }
+        vector<double> out(h.count);
+        if(!read_full(fd, out.data(), sizeof(double)*h.count)) throw runtime_error("connection to inference server lost\n");
+        if(h.type==FRAME_ERROR) throw invalid_argument("inference server rejected request\n");
+        return out;
+    }
+
+public:
+
+    InferenceClient(string path){
+        next_id=0;
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path)-1);
+        if(fd<0 || connect(fd, (sockaddr*)&addr, sizeof(addr))<0){
+            if(fd>=0) close(fd);
+            cerr<<"Error. Unable to connect to inference server at "<<path<<endl;
+            throw runtime_error("unable to connect\n");
+        }
+    }
+
+    vector<double> score(const vector<double>& input){return request(SCORE, input.data(), (uint32_t)input.size());}
+    vector<double> stats(){return request(STATS, NULL, 0);}
+    vector<double> info(){return request(INFO, NULL, 0);}
+
+    ~InferenceClient(){close(fd);}
+};
+
+#endif /* InferenceServer_h */
@@ -0,0 +1,410 @@
+/*
+ * Filename: LBFGS.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a full batch L-BFGS trainer for MLP networks, which computes the loss and gradient of
+ * the whole training set with batched matrix products and can replace per-row SGD in cross_validate.
+ */
+
+#ifndef LBFGS_h
+#define LBFGS_h
+
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+#include "Network.h"
+
+using namespace std;
+
+struct LBFGSOptions{
+    int max_iterations;         //iterations (line searches) per training run
+    int history;                //(s, y) pairs kept for the inverse Hessian estimate
+    double gradient_tolerance;  //converged when the largest gradient component falls below this
+    double loss_tolerance;      //or when an iteration improves the loss by less than this relative amount
+    double l2;                  //weight decay, keeps the weights bounded on separable data
+    int batch_rows;             //rows per batched product, bounds the memory of an evaluation
+    int max_line_search;        //loss evaluations per line search
+    double target_loss;         //the time until a run's loss first falls to this is recorded, 0 records none
+
+    LBFGSOptions(){
+        max_iterations=200;
+        history=10;
+        //met within 200 iterations by every fold of the bundled datasets, tighter ones mostly run into the iteration cap
+        gradient_tolerance=1e-4;
+        loss_tolerance=3e-4;
+        l2=1e-4;
+        batch_rows=4096;
+        max_line_search=20;
+        target_loss=0;
+    }
+};
+
+//totals over every run of a trainer, e.g. the folds of a cross validation
+struct LBFGSStats{
+    long runs;
+    long iterations;
+    long evaluations;   //loss and gradient computations over the whole training set
+    long converged;     //runs that met a tolerance before max_iterations
+    long reached_target;    //runs whose loss fell to target_loss
+    double seconds;
+    double seconds_to_target;   //summed over the runs that reached it
+    double last_loss;
+
+    LBFGSStats(){
+        runs=0;
+        iterations=0;
+        evaluations=0;
+        converged=0;
+        reached_target=0;
+        seconds=0;
+        seconds_to_target=0;
+        last_loss=0;
+    }
+
+    void print(ostream& os) const {
+        os<<"runs "<<runs<<" converged "<<converged<<" iterations "<<iterations<<" ("<<(double)iterations/max(1L, runs)
+          <<" per run) evaluations "<<evaluations<<" time "<<seconds<<"s ("<<seconds/max(1L, runs)<<"s per run) last loss "
+          <<last_loss;
+        if(reached_target>0) os<<" target reached by "<<reached_target<<" runs in "<<seconds_to_target/reached_target<<"s per run";
+        os<<endl;
+    }
+};
+
+class LBFGSTrainer{
+
+private:
+    LBFGSOptions options;
+    LBFGSStats stats;
+
+    //scratch of one evaluation, sized for a topology and batch_rows rows
+    vector<int> sizes;
+    vector<vector<double>> acts;        //acts[i] is layer i of the batch, rows x sizes[i]
+    vector<vector<double>> acts_t;      //its transpose, sizes[i] x rows
+    vector<vector<double>> weights_t;   //weights_t[i] is W[i]^T, sizes[i] x sizes[i+1]
+    vector<double> delta, delta_prev, delta_t;
+
+    static void transpose(const double* a, int rows, int cols, double* t){
+        const int tile=32;
+        for(int i0=0;i0<rows;i0+=tile){
+            for(int j0=0;j0<cols;j0+=tile){
+                for(int i=i0;i<min(rows, i0+tile);i++){
+                    for(int j=j0;j<min(cols, j0+tile);j++) t[(long)j*rows+i]=a[(long)i*cols+j];
+                }
+            }
+        }
+    }
+
+    static double dot(const vector<double>& a, const vector<double>& b){
+        double sum=0;
+        for(size_t i=0;i<a.size();i++) sum+=a[i]*b[i];
+        return sum;
+    }
+
+    void reserve(const MLPNetwork& net, int rows){
+        sizes = net.get_sizes();
+        int num_layers = (int)sizes.size();
+        int widest = *max_element(sizes.begin(), sizes.end());
+        acts.resize(num_layers);
+        acts_t.resize(num_layers);
+        weights_t.resize(num_layers-1);
+        for(int i=0;i<num_layers;i++){
+            acts[i].resize((long)rows*sizes[i]);
+            acts_t[i].resize((long)rows*sizes[i]);
+            if(i<num_layers-1) weights_t[i].resize((long)sizes[i]*sizes[i+1]);
+        }
+        delta.resize((long)rows*widest);
+        delta_prev.resize((long)rows*widest);
+        delta_t.resize((long)rows*widest);
+    }
+
+public:
+
+    LBFGSTrainer(const LBFGSOptions& options=LBFGSOptions()){
+        this->options=options;
+    }
+
+    const LBFGSOptions& get_options() const {return options;}
+    const LBFGSStats& get_stats() const {return stats;}
+
+    /*
+     * Mean loss of net with parameters params (the layout of MLPNetwork::get_parameters) over the given rows of data,
+     * plus the l2 penalty, and its gradient. The loss is the cross entropy of the softmax outputs for classification and
+     * half the squared error for regression. Every product is in the A B^T form the backends are fastest at, with the
+     * transposes they need made once per batch. Leaves params set on net.
+     */
+    double loss_and_gradient(MLPNetwork& net, Dataset& data, const vector<long>& rows, const double* params, double* grad){
+        net.set_parameters(params);
+        if(sizes!=net.get_sizes() || acts[0].size()<(size_t)options.batch_rows*sizes[0]) reserve(net, options.batch_rows);
+
+        int num_layers = (int)sizes.size();
+        int out_size = sizes.back();
+        bool classification = out_size>1;
+        long num_rows = (long)rows.size();
+        long num_params = net.get_num_parameters();
+        memset(grad, 0, sizeof(double)*num_params);
+
+        //offsets of every connection's weight and bias gradients in grad
+        vector<long> offsets(num_layers);
+        offsets[0]=0;
+        for(int i=0;i<num_layers-1;i++) offsets[i+1] = offsets[i]+(long)sizes[i+1]*(sizes[i]+1);
+        for(int i=0;i<num_layers-1;i++) transpose(net.get_weights(i), sizes[i+1], sizes[i], weights_t[i].data());
+
+        Entry scratch(sizes.front(), out_size);
+        double loss=0;
+        for(long start=0;start<num_rows;start+=options.batch_rows){
+            int n = (int)min((long)options.batch_rows, num_rows-start);
+
+            //the batch's inputs, sparse rows are scattered into zeroed rows
+            double* x = acts[0].data();
+            vector<double> expected((long)n*out_size);
+            for(int r=0;r<n;r++){
+                Entry& e = data.getEntry(rows[start+r], scratch);
+                double* row = x+(long)r*sizes[0];
+                if(e.isSparse()){
+                    memset(row, 0, sizeof(double)*sizes[0]);
+                    for(int k=0;k<e.nnz;k++) row[e.sparse_indices[k]] = e.sparse_values[k];
+                }
+                else memcpy(row, e.data, sizeof(double)*sizes[0]);
+                memcpy(&expected[(long)r*out_size], e.expected, sizeof(double)*out_size);
+            }
+
+            //forward: L[i+1] = act(L[i] W[i]^T + B[i+1])
+            for(int i=0;i<num_layers-1;i++){
+                double* out = acts[i+1].data();
+                for(int r=0;r<n;r++) memcpy(out+(long)r*sizes[i+1], net.get_biases(i), sizeof(double)*sizes[i+1]);
+                Backend::gemm(Backend::NoTrans, Backend::Trans, n, sizes[i+1], sizes[i], 1, acts[i].data(), sizes[i], net.get_weights(i), sizes[i], 1, out, sizes[i+1]);
+                if(i<num_layers-2) MLPNetwork::apply_activation(net.get_activation(), out, n*sizes[i+1]);
+            }
+
+            //output delta, the derivative of the mean loss by the output layer's inputs
+            double* out = acts.back().data();
+            for(int r=0;r<n;r++){
+                double* o = out+(long)r*out_size;
+                const double* y = &expected[(long)r*out_size];
+                double* d = delta.data()+(long)r*out_size;
+                if(classification){
+                    double peak = *max_element(o, o+out_size), total=0;
+                    for(int j=0;j<out_size;j++) total+=exp(o[j]-peak);
+                    double log_total = log(total)+peak;
+                    for(int j=0;j<out_size;j++){
+                        if(y[j]!=0) loss -= y[j]*(o[j]-log_total);
+                        d[j] = (exp(o[j]-log_total)-y[j])/num_rows;
+                    }
+                }
+                else{
+                    loss += 0.5*(o[0]-y[0])*(o[0]-y[0]);
+                    d[0] = (o[0]-y[0])/num_rows;
+                }
+            }
+
+            //backward: dW[i] += D[i+1]^T L[i], dB[i+1] += column sums of D[i+1], D[i] = (D[i+1] W[i]) * act'(L[i])
+            for(int i=num_layers-2;i>=0;i--){
+                int rows_out = sizes[i+1], cols = sizes[i];
+                transpose(delta.data(), n, rows_out, delta_t.data());
+                transpose(acts[i].data(), n, cols, acts_t[i].data());
+                double* gw = grad+offsets[i];
+                double* gb = gw+(long)rows_out*cols;
+                Backend::gemm(Backend::NoTrans, Backend::Trans, rows_out, cols, n, 1, delta_t.data(), n, acts_t[i].data(), n, 1, gw, cols);
+                for(int j=0;j<rows_out;j++){
+                    const double* d = delta_t.data()+(long)j*n;
+                    double sum=0;
+                    for(int r=0;r<n;r++) sum+=d[r];
+                    gb[j]+=sum;
+                }
+                if(i>0){
+                    Backend::gemm(Backend::NoTrans, Backend::Trans, n, cols, rows_out, 1, delta.data(), rows_out, weights_t[i].data(), rows_out, 0, delta_prev.data(), cols);
+                    net.times_activation_func_deriv(acts[i].data(), delta_prev.data(), n*cols);
+                    swap(delta, delta_prev);
+                }
+            }
+        }
+
+        loss/=max(1L, num_rows);
+        for(int i=0;i<num_layers-1;i++){
+            long n = (long)sizes[i+1]*sizes[i];
+            const double* w = params+offsets[i];
+            double* gw = grad+offsets[i];
+            double sum=0;
+            for(long k=0;k<n;k++){
+                sum+=w[k]*w[k];
+                gw[k]+=options.l2*w[k];
+            }
+            loss+=0.5*options.l2*sum;
+        }
+        stats.evaluations++;
+        return loss;
+    }
+
+    /*
+     * Minimizes the loss of net over the given rows of data from its current parameters. Search directions come from
+     * the two loop recursion over the last history (s, y) pairs, step lengths from a line search for the strong Wolfe
+     * conditions. Returns the number of iterations.
+     */
+    int train(MLPNetwork& net, Dataset& data, const vector<long>& rows){
+        auto start = chrono::steady_clock::now();
+        const double c1=1e-4, c2=0.9;
+        long n = net.get_num_parameters();
+        vector<double> x(n), g(n), d(n), x_new(n), g_new(n);
+        deque<vector<double>> s_hist, y_hist;
+        deque<double> rho_hist;
+        net.get_parameters(x.data());
+        double f = loss_and_gradient(net, data, rows, x.data(), g.data());
+
+        bool reached = false;
+        auto check_target = [&](){
+            if(reached || options.target_loss<=0 || f>options.target_loss) return;
+            reached = true;
+            stats.reached_target++;
+            stats.seconds_to_target+=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+        };
+        check_target();
+
+        bool converged=false;
+        int iter=0;
+        for(;iter<options.max_iterations;iter++){
+            double gmax=0;
+            for(double v : g) gmax=max(gmax, fabs(v));
+            if(gmax<options.gradient_tolerance){
+                converged=true;
+                break;
+            }
+
+            //d = -H g by the two loop recursion, H starts as s^T y / y^T y times the identity
+            for(long k=0;k<n;k++) d[k]=-g[k];
+            int m = (int)s_hist.size();
+            vector<double> alpha(m);
+            for(int j=m-1;j>=0;j--){
+                alpha[j] = rho_hist[j]*dot(s_hist[j], d);
+                for(long k=0;k<n;k++) d[k]-=alpha[j]*y_hist[j][k];
+            }
+            if(m>0){
+                double gamma = dot(s_hist.back(), y_hist.back())/dot(y_hist.back(), y_hist.back());
+                for(long k=0;k<n;k++) d[k]*=gamma;
+            }
+            for(int j=0;j<m;j++){
+                double beta = rho_hist[j]*dot(y_hist[j], d);
+                for(long k=0;k<n;k++) d[k]+=(alpha[j]-beta)*s_hist[j][k];
+            }
+            double slope = dot(g, d);
+            if(slope>=0){
+                //not a descent direction, start over from steepest descent
+                s_hist.clear();
+                y_hist.clear();
+                rho_hist.clear();
+                for(long k=0;k<n;k++) d[k]=-g[k];
+                slope = dot(g, d);
+            }
+
+            //line search: grow the step until the loss rises or the slope turns, then zoom into that bracket
+            double step = m>0 ? 1 : min(1.0, 1/sqrt(-slope));
+            double f_new=f, slope_new=slope;
+            auto eval = [&](double a){
+                for(long k=0;k<n;k++) x_new[k]=x[k]+a*d[k];
+                f_new = loss_and_gradient(net, data, rows, x_new.data(), g_new.data());
+                slope_new = dot(g_new, d);
+            };
+            double lo=0, f_lo=f, slope_lo=slope, hi=0, f_hi=f, slope_hi=slope;
+            bool bracketed=false, found=false;
+            for(int e=0;e<options.max_line_search && !found;e++){
+                if(bracketed){
+                    //minimum of the cubic through both ends, kept away from them, bisection if it has none
+                    double d1 = slope_lo+slope_hi-3*(f_lo-f_hi)/(lo-hi);
+                    double disc = d1*d1-slope_lo*slope_hi;
+                    double t = (lo+hi)/2;
+                    if(disc>=0){
+                        double d2 = (hi>lo ? 1 : -1)*sqrt(disc);
+                        t = hi-(hi-lo)*(slope_hi+d2-d1)/(slope_hi-slope_lo+2*d2);
+                    }
+                    double width = fabs(hi-lo);
+                    step = max(min(lo, hi)+0.1*width, min(max(lo, hi)-0.1*width, t));
+                }
+                eval(step);
+                if(f_new>f+c1*step*slope || (f_new>=f_lo && (bracketed || e>0))){
+                    bracketed=true;
+                    hi=step;
+                    f_hi=f_new;
+                    slope_hi=slope_new;
+                }
+                else if(fabs(slope_new)<=-c2*slope) found=true;
+                else{
+                    if(slope_new*(bracketed ? hi-lo : 1)>=0){
+                        hi=lo;
+                        f_hi=f_lo;
+                        slope_hi=slope_lo;
+                        bracketed=true;
+                    }
+                    lo=step;
+                    f_lo=f_new;
+                    slope_lo=slope_new;
+                    if(!bracketed) step*=2;
+                }
+            }
+            if(!found){
+                //no strong Wolfe point within max_line_search, take the best sufficient decrease seen if there was one
+                if(lo==0){
+                    converged = gmax<10*options.gradient_tolerance;
+                    break;
+                }
+                eval(lo);
+            }
+
+            vector<double> s(n), y(n);
+            for(long k=0;k<n;k++){
+                s[k]=x_new[k]-x[k];
+                y[k]=g_new[k]-g[k];
+            }
+            double sy = dot(s, y);
+            if(sy>1e-12*sqrt(dot(s, s)*dot(y, y))){
+                if((int)s_hist.size()==options.history){
+                    s_hist.pop_front();
+                    y_hist.pop_front();
+                    rho_hist.pop_front();
+                }
+                s_hist.push_back(s);
+                y_hist.push_back(y);
+                rho_hist.push_back(1/sy);
+            }
+
+            double improvement = f-f_new;
+            swap(x, x_new);
+            swap(g, g_new);
+            f=f_new;
+            check_target();
+            if(improvement<=options.loss_tolerance*max(1.0, fabs(f))){
+                iter++;
+                converged=true;
+                break;
+            }
+        }
+
+        net.set_parameters(x.data());
+        stats.runs++;
+        stats.iterations+=iter;
+        if(converged) stats.converged++;
+        stats.seconds+=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+        stats.last_loss=f;
+        return iter;
+    }
+
+    //a CVOptions::trainer that trains every fold with this trainer (the network has to be an MLPNetwork)
+    function<void(Network&, Dataset&, const vector<long>&)> cv_trainer(){
+        return [this](Network& net, Dataset& data, const vector<long>& rows){
+            MLPNetwork* mlp = dynamic_cast<MLPNetwork*>(&net);
+            if(mlp==NULL){
+                cerr<<"Error. L-BFGS can only train MLP networks\n";
+                throw invalid_argument("network is not an MLPNetwork\n");
+            }
+            train(*mlp, data, rows);
+        };
+    }
+};
+
+#endif /* LBFGS_h */
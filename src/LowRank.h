@@ -0,0 +1,399 @@
+/*
+ * Filename: LowRank.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a truncated SVD compression pass for a trained MLPNetwork and an inference model
+ * that replaces the compressed weight matrices by two thinner factors.
+ */
+
+#ifndef LowRank_h
+#define LowRank_h
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Network.h"
+
+using namespace std;
+
+/*
+ * Thin singular value decomposition W = U diag(S) Vt of a row major rows x cols matrix, k = min(rows, cols):
+ * U is rows x k, Vt is k x cols, both row major, and S is sorted in decreasing order.
+ */
+struct LayerSVD{
+    int rows;
+    int cols;
+    int k;
+    vector<double> U;
+    vector<double> S;
+    vector<double> Vt;
+
+    //one sided Jacobi: rotates pairs of rows of G until they are orthogonal while applying the same rotations to the
+    //rows of R (which starts as the identity), then the row norms of G are the singular values
+    static void orthogonalize(vector<double>& G, vector<double>& R, int num, int len){
+        R.assign((long)num*num, 0);
+        for(int p=0;p<num;p++) R[(long)p*num+p]=1;
+        const double eps = 1e-15;
+        for(int sweep=0;sweep<60;sweep++){
+            bool rotated=false;
+            for(int p=0;p<num-1;p++){
+                double* gp = G.data()+(long)p*len;
+                for(int q=p+1;q<num;q++){
+                    double* gq = G.data()+(long)q*len;
+                    double alpha=0, beta=0, gamma=0;
+                    for(int i=0;i<len;i++){
+                        alpha+=gp[i]*gp[i];
+                        beta+=gq[i]*gq[i];
+                        gamma+=gp[i]*gq[i];
+                    }
+                    if(gamma==0 || fabs(gamma)<=eps*sqrt(alpha*beta)) continue;
+                    rotated=true;
+                    double zeta = (beta-alpha)/(2*gamma);
+                    double t = (zeta>=0 ? 1 : -1)/(fabs(zeta)+sqrt(1+zeta*zeta));
+                    double c = 1/sqrt(1+t*t), s = c*t;
+                    for(int i=0;i<len;i++){
+                        double a=gp[i], b=gq[i];
+                        gp[i]=c*a-s*b;
+                        gq[i]=s*a+c*b;
+                    }
+                    double* rp = R.data()+(long)p*num;
+                    double* rq = R.data()+(long)q*num;
+                    for(int i=0;i<num;i++){
+                        double a=rp[i], b=rq[i];
+                        rp[i]=c*a-s*b;
+                        rq[i]=s*a+c*b;
+                    }
+                }
+            }
+            if(!rotated) break;
+        }
+    }
+
+    LayerSVD(const double* w, int rows, int cols){
+        this->rows=rows;
+        this->cols=cols;
+        k = min(rows, cols);
+
+        //the rows of G are the columns of W when it is tall and its rows when it is wide, so there are always k of them
+        bool tall = rows>=cols;
+        int len = tall ? rows : cols;
+        vector<double> G((long)k*len), R;
+        for(int j=0;j<rows;j++){
+            for(int i=0;i<cols;i++){
+                if(tall) G[(long)i*rows+j] = w[(long)j*cols+i];
+                else G[(long)j*cols+i] = w[(long)j*cols+i];
+            }
+        }
+        orthogonalize(G, R, k, len);
+
+        vector<double> norms(k);
+        vector<int> order(k);
+        for(int p=0;p<k;p++){
+            double sum=0;
+            for(int i=0;i<len;i++) sum+=G[(long)p*len+i]*G[(long)p*len+i];
+            norms[p]=sqrt(sum);
+            order[p]=p;
+        }
+        sort(order.begin(), order.end(), [&norms](int a, int b){return norms[a]>norms[b] || (norms[a]==norms[b] && a<b);});
+
+        //tall: W R^T = G^T, so U = normalized G^T and Vt = R. wide: W^T R^T = G^T, so U = R^T and Vt = normalized G
+        U.assign((long)rows*k, 0);
+        S.assign(k, 0);
+        Vt.assign((long)k*cols, 0);
+        for(int j=0;j<k;j++){
+            int p = order[j];
+            S[j] = norms[p];
+            double inv = norms[p]>0 ? 1/norms[p] : 0;
+            const double* g = G.data()+(long)p*len;
+            const double* r = R.data()+(long)p*k;
+            if(tall){
+                for(int i=0;i<rows;i++) U[(long)i*k+j] = g[i]*inv;
+                memcpy(&Vt[(long)j*cols], r, sizeof(double)*cols);
+            }
+            else{
+                for(int i=0;i<rows;i++) U[(long)i*k+j] = r[i];
+                for(int i=0;i<cols;i++) Vt[(long)j*cols+i] = g[i]*inv;
+            }
+        }
+    }
+
+    //largest rank for which the two factors are cheaper than the dense matrix
+    int max_useful_rank() const {
+        return (int)min((long)k, ((long)rows*cols-1)/(rows+cols));
+    }
+};
+
+/*
+ * Inference model of a network whose connections are either dense or replaced by the rank r factors
+ * (U diag(S)) Vt of their truncated SVD, which costs r (rows+cols) multiplies instead of rows cols.
+ * A rank of 0, or one too large to save anything, keeps the connection dense.
+ */
+class LowRankMLP{
+
+private:
+    int num_layers;
+    vector<int> sizes;
+    vector<int> ranks; //0 for dense connections
+    Network::ACTIVATION activation;
+    vector<double*> weights; //the dense matrix, or U diag(S) (rows x rank) for factored connections
+    vector<double*> factors; //Vt (rank x cols) for factored connections, NULL for dense ones
+    vector<double*> biases;
+
+    LowRankMLP(const LowRankMLP&);
+    LowRankMLP& operator=(const LowRankMLP&);
+
+    static double* copy(const double* src, long n){
+        double* dst = (double*)Backend::aligned_malloc(sizeof(double)*max(1L, n), DATA_ALIGNMENT);
+        memcpy(dst, src, sizeof(double)*n);
+        return dst;
+    }
+
+public:
+
+    //scratch space for one scoring thread, for up to capacity rows
+    class Workspace{
+
+    private:
+        int capacity;
+        Workspace(const Workspace&);
+        Workspace& operator=(const Workspace&);
+
+    public:
+        double* buffers[2]; //ping-pong buffers for the input and output of the current layer
+        double* thin;       //Vt x of the factored connection being scored
+
+        Workspace(const LowRankMLP& net, int rows=1){
+            int widest = *max_element(net.sizes.begin(), net.sizes.end());
+            int max_rank = max(1, *max_element(net.ranks.begin(), net.ranks.end()));
+            capacity=rows;
+            buffers[0] = (double*)Backend::aligned_malloc(sizeof(double)*rows*widest, DATA_ALIGNMENT);
+            buffers[1] = (double*)Backend::aligned_malloc(sizeof(double)*rows*widest, DATA_ALIGNMENT);
+            thin = (double*)Backend::aligned_malloc(sizeof(double)*rows*max_rank, DATA_ALIGNMENT);
+        }
+
+        int get_capacity() const {return capacity;}
+
+        ~Workspace(){
+            Backend::aligned_free(buffers[0]);
+            Backend::aligned_free(buffers[1]);
+            Backend::aligned_free(thin);
+        }
+    };
+
+    //factors connection i of net at ranks[i] using svds[i], which LowRankCompressor::decompose computed
+    LowRankMLP(const MLPNetwork& net, const vector<LayerSVD>& svds, const vector<int>& ranks){
+        num_layers = net.get_num_layers();
+        sizes = net.get_sizes();
+        activation = net.get_activation();
+        if((int)svds.size()!=num_layers-1 || (int)ranks.size()!=num_layers-1){
+            cerr<<"Error. Low rank networks need one decomposition and one rank per connection\n";
+            throw invalid_argument("wrong number of ranks\n");
+        }
+        for(int i=0;i<num_layers-1;i++){
+            const LayerSVD& svd = svds[i];
+            int rows = sizes.at(i+1), cols = sizes.at(i);
+            int rank = ranks[i];
+            if(rank<=0 || rank>svd.max_useful_rank()) rank=0;
+            this->ranks.push_back(rank);
+            biases.push_back(copy(net.get_biases(i), rows));
+            if(rank==0){
+                weights.push_back(copy(net.get_weights(i), (long)rows*cols));
+                factors.push_back(NULL);
+                continue;
+            }
+            double* us = (double*)Backend::aligned_malloc(sizeof(double)*rows*rank, DATA_ALIGNMENT);
+            for(int j=0;j<rows;j++){
+                for(int r=0;r<rank;r++) us[(long)j*rank+r] = svd.U[(long)j*svd.k+r]*svd.S[r];
+            }
+            weights.push_back(us);
+            factors.push_back(copy(svd.Vt.data(), (long)rank*cols));
+        }
+    }
+
+    int get_input_size() const {return sizes.front();}
+    int get_output_size() const {return sizes.back();}
+    int get_num_layers() const {return num_layers;}
+    const vector<int>& get_sizes() const {return sizes;}
+
+    //rank of connection i, 0 if it is dense
+    int get_rank(int i) const {return ranks.at(i);}
+
+    //multiply-adds of connection i per row
+    long get_flops(int i) const {
+        int rows = sizes.at(i+1), cols = sizes.at(i);
+        return ranks.at(i) ? (long)ranks[i]*(rows+cols) : (long)rows*cols;
+    }
+
+    //bytes of the weights (or factors) and biases of connection i
+    long get_bytes(int i) const {
+        return sizeof(double)*(get_flops(i)+sizes.at(i+1));
+    }
+
+    long get_parameter_bytes() const {
+        long bytes=0;
+        for(int i=0;i<num_layers-1;i++) bytes+=get_bytes(i);
+        return bytes;
+    }
+
+    //per connection: shape, rank, and the multiply-adds and bytes against the dense connection
+    void print_report(ostream& out) const {
+        ios::fmtflags flags = out.flags();
+        streamsize precision = out.precision();
+        out<<fixed<<setprecision(2);
+        long dense_flops=0, flops=0, dense_bytes=0, bytes=0;
+        for(int i=0;i<num_layers-1;i++){
+            int rows = sizes.at(i+1), cols = sizes.at(i);
+            long df = (long)rows*cols, db = sizeof(double)*(df+rows);
+            out<<"  connection "<<i<<" "<<rows<<"x"<<cols<<" ";
+            if(ranks[i]) out<<"rank "<<ranks[i];
+            else out<<"dense";
+            out<<" flops "<<get_flops(i)<<"/"<<df<<" ("<<(double)df/get_flops(i)<<"x) bytes "
+               <<get_bytes(i)<<"/"<<db<<" ("<<(double)db/get_bytes(i)<<"x)"<<endl;
+            dense_flops+=df;
+            flops+=get_flops(i);
+            dense_bytes+=db;
+            bytes+=get_bytes(i);
+        }
+        out<<"  total flops "<<flops<<"/"<<dense_flops<<" ("<<(double)dense_flops/flops<<"x) bytes "
+           <<bytes<<"/"<<dense_bytes<<" ("<<(double)dense_bytes/bytes<<"x)"<<endl;
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+    //same contract as MLPNetwork::forward_batch: num_rows contiguous inputs in, num_rows contiguous output layers out
+    void forward_batch(const double* inputs, int num_rows, double* outputs, Workspace& ws) const {
+
+        if(num_rows>ws.get_capacity()){
+            cerr<<"Error. Workspace holds "<<ws.get_capacity()<<" rows but forward_batch was given "<<num_rows<<endl;
+            throw invalid_argument("workspace too small for batch\n");
+        }
+
+        bool classification = sizes.back()>1;
+        const double* in = inputs;
+        for(int i=0;i<num_layers-1;i++){
+            int rows = sizes.at(i+1), cols = sizes.at(i), rank = ranks[i];
+            double* out = (i==num_layers-2) ? outputs : ws.buffers[i%2];
+            for(int r=0;r<num_rows;r++) memcpy(out+(long)r*rows, biases[i], sizeof(double)*rows);
+
+            //dense: L W^T + B. factored: (L Vt^T) (U diag(S))^T + B, through the rank wide scratch rows
+            if(num_rows==1){
+                if(rank==0) Backend::gemv(Backend::NoTrans, rows, cols, 1, weights[i], cols, in, 1, out);
+                else{
+                    Backend::gemv(Backend::NoTrans, rank, cols, 1, factors[i], cols, in, 0, ws.thin);
+                    Backend::gemv(Backend::NoTrans, rows, rank, 1, weights[i], rank, ws.thin, 1, out);
+                }
+            }
+            else{
+                if(rank==0) Backend::gemm(Backend::NoTrans, Backend::Trans, num_rows, rows, cols, 1, in, cols, weights[i], cols, 1, out, rows);
+                else{
+                    Backend::gemm(Backend::NoTrans, Backend::Trans, num_rows, rank, cols, 1, in, cols, factors[i], cols, 0, ws.thin, rank);
+                    Backend::gemm(Backend::NoTrans, Backend::Trans, num_rows, rows, rank, 1, ws.thin, rank, weights[i], rank, 1, out, rows);
+                }
+            }
+
+            if(i<num_layers-2) MLPNetwork::apply_activation(activation, out, num_rows*rows);
+            else if(classification){
+                for(int r=0;r<num_rows;r++) MLPNetwork::softmax(out+(long)r*rows, rows);
+            }
+            in = out;
+        }
+    }
+
+    //index of the most probable class of one input vector
+    int classify_index(const double* input, Workspace& ws) const {
+        vector<double> out(sizes.back());
+        forward_batch(input, 1, out.data(), ws);
+        return (int)(max_element(out.begin(), out.end())-out.begin());
+    }
+
+    ~LowRankMLP(){
+        for(double* w : weights) Backend::aligned_free(w);
+        for(double* f : factors) if(f) Backend::aligned_free(f);
+        for(double* b : biases) Backend::aligned_free(b);
+    }
+};
+
+class LowRankCompressor{
+
+public:
+
+    //the SVD of every connection of net, computed once and shared by every rank that is tried
+    static vector<LayerSVD> decompose(const MLPNetwork& net){
+        vector<LayerSVD> svds;
+        for(int i=0;i<net.get_num_layers()-1;i++) svds.push_back(LayerSVD(net.get_weights(i), net.get_sizes().at(i+1), net.get_sizes().at(i)));
+        return svds;
+    }
+
+    //classification error rate, or root mean squared error for regression, of a model on rows [start, end) of data
+    template<class Model>
+    static double error(const Model& model, Dataset& data, long start, long end){
+        int in_size = model.get_input_size(), out_size = model.get_output_size();
+        const int batch = 256;
+        typename Model::Workspace ws(model, batch);
+        Entry scratch(in_size, out_size);
+        vector<double> inputs((long)batch*in_size), outputs((long)batch*out_size);
+        double total=0;
+        for(long b=start;b<end;b+=batch){
+            int n = (int)min((long)batch, end-b);
+            for(int r=0;r<n;r++) memcpy(&inputs[(long)r*in_size], data.getEntry(b+r, scratch).data, sizeof(double)*in_size);
+            model.forward_batch(inputs.data(), n, outputs.data(), ws);
+            for(int r=0;r<n;r++){
+                const Entry& e = data.getEntry(b+r, scratch);
+                const double* o = &outputs[(long)r*out_size];
+                if(out_size>1) total += e.expected[max_element(o, o+out_size)-o]!=1;
+                else total += (o[0]-e.expected[0])*(o[0]-e.expected[0]);
+            }
+        }
+        double mean = total/max(1L, end-start);
+        return out_size>1 ? mean : sqrt(mean);
+    }
+
+    /*
+     * Picks a rank per connection so the error on rows [start, end) of data (a validation split) grows by at most
+     * error_budget over the dense network: the widest connections go first, each gets the smallest rank that keeps
+     * the error of the network so far within budget (found by bisection, the error falls roughly monotonically with
+     * the rank), and stays dense if even the largest rank that saves work doesn't. Only the connections listed in
+     * layers are considered, every one if it is empty.
+     */
+    static vector<int> choose_ranks(const MLPNetwork& net, const vector<LayerSVD>& svds, Dataset& data, long start, long end,
+                                    double error_budget, vector<int> layers=vector<int>()){
+        int num_connections = net.get_num_layers()-1;
+        if(layers.empty()){
+            for(int i=0;i<num_connections;i++) layers.push_back(i);
+        }
+        sort(layers.begin(), layers.end(), [&svds](int a, int b){
+            long sa = (long)svds.at(a).rows*svds.at(a).cols, sb = (long)svds.at(b).rows*svds.at(b).cols;
+            return sa>sb || (sa==sb && a<b);
+        });
+
+        double limit = error(net, data, start, end)+error_budget;
+        vector<int> ranks(num_connections, 0);
+        for(int i : layers){
+            int hi = svds.at(i).max_useful_rank();
+            if(hi<1) continue;
+            ranks[i]=hi;
+            if(error(LowRankMLP(net, svds, ranks), data, start, end)>limit){
+                ranks[i]=0;
+                continue;
+            }
+            int lo=1;
+            while(lo<hi){
+                int mid = (lo+hi)/2;
+                ranks[i]=mid;
+                if(error(LowRankMLP(net, svds, ranks), data, start, end)<=limit) hi=mid;
+                else lo=mid+1;
+            }
+            ranks[i]=hi;
+        }
+        return ranks;
+    }
+};
+
+#endif /* LowRank_h */
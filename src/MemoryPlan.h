@@ -0,0 +1,178 @@
+/*
+ * Filename: MemoryPlan.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains an ahead of time planner that packs the intermediate buffers of a network's training
+ * or inference steps into one preallocated arena, reusing memory between buffers whose lifetimes don't overlap.
+ */
+
+#ifndef MemoryPlan_h
+#define MemoryPlan_h
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "Backend.h"
+
+#include "Entry.h"
+
+using namespace std;
+
+//one intermediate buffer, live from the step that first writes it to the step that last reads it (inclusive)
+struct BufferRequest{
+    long size; //in doubles
+    int first_step;
+    int last_step;
+};
+
+/*
+ * Buffers are placed largest first at the lowest offset that doesn't collide with an already placed buffer whose lifetime
+ * overlaps, the usual greedy by size heuristic. Offsets are rounded to DATA_ALIGNMENT so every buffer starts on its own
+ * cache line. Each thread gets its own slice of the arena, so num_threads threads can run the same steps side by side.
+ */
+class MemoryPlan{
+
+private:
+    vector<BufferRequest> requests;
+    vector<long> offsets;    //in doubles, from the start of a thread's slice
+    long slice_size;         //in doubles, a multiple of the alignment
+    int num_threads;
+
+    static long align(long doubles){
+        long per_line = DATA_ALIGNMENT/sizeof(double);
+        return (doubles+per_line-1)/per_line*per_line;
+    }
+
+public:
+
+    MemoryPlan(){
+        slice_size=0;
+        num_threads=1;
+    }
+
+    MemoryPlan(const vector<BufferRequest>& requests, int num_threads=1){
+        if(num_threads<1){
+            cerr<<"Error. A memory plan needs at least one thread\n";
+            throw invalid_argument("invalid thread count\n");
+        }
+        this->requests=requests;
+        this->num_threads=num_threads;
+        offsets = vector<long>(requests.size(), 0);
+        slice_size=0;
+
+        vector<int> order(requests.size());
+        for(int i=0;i<(int)order.size();i++) order[i]=i;
+        stable_sort(order.begin(), order.end(), [&requests](int a, int b){return requests[a].size>requests[b].size;});
+
+        vector<int> placed;
+        for(int b : order){
+            //placed buffers that are alive at the same time as b, by offset
+            vector<int> live;
+            for(int p : placed){
+                if(requests[p].first_step<=requests[b].last_step && requests[b].first_step<=requests[p].last_step) live.push_back(p);
+            }
+            sort(live.begin(), live.end(), [this](int x, int y){return offsets[x]<offsets[y];});
+
+            long offset=0;
+            for(int p : live){
+                if(offset+align(requests[b].size)<=offsets[p]) break;
+                offset = max(offset, offsets[p]+align(requests[p].size));
+            }
+            offsets[b]=offset;
+            slice_size = max(slice_size, offset+align(requests[b].size));
+            placed.push_back(b);
+        }
+    }
+
+    /*
+     * Layer buffers for a forward pass over batch_size rows: buffer i-1 holds layer i (the input belongs to the caller)
+     * step i reads layer i and writes layer i+1, and the output layer stays live one step after it is written for the caller
+     */
+    static MemoryPlan inference(const vector<int>& sizes, int batch_size, int num_threads=1){
+        vector<BufferRequest> requests;
+        for(int i=1;i<(int)sizes.size();i++) requests.push_back({(long)batch_size*sizes[i], i-1, i});
+        return MemoryPlan(requests, num_threads);
+    }
+
+    /*
+     * Layer and error buffers for one backpropagation step of MLPNetwork::train, see layer_buffer and error_buffer for the ids
+     * forward step i (0 <= i < L-1) writes layer i+1, backward step L-1+(L-1-i) updates the connection into layer i:
+     * it reads error i and layer i-1 and writes error i-1, the output error is written by the first backward step
+     */
+    static MemoryPlan training(const vector<int>& sizes, int batch_size, int num_threads=1){
+        int L = (int)sizes.size();
+        auto backward_step = [L](int i){return L-1+(L-1-i);};
+        vector<BufferRequest> requests;
+        for(int i=1;i<L;i++){
+            //the output layer is last read for its own error, hidden layer i for the weight update of connection i+1
+            int last = (i==L-1) ? backward_step(L-1) : backward_step(i+1);
+            requests.push_back({(long)batch_size*sizes[i], i-1, last});
+        }
+        for(int i=1;i<L;i++){
+            int first = (i==L-1) ? backward_step(L-1) : backward_step(i+1);
+            requests.push_back({(long)batch_size*sizes[i], first, backward_step(i)});
+        }
+        return MemoryPlan(requests, num_threads);
+    }
+
+    static int layer_buffer(int layer){return layer-1;}
+    static int error_buffer(const vector<int>& sizes, int layer){return (int)sizes.size()-1+layer-1;}
+
+    int get_num_buffers() const {return (int)requests.size();}
+    int get_num_threads() const {return num_threads;}
+    long get_offset(int buffer) const {return offsets.at(buffer);}
+
+    //bytes of one thread's slice and of the whole arena
+    long get_slice_bytes() const {return slice_size*sizeof(double);}
+    long get_arena_bytes() const {return slice_size*sizeof(double)*num_threads;}
+
+    //bytes the buffers would take with a separate allocation each
+    long get_unplanned_bytes() const {
+        long total=0;
+        for(const BufferRequest& r : requests) total+=align(r.size);
+        return total*sizeof(double)*num_threads;
+    }
+};
+
+//the single allocation backing a MemoryPlan, only reallocated when a new plan doesn't fit
+class Arena{
+
+private:
+    MemoryPlan plan;
+    double* memory;
+    long capacity; //bytes
+
+    Arena(const Arena&);
+    Arena& operator=(const Arena&);
+
+public:
+
+    Arena(){
+        memory=NULL;
+        capacity=0;
+    }
+
+    Arena(const MemoryPlan& plan) : Arena() {reset(plan);}
+
+    //replaces the plan, only allocates when the arena is too small for it
+    void reset(const MemoryPlan& plan){
+        if(memory==NULL || plan.get_arena_bytes()>capacity){
+            Backend::aligned_free(memory);
+            capacity = max(plan.get_arena_bytes(), (long)DATA_ALIGNMENT);
+            memory = (double*)Backend::aligned_malloc(capacity, DATA_ALIGNMENT);
+        }
+        this->plan=plan;
+    }
+
+    const MemoryPlan& get_plan() const {return plan;}
+
+    double* get(int buffer, int thread=0) const {
+        return memory + (plan.get_slice_bytes()/sizeof(double))*thread + plan.get_offset(buffer);
+    }
+
+    ~Arena(){Backend::aligned_free(memory);}
+};
+
+#endif /* MemoryPlan_h */
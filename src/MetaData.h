@@ -76,6 +76,7 @@
 #include <string>
 #include <vector>
 #include <tuple>
+#include <map>
 #include <stdexcept>
 
 #include "attribute.h"
@@ -101,15 +102,70 @@ private:
     int entry_data_length;
     int expected_data_length;
     
+    //feature hashing requested per label, and for every categorical attribute with more than hash_threshold values
+    map<string, int> hash_buckets;
+    int hash_threshold;
+    int hash_threshold_buckets;
+    
+    //buckets the encoding options give attribute a, 0 for the one hot encoding (the class is never hashed)
+    int hashBucketsFor(Attribute& a){
+        if(a.getType()!=CATEGORICAL || a.getLabel()==CLASSLABEL) return 0;
+        auto it = hash_buckets.find(a.getLabel());
+        if(it!=hash_buckets.end()) return it->second;
+        if(hash_threshold_buckets>0 && (int)a.getValues().size()>hash_threshold) return hash_threshold_buckets;
+        return 0;
+    }
+    
+    void applyEncodingOptions(){
+        for(Attribute& a : attributes) a.setHashBuckets(hashBucketsFor(a));
+        update_input_layer_size();
+    }
+    
 public:
     
+    ARFFMetaData(){
+        entry_data_length=0;
+        expected_data_length=0;
+        hash_threshold=0;
+        hash_threshold_buckets=0;
+    }
+    
     string getRelation(){ return relation;}
     
     void setRelation(string r){relation=r;}
     
     vector<Attribute>& getAttributes(){ return attributes;}
     
-    void addAttribute(Attribute& a) {attributes.push_back(a);}
+    void addAttribute(Attribute& a) {
+        attributes.push_back(a);
+        attributes.back().setHashBuckets(hashBucketsFor(attributes.back()));
+    }
+    
+    /*
+     * Feature hashing: the categorical attribute with label takes buckets input slots and every value sets the slot
+     * Attribute::hashSlot picks for it, instead of one slot per listed value. Collisions just share a slot, values the
+     * header doesn't list still get one and 0 buckets goes back to the one hot encoding. Options can be set on the
+     * metadata of an empty dataset before loading, the loaders apply them to the header they read (setEncodingOptions).
+     */
+    void setHashBuckets(string label, int buckets){
+        hash_buckets[label] = buckets>0 ? buckets : 0;
+        applyEncodingOptions();
+    }
+    
+    //hashes every categorical attribute (but the class) with more than max_values values into buckets slots
+    void setHashThreshold(int max_values, int buckets){
+        hash_threshold = max_values;
+        hash_threshold_buckets = buckets>0 ? buckets : 0;
+        applyEncodingOptions();
+    }
+    
+    //copies the encoding options of other, keeps the attributes
+    void setEncodingOptions(const ARFFMetaData& other){
+        hash_buckets = other.hash_buckets;
+        hash_threshold = other.hash_threshold;
+        hash_threshold_buckets = other.hash_threshold_buckets;
+        applyEncodingOptions();
+    }
     
     int get_num_attributes(){return (int)attributes.size();}
     
@@ -117,15 +173,12 @@ public:
     
     vector<string>& get_class_values() override{ return getValues(CLASSLABEL); }
    
-    //calculates the length of the array produced by the "one hot encoding"
+    //calculates the length of the array produced by the "one hot encoding" (hashed attributes take their buckets)
     int calcEntryVectorLength(){
         int length=0;
         for(Attribute& a : attributes){
             if(a.getLabel()==CLASSLABEL) continue;
-            else if(a.getType()==NUMERIC) length++;
-            else if(a.getType()==CATEGORICAL){
-                for(string s: a.getValues()) length++;
-            }
+            else length+=a.getEncodedSize();
         }
         
         return length;
@@ -172,10 +225,7 @@ public:
                 }
                 return index;
             }
-            else if(a.getType()==NUMERIC) index++;
-            else if(a.getType()==CATEGORICAL){
-                for(string val : a.getValues()) index++;
-            }
+            else index+=a.getEncodedSize();
         }
         cerr<<"Error.  Label "<<label<<" not found in calcNumericDataIndex\n.";
         return -1;
@@ -199,13 +249,10 @@ public:
                     return make_tuple(-1,-1);
                 }
                 start=index;
-                for(string val : a.getValues()) index++;
+                index+=a.getEncodedSize();
                 return make_tuple(start,index);
             }
-            else if(a.getType()==NUMERIC) index++;
-            else if(a.getType()==CATEGORICAL){
-                for(string val : a.getValues()) index++;
-            }
+            else index+=a.getEncodedSize();
         }
         cerr<<"Error.  Label "<<label<<" not found in calcNumericDataIndex\n.";
         return make_tuple(-1,-1);
@@ -244,7 +291,7 @@ public:
             if(a.getType()==NUMERIC) os<<NUMERIC<<endl;
             else{
                 os<<"{ ";
-                for(int i=0;i<a.getValues().size()-1;i++) os<<a.getValues().at(i)<<", ";
+                for(int i=0;i<(int)a.getValues().size()-1;i++) os<<a.getValues().at(i)<<", ";
                 os<<a.getValues().back()<<"}"<<endl;
             }
         }
@@ -19,12 +19,24 @@
 #include <map>
 #include <stdexcept>
 #include <chrono>
-#include <mkl.h>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <memory>
+#include "Backend.h"
 
 #include "Dataset.h"
+#include "Folds.h"
+#include "Pipeline.h"
+#include "MemoryPlan.h"
+#include "Checkpoint.h"
+#include "ThreadPool.h"
+#include "Random.h"
 
 #define TOTAL_TIME "Total time"
 #define TRAIN_TIME "Train time"
+#define TRAINER_STALL_TIME "Trainer stall time"
+#define LOADER_STALL_TIME "Loader stall time"
 
 #define ACCURACY "Accuracy"
 #define MICRO_RECALL "Micro Recall "
@@ -40,10 +52,48 @@
 #define RSQUARED "R^2"
 #define MAPE "Mean Absolute Percent Error"
 
+#define MODEL_MAGIC "FNN1"
+
+//networks per thread whose workspaces MLPNetwork::local_workspace keeps
+#ifndef LOCAL_WORKSPACES
+#define LOCAL_WORKSPACES 8
+#endif
+
 
 
 using namespace std;
 
+class Network;
+
+//settings for Network::cross_validate
+struct CVOptions{
+    int num_folds;
+    int random_state;       //seeds the fold assignment and the epoch orderings
+    bool stratified;        //keep the class proportions of the dataset in every fold
+    bool reshuffle_epochs;  //train on a new permutation of the training rows every epoch
+    int shuffle_threads;    //threads computing each epoch ordering, the ordering is the same for any count
+    int pipeline_loaders;   //threads assembling batches ahead of the trainer, 0 trains straight from the dataset
+    int pipeline_batch;     //rows per batch
+    int pipeline_depth;     //batches buffered per loader
+    Checkpointer* checkpointer; //writes the training state in the background, NULL for no checkpoints
+    bool resume;                //continue from the checkpointer's last checkpoint if it has one
+    function<void(int fold, const Network& net)> fold_trained; //called with every fold model after training, e.g. MLPEnsemble::collector()
+    function<void(Network& net, Dataset& data, const vector<long>& train_rows)> trainer; //trains every fold instead of num_epochs of per-row SGD, e.g. LBFGSTrainer::cv_trainer()
+    
+    CVOptions(int num_folds=10, int random_state=420){
+        this->num_folds=num_folds;
+        this->random_state=random_state;
+        stratified=false;
+        reshuffle_epochs=true;
+        shuffle_threads=1;
+        pipeline_loaders=0;
+        pipeline_batch=64;
+        pipeline_depth=4;
+        checkpointer=NULL;
+        resume=false;
+    }
+};
+
 class Network{
 public:
     enum ACTIVATION {LOGISTIC, TANH, RELU};
@@ -51,10 +101,15 @@ public:
     virtual void randomize_weights_and_biases(int seed=420)=0;
     virtual void set_learning_rate(double learningrate)=0;
     virtual void train(Entry& e) = 0;
-    virtual string classify(Entry& e, vector<string> classlabels) =0;
-    virtual double predict(Entry& e) =0;
+    virtual string classify(const Entry& e, const vector<string>& classlabels) const =0;
+    virtual double predict(const Entry& e) const =0;
+    
+    //writes the parameters, restore reads them back into a network of the same shape
+    virtual void save(ostream& os) const =0;
+    virtual void restore(istream& is) =0;
     
     static map<string,double> cross_validate(Dataset& data, Network& net, int num_epochs, double lr, int num_folds=10, int random_state=420);
+    static map<string,double> cross_validate(Dataset& data, Network& net, int num_epochs, double lr, const CVOptions& options);
 
 };
 
@@ -71,11 +126,18 @@ private:
     double** biases;
     double** errors;
     
+    //layers and errors of train() are planned into one allocation
+    Arena train_arena;
+    
     //used to compare predicted class label to actual class label
     double* expected;
     
     double learningrate;
     ACTIVATION activation;
+    
+    //threads for the kernels of connections with at least intra_op_threshold weights, see set_intra_op_threads
+    int intra_op_threads;
+    long intra_op_threshold;
 
     void init_layers(){
         weights = new double*[num_layers-1];
@@ -85,15 +147,130 @@ private:
         
         biases[0]=NULL;
         errors[0]=NULL;
+        intra_op_threads=1;
+        intra_op_threshold=INTRA_OP_THRESHOLD;
+        train_arena.reset(MemoryPlan::training(sizes, 1));
         for(int i=0;i< num_layers-1;i++){
             //allocating these so that the address of actual arrays of doubles is a multiple of 64
             //I can't explain why this is necessary but it greatly improves performance
-            weights[i] = (double*)MKL_malloc(sizeof(double)*sizes.at(i)*sizes.at(i+1),DATA_ALIGNMENT);
-            biases[i+1] = (double*)MKL_malloc(sizeof(double)*sizes.at(i+1),DATA_ALIGNMENT);
-            layers[i+1]= (double*)MKL_malloc(sizeof(double)*sizes.at(i+1),DATA_ALIGNMENT);
-            errors[i+1]= (double*)MKL_malloc(sizeof(double)*sizes.at(i+1),DATA_ALIGNMENT);
+            weights[i] = (double*)Backend::aligned_malloc(sizeof(double)*sizes.at(i)*sizes.at(i+1),DATA_ALIGNMENT);
+            biases[i+1] = (double*)Backend::aligned_malloc(sizeof(double)*sizes.at(i+1),DATA_ALIGNMENT);
+            layers[i+1]= train_arena.get(MemoryPlan::layer_buffer(i+1));
+            errors[i+1]= train_arena.get(MemoryPlan::error_buffer(sizes, i+1));
+        }
+    }
+    
+    void load(istream& is){
+        char magic[4];
+        int32_t header[2];
+        is.read(magic, 4);
+        is.read((char*)header, sizeof(header));
+        if(!is || memcmp(magic, MODEL_MAGIC, 4)!=0 || header[1]<2){
+            cerr<<"Error. Stream does not contain a network written by MLPNetwork::save\n";
+            throw invalid_argument("invalid model file\n");
+        }
+        activation = (ACTIVATION)header[0];
+        num_layers = header[1];
+        sizes = vector<int>();
+        for(int i=0;i<num_layers;i++){
+            int32_t size;
+            is.read((char*)&size, sizeof(size));
+            sizes.push_back(size);
+        }
+        is.read((char*)&learningrate, sizeof(double));
+        
+        init_layers();
+        for(int i=0;i<num_layers-1;i++){
+            is.read((char*)weights[i], sizeof(double)*sizes.at(i)*sizes.at(i+1));
+            is.read((char*)biases[i+1], sizeof(double)*sizes.at(i+1));
+        }
+        if(!is){
+            cerr<<"Error. Model stream ended before all weights were read\n";
+            throw invalid_argument("truncated model file\n");
+        }
+    }
+    
+#ifdef MKL_THREADED
+    //sets the calling thread's MKL thread count for one kernel call
+    struct MKLThreads{
+        int previous;
+        MKLThreads(int n){previous = Backend::set_num_threads_local(n);}
+        ~MKLThreads(){Backend::set_num_threads_local(previous);}
+    };
+#endif
+    
+    //runs f(begin, end) over [0, n) for connection i, split across threads if the connection is wide enough
+    //with threaded MKL the whole range is one call and MKL gets the threads instead
+    template<class F>
+    void split(int i, long n, long grain, const F& f) const {
+        bool wide = intra_op_threads>1 && (long)sizes.at(i)*sizes.at(i+1)>=intra_op_threshold;
+#ifdef MKL_THREADED
+        MKLThreads threads(wide ? intra_op_threads : 1);
+        f(0, n);
+#else
+        if(wide) ThreadPool::shared(intra_op_threads).parallel_for(n, f, grain, intra_op_threads);
+        else f(0, n);
+#endif
+    }
+    
+    // W[i] in -> out, split by rows of W[i]
+    void layer_gemv(int i, const double* in, double* out) const {
+        int cols = sizes.at(i);
+        const double* w = weights[i];
+        split(i, sizes.at(i+1), 8, [w, cols, in, out](long begin, long end){
+            Backend::gemv(Backend::NoTrans, (int)(end-begin), cols, 1, w+begin*cols, cols, in, 0, out+begin);
+        });
+    }
+    
+    // W[i]^T err -> out, split by columns of W[i] so every thread owns a slice of out
+    void layer_gemv_trans(int i, const double* err, double* out) const {
+        int rows = sizes.at(i+1), cols = sizes.at(i);
+        const double* w = weights[i];
+        split(i, cols, 8, [w, rows, cols, err, out](long begin, long end){
+            Backend::gemv(Backend::Trans, rows, (int)(end-begin), 1, w+begin, cols, err, 0, out+begin);
+        });
+    }
+    
+    // lr * err in^T + W[i] -> W[i], split by rows of W[i]
+    void layer_ger(int i, const double* err, const double* in){
+        int cols = sizes.at(i);
+        double* w = weights[i];
+        double lr = learningrate;
+        split(i, sizes.at(i+1), 1, [w, cols, err, in, lr](long begin, long end){
+            Backend::ger((int)(end-begin), cols, lr, err+begin, in, w+begin*cols, cols);
+        });
+    }
+    
+    // W[i]^T err -> out and lr * err in^T + W[i] -> W[i] in one pass over W[i], split by columns of W[i]
+    void layer_backward(int i, const double* err, const double* in, double* out){
+        int rows = sizes.at(i+1), cols = sizes.at(i);
+        double* w = weights[i];
+        double lr = learningrate;
+        split(i, cols, 8, [w, rows, cols, err, in, out, lr](long begin, long end){
+            Backend::gemv_trans_ger(rows, (int)(end-begin), lr, err, out+begin, in+begin, w+begin, cols);
+        });
+    }
+    
+    //W[0] x for a sparse input, only the weight columns of its nonzero values are read
+    void sparse_first_layer(const Entry& e, double* out) const {
+        int n = sizes.at(0);
+        for(int j=0;j<sizes.at(1);j++){
+            const double* w = weights[0]+(long)j*n;
+            double sum=0;
+            for(int k=0;k<e.nnz;k++) sum+=w[e.sparse_indices[k]]*e.sparse_values[k];
+            out[j]=sum;
+        }
+    }
+    
+    //lr * E[1] x^T + W[0] -> W[0] for a sparse input, the columns of its zeros have a zero gradient and are left alone
+    void sparse_first_layer_update(const Entry& e, const double* error){
+        int n = sizes.at(0);
+        for(int j=0;j<sizes.at(1);j++){
+            double g = learningrate*error[j];
+            double* w = weights[0]+(long)j*n;
+            for(int k=0;k<e.nnz;k++) w[e.sparse_indices[k]]+=g*e.sparse_values[k];
         }
-    }    
+    }
 
 public:
     
@@ -133,47 +310,156 @@ public:
         randomize_weights_and_biases(random_state);
     }
     
+    //reads a network written by MLPNetwork::save
+    MLPNetwork(istream& is){
+        load(is);
+    }
+    
+    MLPNetwork(string filename){
+        ifstream inFile(filename.c_str(), ios::binary);
+        if(!inFile){
+            cerr<<"unable to open model file: "<<filename<<endl;
+            throw invalid_argument("unable to open model file\n");
+        }
+        load(inFile);
+    }
+    
+    const vector<int>& get_sizes() const {return sizes;}
+    int get_num_layers() const {return num_layers;}
+    int get_input_size() const {return sizes.front();}
+    int get_output_size() const {return sizes.back();}
+    ACTIVATION get_activation() const {return activation;}
+    double get_learning_rate() const {return learningrate;}
+    
+    //weights and biases of the connection from layer i to layer i+1
+    //weights are row major, one row of sizes[i] values per neuron in layer i+1
+    const double* get_weights(int i) const {return weights[i];}
+    const double* get_biases(int i) const {return biases[i+1];}
+    
+    //writable weights for passes that edit a trained network in place, e.g. pruning
+    double* get_weights(int i) {return weights[i];}
+    
+    //length of the flat parameter vector: every connection's weights followed by its biases, in layer order
+    long get_num_parameters() const {
+        long n=0;
+        for(int i=0;i<num_layers-1;i++) n+=(long)sizes.at(i+1)*(sizes.at(i)+1);
+        return n;
+    }
+    
+    void get_parameters(double* params) const {
+        for(int i=0;i<num_layers-1;i++){
+            long n = (long)sizes.at(i+1)*sizes.at(i);
+            memcpy(params, weights[i], sizeof(double)*n);
+            memcpy(params+n, biases[i+1], sizeof(double)*sizes.at(i+1));
+            params += n+sizes.at(i+1);
+        }
+    }
+    
+    void set_parameters(const double* params){
+        for(int i=0;i<num_layers-1;i++){
+            long n = (long)sizes.at(i+1)*sizes.at(i);
+            memcpy(weights[i], params, sizeof(double)*n);
+            memcpy(biases[i+1], params+n, sizeof(double)*sizes.at(i+1));
+            params += n+sizes.at(i+1);
+        }
+    }
+    
+    //writes the topology, activation, learning rate, weights and biases in binary
+    void save(ostream& os) const override {
+        int32_t header[2] = {(int32_t)activation, (int32_t)num_layers};
+        os.write(MODEL_MAGIC, 4);
+        os.write((char*)header, sizeof(header));
+        for(int x : sizes){
+            int32_t size = x;
+            os.write((char*)&size, sizeof(size));
+        }
+        os.write((char*)&learningrate, sizeof(double));
+        for(int i=0;i<num_layers-1;i++){
+            os.write((char*)weights[i], sizeof(double)*sizes.at(i)*sizes.at(i+1));
+            os.write((char*)biases[i+1], sizeof(double)*sizes.at(i+1));
+        }
+    }
+    
+    //reads a network written by save into this one, which must have the same topology and activation
+    void restore(istream& is) override {
+        MLPNetwork saved(is);
+        if(saved.sizes!=sizes || saved.activation!=activation){
+            cerr<<"Error. Can't restore a network with a different topology or activation\n";
+            throw invalid_argument("network shape mismatch\n");
+        }
+        learningrate = saved.learningrate;
+        for(int i=0;i<num_layers-1;i++){
+            memcpy(weights[i], saved.weights[i], sizeof(double)*sizes.at(i)*sizes.at(i+1));
+            memcpy(biases[i+1], saved.biases[i+1], sizeof(double)*sizes.at(i+1));
+        }
+    }
+    
+    void save(string filename) const {
+        ofstream outFile(filename.c_str(), ios::binary);
+        if(!outFile){
+            cerr<<"unable to open model file: "<<filename<<endl;
+            throw invalid_argument("unable to open model file\n");
+        }
+        save(outFile);
+    }
+    
+    //changes the first layer so the network computes the same function after input indices[i] is transformed by x' = scale[i]*x + shift[i]
+    //used to keep a trained network consistent when the normalization of its inputs changes
+    void transform_inputs(const vector<int>& indices, const vector<double>& scale, const vector<double>& shift){
+        int n = sizes.at(0);
+        for(int j=0;j<sizes.at(1);j++){
+            double* w = weights[0]+(long)j*n;
+            for(int i=0;i<(int)indices.size();i++){
+                w[indices[i]] /= scale[i];
+                biases[1][j] -= w[indices[i]]*shift[i];
+            }
+        }
+    }
+    
+    /*
+     * Splits the matvecs and rank one updates of every connection with at least threshold weights (rows*cols) across
+     * num_threads threads (0 for every core), smaller connections stay on the calling thread so their latency doesn't
+     * pay for waking the pool. Uses the shared ThreadPool, or threaded MKL when built with THREADING=mkl.
+     */
+    void set_intra_op_threads(int num_threads, long threshold=INTRA_OP_THRESHOLD){
+        if(num_threads<1) num_threads = max(1, (int)thread::hardware_concurrency());
+        intra_op_threads = num_threads;
+        intra_op_threshold = threshold;
+    }
+    
+    int get_intra_op_threads() const {return intra_op_threads;}
+    long get_intra_op_threshold() const {return intra_op_threshold;}
+    
     void set_learning_rate(double lr) override { learningrate=lr;}
     
+    //weight k of connection i is draw k of stream i and bias j follows the weights, so wide layers fill in parallel
+    //and the result only depends on the seed
     void randomize_weights_and_biases(int seed=420) override {
         
-        random_device rd;
-        mt19937 rng(rd());
-        rng.seed(seed);
-        uniform_real_distribution<double> dist(-0.5,0.5);
-        
-        
-        switch (activation){
-            case LOGISTIC:
-                goto def;
-            case TANH:
-                for(int i=0; i<num_layers-1;i++){
-                    normal_distribution<double> norm_dist(0, sqrt(1/(double)sizes.at(i)));
-                    for(int j=0;j<sizes.at(i+1);j++){
-                        biases[i+1][j]=0;
-                        for(int k=0;k<sizes.at(i);k++){
-                            weights[i][j*sizes.at(i)+k]=norm_dist(rng);
-                            //cout<<weights[i][j*sizes.at(i)+k]<<endl;
-                        }
+        for(int i=0;i<num_layers-1;i++){
+            CounterRNG rng((uint32_t)seed, RNG_INIT, i);
+            long cols = sizes.at(i), rows = sizes.at(i+1);
+            double* w = weights[i];
+            double* b = biases[i+1];
+            if(activation==TANH){
+                double stddev = sqrt(1/(double)cols);
+                split(i, rows, 8, [&rng, w, b, rows, cols, stddev](long begin, long end){
+                    for(long j=begin;j<end;j++){
+                        b[j]=0;
+                        for(long k=0;k<cols;k++) w[j*cols+k]=stddev*rng.normal(j*cols+k);
                     }
-                    
-                }
-                break;
-            case RELU:
-                goto def;
-            default:
-                def:
-                for(int i=0;i<num_layers-1;i++){
-                    for(int j=0; j<sizes.at(i+1);j++){
-                        biases[i+1][j]=dist(rng);
-                        for(int k=0;k<sizes.at(i);k++){
-                            weights[i][j*sizes.at(i)+k]=dist(rng);
-                        }
+                });
+            }
+            else{
+                //LOGISTIC and RELU
+                split(i, rows, 8, [&rng, w, b, rows, cols](long begin, long end){
+                    for(long j=begin;j<end;j++){
+                        b[j]=rng.uniform(rows*cols+j, -0.5, 0.5);
+                        for(long k=0;k<cols;k++) w[j*cols+k]=rng.uniform(j*cols+k, -0.5, 0.5);
                     }
-                }
-                break;
-                
-        }//end switch
+                });
+            }
+        }
         
     }
     
@@ -189,11 +475,12 @@ public:
             
             //multiply weights[i] by layers[i] and store it in layers[i+1]
             // W[i] L[i] + 0*L[i+1] -> L[i+1]
-            cblas_dgemv(CblasRowMajor, CblasNoTrans, sizes.at(i+1), sizes.at(i), 1, weights[i], sizes.at(i), layers[i], 1, 0, layers[i+1], 1);
+            if(i==0 && e.isSparse()) sparse_first_layer(e, layers[1]);
+            else layer_gemv(i, layers[i], layers[i+1]);
             
             //add biases[i]
             //B[i+1] + L[i+1] -> L[i+1]
-            cblas_daxpy(sizes.at(i+1), 1, biases[i+1], 1, layers[i+1], 1);
+            Backend::axpy(sizes.at(i+1), 1, biases[i+1], layers[i+1]);
             
             //take sigmoid/softmax
             if(i<num_layers-2){
@@ -216,30 +503,113 @@ public:
             
             //update bias
             //lr * E[i] + B[i] -> B[i]
-            cblas_daxpy(sizes.at(i), learningrate, errors[i], 1, biases[i], 1);
+            Backend::axpy(sizes.at(i), learningrate, errors[i], biases[i]);
             
-            //calc error
-            //need to do this before updating weights
-            //but dont need to do this for input layer
+            //calc error and update weights
+            //weights increment is lr * the outer product of E[i] and L[i-1]
+            //but dont need to calc error for input layer
             if(i>1){
-                //backpropogate error
+                //backpropogate error with the weights from before the update, in the same pass over W[i-1] as the update
                 // W[i-1]^T E[i] + 0*E[i-1] -> E[i-1]
-                cblas_dgemv(CblasRowMajor, CblasTrans, sizes.at(i), sizes.at(i-1), 1, weights[i-1], sizes.at(i-1), errors[i], 1, 0, errors[i-1], 1);
+                // lr*E[i]L[i-1]^T + W[i-1] -> W[i-1]
+#ifdef MKL_THREADED
+                //threaded MKL splits the two calls itself, the fused kernel would run on one thread
+                layer_gemv_trans(i-1, errors[i], errors[i-1]);
+                layer_ger(i-1, errors[i], layers[i-1]);
+#else
+                layer_backward(i-1, errors[i], layers[i-1], errors[i-1]);
+#endif
                 
                 //calc gradient in previous layer
                 //multiply errors[i-1][j] by layers[i-1][j]*(1-layers[i-1][j])
                 times_activation_func_deriv(layers[i-1], errors[i-1], sizes.at(i-1));
             }
-            
-            //update weights
-            //weights increment is lr * the outer product of E[i] and L[i-1]
-            // lr*E[i]L[i-1]^T + W[i-1] -> W[i-1]
-            cblas_dger(CblasRowMajor, sizes.at(i), sizes.at(i-1), learningrate, errors[i], 1, layers[i-1], 1, weights[i-1], sizes.at(i-1));
+            else if(e.isSparse()) sparse_first_layer_update(e, errors[1]);
+            else layer_ger(i-1, errors[i], layers[i-1]);
         }
     }//end train method
     
     
-    string classify(Entry& e, vector<string> classlabels) override {
+    //scratch activations for one thread running inference against a shared network
+    //one planned arena for the layers of a forward pass over up to capacity rows, layers that are never live together share memory
+    class Workspace{
+        
+    private:
+        int capacity;
+        vector<int> sizes;
+        Arena arena;
+        
+        Workspace(const Workspace&);
+        Workspace& operator=(const Workspace&);
+        
+    public:
+        
+        Workspace(){
+            capacity=0;
+        }
+        
+        Workspace(const MLPNetwork& net, int rows=1) : Workspace() { reserve(net, rows);}
+        
+        //replans if net has a different topology or more than capacity rows are needed, never shrinks the arena
+        void reserve(const MLPNetwork& net, int num_rows){
+            if(num_rows>capacity || sizes!=net.sizes){
+                sizes = net.sizes;
+                capacity = max(num_rows, capacity);
+                arena.reset(MemoryPlan::inference(sizes, capacity));
+            }
+        }
+        
+        int get_capacity() const {return capacity;}
+        
+        //true if the workspace was reserved for net's topology and holds num_rows rows
+        bool fits(const MLPNetwork& net, int num_rows) const {return num_rows<=capacity && sizes==net.sizes;}
+        
+        //activations of layer i (1 <= i < number of layers) for every row
+        double* layer(int i) const {return arena.get(MemoryPlan::layer_buffer(i));}
+        
+        long get_arena_bytes() const {return arena.get_plan().get_arena_bytes();}
+    };
+    
+    //workspace used by the overloads that don't take one, so every scoring thread gets its own scratch space
+    //a thread keeps one workspace per network for the last LOCAL_WORKSPACES networks it used, so alternating between networks
+    //neither replans nor invalidates the layer pointers of the others, only the least recently used one is replaced
+    Workspace& local_workspace(int num_rows=1) const {
+        struct Slot{
+            const MLPNetwork* net;
+            unsigned long last_use;
+            Workspace ws;
+            Slot() : net(NULL), last_use(0) {}
+        };
+        thread_local Slot slots[LOCAL_WORKSPACES];
+        thread_local unsigned long uses=0;
+        
+        Slot* slot = &slots[0];
+        for(Slot& s : slots){
+            if(s.net==this){
+                slot=&s;
+                break;
+            }
+            if(s.last_use<slot->last_use) slot=&s;
+        }
+        slot->net=this;
+        slot->last_use=++uses;
+        slot->ws.reserve(*this, num_rows);
+        return slot->ws;
+    }
+    
+    //every overload taking a caller's workspace checks that it was reserved for this network and batch size
+    void check_workspace(const Workspace& ws, int num_rows, const char* caller) const {
+        if(!ws.fits(*this, num_rows)){
+            cerr<<"Error. Workspace given to "<<caller<<" was not reserved for this network or holds fewer than "<<num_rows<<" rows\n";
+            throw invalid_argument("workspace does not fit network or batch\n");
+        }
+    }
+    
+    string classify(const Entry& e, const vector<string>& classlabels) const override {
+        return classify(e, classlabels, local_workspace());
+    }
+    
+    string classify(const Entry& e, const vector<string>& classlabels, Workspace& ws) const {
         
         if(e.get_expected_size()<2 || sizes.back()<2){
             cerr<<"Error. Must have at least two distinct class values to classify\n";
@@ -253,55 +623,135 @@ public:
         }
         
         
-        if(classlabels.size()!=sizes.back()){
+        if((int)classlabels.size()!=sizes.back()){
             cerr<<"Error. Classlabel list must be the same size as output layer\n";
             throw invalid_argument("invalid label list or network architecture\n");
         }
         
-        layers[0]=e.data;
-        for(int i=0;i<num_layers-1;i++){
-            
-            //multiply weights[i] by layers[i] and store it in layers[i+1]
-            cblas_dgemv(CblasRowMajor, CblasNoTrans, sizes.at(i+1), sizes.at(i), 1, weights[i], sizes.at(i), layers[i], 1, 0, layers[i+1], 1);
-            
-            //add biases[i]
-            cblas_daxpy(sizes.at(i+1), 1, biases[i+1], 1, layers[i+1], 1);
-            
-            //take sigmoid/softmax
-            if(i==num_layers-2) softmax(layers[i+1], sizes.at(i+1));
-            
-            else activation_func(layers[i+1], sizes.at(i+1));
-            
-        }
+        const double* output = forward(e, ws);
+        
         int prediction_index = 0;
         double max = -numeric_limits<double>::infinity();
-        for(int i=0;i<classlabels.size();i++){
-            if(layers[num_layers-1][i]>max) {
+        for(int i=0;i<(int)classlabels.size();i++){
+            if(output[i]>max) {
                 prediction_index=i;
-                max=layers[num_layers-1][i];
+                max=output[i];
             }
         }
         
         return classlabels.at(prediction_index);
     }
     
-    double predict(Entry& e) override {
+    double predict(const Entry& e) const override {
+        return predict(e, local_workspace());
+    }
+    
+    double predict(const Entry& e, Workspace& ws) const {
         if(e.get_expected_size()!=1 || sizes.back()!=1){
             cerr<<"Error. Regression tasks can only have one output. Use Network::classify for classification tasks\n";
             throw invalid_argument("invalid data layout or network architecture\n");
         }
-
-        layers[0]=e.data;
+        
+        return forward(e, ws)[0];
+    }
+    
+    //runs a forward pass over one input vector using only the scratch space in ws
+    //returns a pointer into ws holding the output layer (class probabilities or the regression value)
+    const double* forward(const double* input, Workspace& ws) const {
+        return forward(input, NULL, ws);
+    }
+    
+    //same for an entry, sparse entries are read without filling in their zeros
+    const double* forward(const Entry& e, Workspace& ws) const {
+        return forward(e.data, e.isSparse() ? &e : NULL, ws);
+    }
+    
+    //the first layer reads the sparse view of sparse instead of input when it is given
+    const double* forward(const double* input, const Entry* sparse, Workspace& ws) const {
+        
+        check_workspace(ws, 1, "forward");
+        bool classification = sizes.back()>1;
+        const double* in = input;
         for(int i=0;i<num_layers-1;i++){
             
-            cblas_dgemv(CblasRowMajor, CblasNoTrans, sizes.at(i+1), sizes.at(i), 1, weights[i], sizes.at(i), layers[i], 1, 0, layers[i+1], 1);
+            double* out = ws.layer(i+1);
+            
+            //multiply weights[i] by the previous layer and store it in out
+            if(i==0 && sparse!=NULL) sparse_first_layer(*sparse, out);
+            else layer_gemv(i, in, out);
+            
+            //add biases[i]
+            Backend::axpy(sizes.at(i+1), 1, biases[i+1], out);
             
-            cblas_daxpy(sizes.at(i+1), 1, biases[i+1], 1, layers[i+1], 1);
+            //take sigmoid/softmax
+            if(i<num_layers-2) activation_func(out, sizes.at(i+1));
+            else if(classification) softmax(out, sizes.at(i+1));
             
-            if(i!=num_layers-2) activation_func(layers[i+1], sizes.at(i+1));
+            in = out;
+        }
+        return in;
+    }
+    
+    //runs a forward pass over num_rows input vectors stored contiguously in inputs (row major, input layer size doubles each)
+    //and writes num_rows output vectors (class probabilities or the regression value) contiguously into outputs
+    void forward_batch(const double* inputs, int num_rows, double* outputs) const {
+        forward_batch(inputs, num_rows, outputs, local_workspace(num_rows));
+    }
+    
+    void forward_batch(const double* inputs, int num_rows, double* outputs, Workspace& ws) const {
+        
+        check_workspace(ws, num_rows, "forward_batch");
+        
+        bool classification = sizes.back()>1;
+        const double* in = inputs;
+        for(int i=0;i<num_layers-1;i++){
+            
+            double* out = (i==num_layers-2) ? outputs : ws.layer(i+1);
+            
+            //broadcast the biases into every row so the product can accumulate on top of them
+            for(int r=0;r<num_rows;r++) memcpy(out+(long)r*sizes.at(i+1), biases[i+1], sizeof(double)*sizes.at(i+1));
+            
+            // L[i] W[i]^T + B[i+1] -> L[i+1], one row per entry
+            Backend::gemm(Backend::NoTrans, Backend::Trans, num_rows, sizes.at(i+1), sizes.at(i), 1, in, sizes.at(i), weights[i], sizes.at(i), 1, out, sizes.at(i+1));
+            
+            if(i<num_layers-2) activation_func(out, num_rows*sizes.at(i+1));
+            else if(classification){
+                for(int r=0;r<num_rows;r++) softmax(out+(long)r*sizes.at(i+1), sizes.at(i+1));
+            }
+            in = out;
+        }
+    }
+    
+    //same contract as forward_batch but with plain loops instead of BLAS calls
+    //faster when the layers are so small that the call overhead dominates
+    void forward_small(const double* inputs, int num_rows, double* outputs, Workspace& ws) const {
+        
+        check_workspace(ws, num_rows, "forward_small");
+        
+        bool classification = sizes.back()>1;
+        const double* in = inputs;
+        for(int i=0;i<num_layers-1;i++){
+            
+            double* out = (i==num_layers-2) ? outputs : ws.layer(i+1);
+            int n_in = sizes.at(i), n_out = sizes.at(i+1);
+            
+            for(int r=0;r<num_rows;r++){
+                const double* x = in+(long)r*n_in;
+                double* y = out+(long)r*n_out;
+                for(int j=0;j<n_out;j++){
+                    const double* w = weights[i]+(long)j*n_in;
+                    double sum = biases[i+1][j];
+                    for(int k=0;k<n_in;k++) sum+=w[k]*x[k];
+                    y[j]=sum;
+                }
+            }
+            
+            if(i<num_layers-2) activation_func(out, num_rows*n_out);
+            else if(classification){
+                for(int r=0;r<num_rows;r++) softmax(out+(long)r*n_out, n_out);
+            }
+            in = out;
         }
-        return layers[num_layers-1][0];
-
     }
     
     static double sigmoid(const double x){ return 1/(1+exp(-1*x));}
@@ -309,7 +759,11 @@ public:
     static double sigmoid_deriv(const double y){return y*(1-y);}
     
     
-    void activation_func(double* arr, int size){
+    void activation_func(double* arr, int size) const {
+        apply_activation(activation, arr, size);
+    }
+    
+    static void apply_activation(ACTIVATION activation, double* arr, int size){
         switch (activation){
             case LOGISTIC:
                 for(int i=0;i< size;i++) arr[i]=1/(1+exp(-1*arr[i]));
@@ -322,7 +776,7 @@ public:
                     double y = exp(-1*val);
                     arr[i]=(x-y)/(x+y);
                 }*/
-                vdTanh(size, arr, arr);
+                Backend::tanh(size, arr, arr);
                 
                 break;
             case RELU:
@@ -345,7 +799,7 @@ public:
     
     
     
-    void times_activation_func_deriv(double* timesarr, double* outarr, int size){
+    void times_activation_func_deriv(double* timesarr, double* outarr, int size) const {
         switch(activation){
             case LOGISTIC:
                 for(int i=0;i<size;i++){
@@ -365,10 +819,8 @@ public:
 
     ~MLPNetwork(){
         for(int i=1;i< num_layers;i++){
-            MKL_free(weights[i-1]);
-            MKL_free(biases[i]);
-            MKL_free(layers[i]);
-            MKL_free(errors[i]);
+            Backend::aligned_free(weights[i-1]);
+            Backend::aligned_free(biases[i]);
         }
         
         delete[] weights;
@@ -380,41 +832,117 @@ public:
 };
 
 map<string, double> Network::cross_validate(Dataset& data, Network& net, int num_epochs, double lr, int num_folds, int random_state){
+    return cross_validate(data, net, num_epochs, lr, CVOptions(num_folds, random_state));
+}
+
+map<string, double> Network::cross_validate(Dataset& data, Network& net, int num_epochs, double lr, const CVOptions& options){
     
     map<string, double> avgscores;
-    int max_folds=num_folds;
+    int max_folds=options.num_folds;
     
     net.set_learning_rate(lr);
 
     bool classification = data.getMeta().get_output_layer_size()>1;
     
+    //folds and epoch orderings are permutations of row indices, the entries themselves never move
+    FoldPlan plan(data, max_folds, options.random_state, options.stratified && classification);
+    vector<long> train_rows;
+    Entry scratch(data.getMeta().get_input_layer_size(), data.getMeta().get_output_layer_size());
+    unique_ptr<BatchPipeline> pipeline;
+    if(options.pipeline_loaders>0) pipeline.reset(new BatchPipeline(data, options.pipeline_batch, options.pipeline_depth, options.pipeline_loaders));
+    
     long double train_time=0, tot_time=0;
+    
+    //picks up after the last completed checkpoint, the options have to match the run that wrote it
+    TrainingState resume_state;
+    bool resuming = options.checkpointer && options.resume && options.checkpointer->load(resume_state);
+    if(resuming){
+        if(resume_state.num_folds!=max_folds || resume_state.random_state!=options.random_state || resume_state.num_epochs!=num_epochs
+           || resume_state.rng!=CounterRNG::name()){
+            cerr<<"Error. Checkpoint "<<options.checkpointer->get_path()<<" was written with different folds, seed, epochs or generator\n";
+            throw invalid_argument("checkpoint does not match options\n");
+        }
+        avgscores = resume_state.scores;
+        train_time = resume_state.train_time;
+    }
+    
+    //hands the state before fold next_fold, epoch next_epoch to the writer thread, the trainer only pays for the copy
+    auto checkpoint = [&](int next_fold, int next_epoch, long double train_ns){
+        TrainingState& s = options.checkpointer->begin_snapshot();
+        s.num_folds=max_folds;
+        s.random_state=options.random_state;
+        s.num_epochs=num_epochs;
+        s.fold=next_fold;
+        s.epoch=next_epoch;
+        s.train_time=(double)train_ns;
+        s.rng=CounterRNG::name();
+        s.train_rows.assign(train_rows.begin(), train_rows.end());
+        s.scores=avgscores;
+        s.model.clear();
+        VectorStreamBuf buf(s.model);
+        ostream model(&buf);
+        net.save(model);
+        options.checkpointer->commit_snapshot(s);
+    };
+    
     auto tot_start = chrono::system_clock::now();
-    for(int fold =0; fold<max_folds;fold++){
-        net.randomize_weights_and_biases();
-        long int num_entries = data.getSize();
+    for(int fold = resuming ? resume_state.fold : 0; fold<max_folds;fold++){
+        int first_epoch=0;
+        if(resuming && fold==resume_state.fold && resume_state.epoch>0){
+            istringstream model(string(resume_state.model.begin(), resume_state.model.end()));
+            net.restore(model);
+            train_rows = resume_state.train_rows;
+            first_epoch = resume_state.epoch;
+        }
+        else{
+            net.randomize_weights_and_biases();
+            plan.train_indices(fold, train_rows);
+        }
+        long num_train = (long)train_rows.size();
                 
         chrono::time_point<chrono::system_clock> start, end;
         chrono::duration<long double> elapsed;
         
         start = chrono::system_clock::now();
-        for(int i=0;i<num_epochs;i++){
-            for(long j=0;j<num_entries*fold/max_folds;j++) net.train(data.getData()[j]);
-            for(long j=num_entries*(fold+1)/max_folds;j<num_entries; j++) net.train(data.getData()[j]);
+        //a fold trainer takes the whole training fold at once, otherwise num_epochs of per-row SGD
+        if(options.trainer) options.trainer(net, data, train_rows);
+        else{
+            for(int i=first_epoch;i<num_epochs;i++){
+                if(options.reshuffle_epochs) FoldPlan::shuffle_indices(train_rows, CounterRNG(options.random_state, RNG_EPOCH_SHUFFLE, fold, i), options.shuffle_threads);
+                if(pipeline){
+                    pipeline->start(train_rows);
+                    while(BatchPipeline::Batch* batch = pipeline->next()){
+                        for(int j=0;j<batch->count;j++) net.train(batch->entries[j]);
+                        pipeline->release();
+                    }
+                }
+                else{
+                    for(long j=0;j<num_train;j++){
+                        if(j+PREFETCH_DISTANCE<num_train) data.prefetchEntry(train_rows[j+PREFETCH_DISTANCE]);
+                        net.train(data.getEntry(train_rows[j], scratch));
+                    }
+                }
+                if(options.checkpointer && (i+1)%options.checkpointer->get_every_epochs()==0 && i+1<num_epochs){
+                    checkpoint(fold, i+1, train_time+chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now()-start).count());
+                }
+            }
         }
         
         end = chrono::system_clock::now();
         elapsed = end - start;
         train_time += chrono::duration_cast<chrono::nanoseconds>(elapsed).count();
         
+        if(options.fold_trained) options.fold_trained(fold, net);
+        
         
         if(classification){
             
 	    vector<string> classlabels = data.getMeta().get_class_values();
             vector<tuple<string, string>> results;
-            for(long i=num_entries*fold/max_folds; i<num_entries*(fold+1)/max_folds;i++){
-                string predicted = net.classify(data.getData()[i], classlabels);
-                string actual = data.getData()[i].getClass();
+            for(const long* row=plan.test_begin(fold); row<plan.test_end(fold); row++){
+                Entry& e = data.getEntry(*row, scratch);
+                string predicted = net.classify(e, classlabels);
+                string actual = e.getClass();
                 results.push_back(make_tuple(actual,predicted));
             }
             
@@ -475,16 +1003,17 @@ map<string, double> Network::cross_validate(Dataset& data, Network& net, int num
         else{//if task is regression
             
             double mean_val = 0, total=0;
-            for(long i=num_entries*fold/max_folds;i<num_entries*(fold+1)/max_folds;i++){
-                mean_val+=data.getData()[i].expected[0];
+            for(const long* row=plan.test_begin(fold); row<plan.test_end(fold); row++){
+                mean_val+=data.getEntry(*row, scratch).expected[0];
                 total++;
             }
             mean_val/=total;
             
-            double mae=0, mse=0, rmse=0, ssr=0, ss=0, mape=0;
-            for(long i=num_entries*fold/max_folds;i<num_entries*(fold+1)/max_folds;i++){
-                double predicted = net.predict(data.getData()[i]);
-                double actual = stof(data.getData()[i].getClass());
+            double mae=0, mse=0, ssr=0, ss=0, mape=0;
+            for(const long* row=plan.test_begin(fold); row<plan.test_end(fold); row++){
+                Entry& e = data.getEntry(*row, scratch);
+                double predicted = net.predict(e);
+                double actual = stof(e.getClass());
                 cout<<actual<<" "<<predicted<<endl;
                 mae+=abs(actual-predicted);
                 mse+=pow(actual-predicted,2);
@@ -496,7 +1025,7 @@ map<string, double> Network::cross_validate(Dataset& data, Network& net, int num
             
             map<string, double> scores;
 
-	    int test_size = (int) num_entries/max_folds;
+	    int test_size = (int) plan.test_size(fold);
                         
             scores[MAE]=mae/test_size;
             scores[MSE]=mse/test_size;
@@ -511,7 +1040,10 @@ map<string, double> Network::cross_validate(Dataset& data, Network& net, int num
             
         }//end if task is regression
         
+        if(options.checkpointer) checkpoint(fold+1, 0, train_time);
+        
     }//end for every fold
+    if(options.checkpointer) options.checkpointer->wait();
     auto tot_end = chrono::system_clock::now();
     tot_time = chrono::duration_cast<chrono::nanoseconds>(tot_end-tot_start).count();
     tot_time/=1e9;//convert to seconds
@@ -520,6 +1052,11 @@ map<string, double> Network::cross_validate(Dataset& data, Network& net, int num
     train_time/=1e9;
     avgscores[TRAIN_TIME]=train_time;
     
+    if(pipeline){
+        avgscores[TRAINER_STALL_TIME]=pipeline->get_stats().trainer_wait_secs;
+        avgscores[LOADER_STALL_TIME]=pipeline->get_stats().loader_wait_secs;
+    }
+    
     return avgscores;
 }
 
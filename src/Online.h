@@ -0,0 +1,175 @@
+/*
+ * Filename: Online.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains an online trainer that appends new rows to a dataset and keeps training an existing MLP network on them.
+ */
+
+#ifndef Online_h
+#define Online_h
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <tuple>
+#include <cstring>
+#include <cmath>
+
+#include "Network.h"
+
+using namespace std;
+
+/*
+ * Rows are normalized once, with the transform in effect when they were appended, and never touched again.
+ * Every update merges the new rows into the running statistics, folds the change of transform into the first layer
+ * of the network so it keeps computing the same function, and normalizes the new rows with the new transform.
+ * Replayed old rows are mapped to the current transform on the fly, so an update costs O(new rows + replayed rows)
+ * no matter how much history there is.
+ */
+class OnlineTrainer{
+    
+private:
+    ARFFDataset& data;
+    MLPNetwork& net;
+    unsigned seed;
+    
+    //rows [segment_starts[s], segment_starts[s+1]) were normalized with segment_norms[s]
+    vector<long> segment_starts;
+    vector<NormalizationStats> segment_norms;
+    
+    //one hot block [start, end) of a categorical input and how often each of its values is set in the history
+    struct CategoricalCounts{
+        int start;
+        int end;
+        vector<long> counts;
+    };
+    vector<CategoricalCounts> categorical;
+    
+    Entry scratch;
+    
+    //counts the categorical values of a row that aren't missing
+    void count(const Entry& e){
+        for(CategoricalCounts& c : categorical){
+            for(int i=c.start;i<c.end;i++) if(e.data[i]==1) c.counts[i-c.start]++;
+        }
+    }
+    
+    //replaces the missing values of a normalized row the way ARFFDataset::replaceMissingValues does, with the statistics of
+    //the history including the row: numeric values become the mean (0 after normalizing) and categorical ones the mode
+    void impute(Entry& e){
+        for(int index : data.getNormalization().get_indices()) if(isnan(e.data[index])) e.data[index]=0;
+        for(CategoricalCounts& c : categorical){
+            if(!e.isMissing(c.start, c.end)) continue;
+            int mode = (int)(max_element(c.counts.begin(), c.counts.end())-c.counts.begin());
+            for(int i=c.start;i<c.end;i++) e.data[i]=0;
+            e.data[c.start+mode]=1;
+        }
+    }
+    
+    //trains on a row of the history under the current normalization
+    void train_row(long row){
+        net.train(getEntry(row, scratch));
+    }
+    
+public:
+    
+    //data must already be normalized (ARFFDataset::normalize) and net trained on it, or at least built for its metadata
+    OnlineTrainer(ARFFDataset& data, MLPNetwork& net, unsigned seed=420) : data(data), net(net), seed(seed),
+        scratch(data.getMeta().get_input_layer_size(), data.getMeta().get_output_layer_size()){
+        
+        bool has_numeric=false;
+        for(Attribute& a : data.getMeta().getAttributes()){
+            if(a.getType()==NUMERIC && a.getLabel()!=CLASSLABEL) has_numeric=true;
+        }
+        if(has_numeric && data.getNormalization().empty()){
+            cerr<<"Error. Normalize the dataset before creating an OnlineTrainer for it\n";
+            throw invalid_argument("dataset has no normalization statistics\n");
+        }
+        if(net.get_input_size()!=data.getMeta().get_input_layer_size() || net.get_output_size()!=data.getMeta().get_output_layer_size()){
+            cerr<<"Error. Network layout does not match the dataset given to OnlineTrainer\n";
+            throw invalid_argument("invalid network architecture\n");
+        }
+        
+        segment_starts.push_back(0);
+        segment_norms.push_back(data.getNormalization());
+        
+        ARFFMetaData& meta = data.getMeta();
+        for(Attribute& a : meta.getAttributes()){
+            if(a.getType()!=CATEGORICAL || a.getLabel()==CLASSLABEL) continue;
+            tuple<int, int> range = meta.calcCategoricalIndexRange(a.getLabel());
+            categorical.push_back({get<0>(range), get<1>(range), vector<long>(get<1>(range)-get<0>(range), 0)});
+        }
+        for(Entry& e : data.getData()) count(e);
+    }
+    
+    //row of the history mapped to the current normalization, rows appended under an older one are copied into scratch
+    Entry& getEntry(long row, Entry& scratch){
+        int s = (int)(upper_bound(segment_starts.begin(), segment_starts.end(), row)-segment_starts.begin())-1;
+        Entry& e = data.getData()[row];
+        if(s==(int)segment_starts.size()-1) return e;
+        memcpy(scratch.data, e.data, sizeof(double)*e.get_data_size());
+        memcpy(scratch.expected, e.expected, sizeof(double)*e.get_expected_size());
+        data.getNormalization().reapply(scratch.data, segment_norms[s]);
+        return scratch;
+    }
+    
+    //appends new_rows (encoded with the dataset's metadata but not normalized, they are moved into the dataset)
+    //and continues training for num_epochs over the new rows plus replay_ratio times as many randomly picked old rows
+    void update(vector<Entry>& new_rows, int num_epochs, double replay_ratio=0){
+        
+        long old_size = data.getSize();
+        NormalizationStats& norm = data.getNormalization();
+        NormalizationStats old_norm = norm;
+        
+        //update the running statistics and move the network onto the new transform
+        for(Entry& e : new_rows){
+            norm.add(e.data);
+            count(e);
+        }
+        norm.update_transform();
+        
+        vector<double> scale(norm.size()), shift(norm.size());
+        for(int i=0;i<norm.size();i++){
+            scale[i] = old_norm.get_scale()[i]/norm.get_scale()[i];
+            shift[i] = (old_norm.get_shift()[i]-norm.get_shift()[i])/norm.get_scale()[i];
+        }
+        net.transform_inputs(norm.get_indices(), scale, shift);
+        
+        //normalize, impute and append the new rows
+        for(Entry& e : new_rows){
+            norm.apply(e.data);
+            impute(e);
+            data.getData().push_back(move(e));
+        }
+        new_rows.clear();
+        segment_starts.push_back(old_size);
+        segment_norms.push_back(norm);
+        
+        //new rows plus the replay sample, reshuffled every epoch, update u draws from stream u of the replay purposes
+        uint32_t u = (uint32_t)segment_starts.size();
+        vector<long> rows;
+        for(long i=old_size;i<data.getSize();i++) rows.push_back(i);
+        long num_replay = min(old_size, (long)(replay_ratio*rows.size()));
+        CounterRNG pick(seed, RNG_REPLAY_SAMPLE, u);
+        for(long i=0;i<num_replay;i++) rows.push_back((long)pick.below(i, old_size));
+        
+        for(int epoch=0;epoch<num_epochs;epoch++){
+            FoldPlan::shuffle_indices(rows, CounterRNG(seed, RNG_REPLAY_SHUFFLE, u, epoch));
+            for(long row : rows) train_row(row);
+        }
+    }
+    
+    //same as above with the rows of a dataset loaded from a file with the same header
+    void update(ARFFDataset& delta, int num_epochs, double replay_ratio=0){
+        if(delta.getMeta().get_input_layer_size()!=data.getMeta().get_input_layer_size()){
+            cerr<<"Error. New rows were encoded with a different header than the dataset\n";
+            throw invalid_argument("mismatched dataset header\n");
+        }
+        update(delta.getData(), num_epochs, replay_ratio);
+    }
+    
+};
+
+#endif /* Online_h */
@@ -0,0 +1,227 @@
+/*
+ * Filename: Pipeline.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a producer/consumer stage that assembles training batches on loader threads ahead of the trainer.
+ */
+
+#ifndef Pipeline_h
+#define Pipeline_h
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "Dataset.h"
+#include "Folds.h"
+
+using namespace std;
+
+//time the trainer spent waiting on data and the loaders spent waiting on the trainer
+//a run where the trainer stalls is input bound, one where the loaders stall is compute bound
+struct PipelineStats{
+    long batches;
+    long trainer_stalls;
+    double trainer_wait_secs;
+    long loader_stalls;
+    double loader_wait_secs;
+
+    PipelineStats(){
+        batches=0;
+        trainer_stalls=0;
+        trainer_wait_secs=0;
+        loader_stalls=0;
+        loader_wait_secs=0;
+    }
+
+    void add(const PipelineStats& other){
+        batches+=other.batches;
+        trainer_stalls+=other.trainer_stalls;
+        trainer_wait_secs+=other.trainer_wait_secs;
+        loader_stalls+=other.loader_stalls;
+        loader_wait_secs+=other.loader_wait_secs;
+    }
+
+    bool input_bound() const {return trainer_wait_secs>loader_wait_secs;}
+
+    void print(ostream& os) const {
+        os<<"batches "<<batches<<" trainer stalls "<<trainer_stalls<<" ("<<trainer_wait_secs<<"s) loader stalls "
+          <<loader_stalls<<" ("<<loader_wait_secs<<"s) "<<(input_bound() ? "input bound" : "compute bound")<<endl;
+    }
+};
+
+/*
+ * Every loader thread owns a single producer single consumer ring of depth batches. Loader k fills batches k, k+L, k+2L, ...
+ * of the epoch and the trainer drains the rings round robin, so batches arrive in epoch order no matter how many loaders run.
+ * A batch is a set of preallocated aligned entries that rows are copied (or decoded) into, so the trainer reads a batch
+ * from contiguous freshly written memory instead of chasing permuted rows across the dataset.
+ */
+class BatchPipeline{
+
+public:
+
+    struct Batch{
+        vector<Entry> entries;
+        int count;
+    };
+
+private:
+
+    //head and tail sit on their own cache lines so the loader and the trainer don't invalidate each other's line
+    struct Ring{
+        vector<Batch> slots;
+        char pad0[64];
+        atomic<long> head; //batches written by the loader
+        char pad1[64];
+        atomic<long> tail; //batches released by the trainer
+        char pad2[64];
+        double wait_secs;  //loader side stall time, only touched by the loader
+        long stalls;
+    };
+
+    Dataset& data;
+    int batch_size;
+    int depth;
+    int num_loaders;
+
+    vector<Ring> rings;
+    vector<thread> loaders;
+    atomic<bool> stopping;
+
+    const long* rows;
+    long num_rows;
+    long num_batches;
+    long next_batch;
+
+    PipelineStats stats;
+
+    //copies row into out, datasets that decode on the fly already wrote it there
+    static void gather(Dataset& data, long row, Entry& out){
+        Entry& e = data.getEntry(row, out);
+        if(&e==&out) return;
+        memcpy(out.data, e.data, sizeof(double)*out.get_data_size());
+        memcpy(out.expected, e.expected, sizeof(double)*out.get_expected_size());
+        out.setClass(e.getClass());
+    }
+
+    void load(int k){
+        Ring& ring = rings[k];
+        for(long b=k; b<num_batches; b+=num_loaders){
+            long slot = ring.head.load(memory_order_relaxed);
+            if(slot-ring.tail.load(memory_order_acquire)>=depth){
+                ring.stalls++;
+                auto start = chrono::steady_clock::now();
+                while(slot-ring.tail.load(memory_order_acquire)>=depth){
+                    if(stopping.load(memory_order_relaxed)) return;
+                    this_thread::yield();
+                }
+                ring.wait_secs += chrono::duration<double>(chrono::steady_clock::now()-start).count();
+            }
+
+            Batch& batch = ring.slots[slot%depth];
+            long first = b*batch_size;
+            batch.count = (int)min((long)batch_size, num_rows-first);
+            for(int i=0;i<batch.count;i++){
+                if(i+PREFETCH_DISTANCE<batch.count) data.prefetchEntry(rows[first+i+PREFETCH_DISTANCE]);
+                gather(data, rows[first+i], batch.entries[i]);
+            }
+            ring.head.store(slot+1, memory_order_release);
+        }
+    }
+
+    void join(){
+        stopping=true;
+        for(thread& t : loaders) t.join();
+        loaders.clear();
+        stopping=false;
+        for(Ring& ring : rings){
+            stats.loader_stalls+=ring.stalls;
+            stats.loader_wait_secs+=ring.wait_secs;
+        }
+    }
+
+public:
+
+    BatchPipeline(Dataset& data, int batch_size=64, int depth=4, int num_loaders=1) : data(data), rings(num_loaders){
+        if(batch_size<1 || depth<1 || num_loaders<1){
+            cerr<<"Error. BatchPipeline needs a positive batch size, depth and number of loaders\n";
+            throw invalid_argument("invalid pipeline size\n");
+        }
+        this->batch_size=batch_size;
+        this->depth=depth;
+        this->num_loaders=num_loaders;
+        stopping=false;
+        rows=NULL;
+        num_rows=0;
+        num_batches=0;
+        next_batch=0;
+
+        int in_size = data.getMeta().get_input_layer_size(), out_size = data.getMeta().get_output_layer_size();
+        for(Ring& ring : rings){
+            ring.slots = vector<Batch>(depth);
+            for(Batch& batch : ring.slots){
+                batch.entries.reserve(batch_size);
+                for(int i=0;i<batch_size;i++) batch.entries.emplace_back(in_size, out_size);
+                batch.count=0;
+            }
+        }
+    }
+
+    BatchPipeline(const BatchPipeline&) = delete;
+    BatchPipeline& operator=(const BatchPipeline&) = delete;
+
+    //starts the loaders on one pass over rows, which must stay unchanged until next() returns NULL
+    void start(const vector<long>& rows){
+        if(!loaders.empty()) join();
+        this->rows = rows.data();
+        num_rows = (long)rows.size();
+        num_batches = (num_rows+batch_size-1)/batch_size;
+        next_batch = 0;
+        for(Ring& ring : rings){
+            ring.head=0;
+            ring.tail=0;
+            ring.wait_secs=0;
+            ring.stalls=0;
+        }
+        for(int k=0;k<num_loaders;k++) loaders.emplace_back(&BatchPipeline::load, this, k);
+    }
+
+    //the next batch of the pass in order, NULL once every batch has been handed out
+    //the batch stays valid until release() is called, which has to happen before the next call to next()
+    Batch* next(){
+        if(next_batch>=num_batches){
+            if(!loaders.empty()) join();
+            return NULL;
+        }
+        Ring& ring = rings[next_batch%num_loaders];
+        long slot = ring.tail.load(memory_order_relaxed);
+        if(ring.head.load(memory_order_acquire)<=slot){
+            stats.trainer_stalls++;
+            auto start = chrono::steady_clock::now();
+            while(ring.head.load(memory_order_acquire)<=slot) this_thread::yield();
+            stats.trainer_wait_secs += chrono::duration<double>(chrono::steady_clock::now()-start).count();
+        }
+        return &ring.slots[slot%depth];
+    }
+
+    //hands the batch returned by next() back to its loader
+    void release(){
+        Ring& ring = rings[next_batch%num_loaders];
+        ring.tail.store(ring.tail.load(memory_order_relaxed)+1, memory_order_release);
+        next_batch++;
+        stats.batches++;
+    }
+
+    const PipelineStats& get_stats() const {return stats;}
+
+    ~BatchPipeline(){
+        if(!loaders.empty()) join();
+    }
+};
+
+#endif /* Pipeline_h */
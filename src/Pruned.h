@@ -0,0 +1,379 @@
+/*
+ * Filename: Pruned.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a magnitude pruning pass for a trained MLPNetwork and a block sparse inference model
+ * that only multiplies the weights that survived it.
+ */
+
+#ifndef Pruned_h
+#define Pruned_h
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Network.h"
+
+using namespace std;
+
+//masks[i][k] is 1 if weight k of connection i was kept
+typedef vector<vector<uint8_t>> PruneMask;
+
+class Pruner{
+
+private:
+
+    static void check_block(int block_rows, int block_cols){
+        if(block_rows<1 || block_cols<1){
+            cerr<<"Error. Pruning blocks must be at least 1x1\n";
+            throw invalid_argument("invalid pruning block\n");
+        }
+    }
+
+public:
+
+    /*
+     * Zeroes the smallest magnitude weights of every connection until a fraction sparsity of them is zero. With a block
+     * larger than 1x1 whole block_rows x block_cols tiles are pruned, ranked by the sum of their magnitudes, which is what
+     * a BlockSparseMatrix with the same block can skip. Biases are left alone. Returns the mask of the kept weights.
+     */
+    static PruneMask prune(MLPNetwork& net, double sparsity, int block_rows=1, int block_cols=1){
+        check_block(block_rows, block_cols);
+        sparsity = max(0.0, min(1.0, sparsity));
+        PruneMask masks;
+        for(int i=0;i<net.get_num_layers()-1;i++){
+            int rows = net.get_sizes().at(i+1), cols = net.get_sizes().at(i);
+            int block_grid_rows = (rows+block_rows-1)/block_rows, block_grid_cols = (cols+block_cols-1)/block_cols;
+            long num_blocks = (long)block_grid_rows*block_grid_cols;
+            double* w = net.get_weights(i);
+
+            vector<double> magnitude(num_blocks, 0);
+            for(int j=0;j<rows;j++){
+                for(int k=0;k<cols;k++) magnitude[(long)(j/block_rows)*block_grid_cols+k/block_cols] += fabs(w[(long)j*cols+k]);
+            }
+
+            //the num_pruned blocks with the smallest magnitude, ties broken by position so the result is deterministic
+            long num_pruned = (long)llround(sparsity*num_blocks);
+            vector<long> order(num_blocks);
+            for(long b=0;b<num_blocks;b++) order[b]=b;
+            if(num_pruned>0 && num_pruned<num_blocks){
+                nth_element(order.begin(), order.begin()+num_pruned, order.end(), [&magnitude](long a, long b){
+                    return magnitude[a]<magnitude[b] || (magnitude[a]==magnitude[b] && a<b);
+                });
+            }
+            vector<uint8_t> keep_block(num_blocks, 1);
+            for(long b=0;b<num_pruned;b++) keep_block[order[b]]=0;
+
+            vector<uint8_t> mask((long)rows*cols);
+            for(int j=0;j<rows;j++){
+                for(int k=0;k<cols;k++){
+                    long index = (long)j*cols+k;
+                    mask[index] = keep_block[(long)(j/block_rows)*block_grid_cols+k/block_cols];
+                    if(!mask[index]) w[index]=0;
+                }
+            }
+            masks.push_back(mask);
+        }
+        return masks;
+    }
+
+    //zeroes every weight outside masks
+    static void apply(MLPNetwork& net, const PruneMask& masks){
+        for(int i=0;i<net.get_num_layers()-1;i++){
+            double* w = net.get_weights(i);
+            const uint8_t* m = masks.at(i).data();
+            long n = (long)masks[i].size();
+            for(long k=0;k<n;k++) w[k] = m[k] ? w[k] : 0;
+        }
+    }
+
+    //retrains the kept weights on the first num_rows rows of data (every row if num_rows<0), pruned weights stay zero
+    static void fine_tune(MLPNetwork& net, Dataset& data, const PruneMask& masks, int num_epochs, long num_rows=-1){
+        if(num_rows<0 || num_rows>data.getSize()) num_rows = data.getSize();
+        Entry scratch(data.getMeta().get_input_layer_size(), data.getMeta().get_output_layer_size());
+        for(int epoch=0;epoch<num_epochs;epoch++){
+            for(long r=0;r<num_rows;r++){
+                net.train(data.getEntry(r, scratch));
+                apply(net, masks);
+            }
+        }
+    }
+
+    //fraction of the weights of connection i that are zero
+    static double sparsity(const MLPNetwork& net, int i){
+        long n = (long)net.get_sizes().at(i)*net.get_sizes().at(i+1), zeros=0;
+        const double* w = net.get_weights(i);
+        for(long k=0;k<n;k++) zeros += w[k]==0;
+        return (double)zeros/n;
+    }
+};
+
+/*
+ * Block compressed sparse rows: the matrix is cut into block_rows x block_cols tiles and only tiles holding a nonzero
+ * are stored, densely and row major, with the block column of every tile. Tiles of block row b are
+ * [block_row_starts[b], block_row_starts[b+1]). Block sizes of 1, 2, 4 and 8 get their own unrolled kernel.
+ * The kernels read the input padded to a whole number of block columns and write the output padded to a whole
+ * number of block rows, SparseMLP keeps every layer padded to a multiple of SPARSE_PAD for that.
+ */
+class BlockSparseMatrix{
+
+private:
+    int rows;
+    int cols;
+    int block_rows;
+    int block_cols;
+    vector<int> block_row_starts;
+    vector<int> block_col_index;
+    double* values;
+
+    typedef void (*Kernel)(const BlockSparseMatrix& A, const double* X, long ldx, int n, double* Y, long ldy);
+    Kernel kernel;
+
+    //Y[s] += A X[s] for S rows s of X and Y at once, the S x R sums of a block row stay in registers
+    template<int R, int C, int S>
+    static void spmm_rows(const BlockSparseMatrix& A, const double* X, long ldx, double* Y, long ldy){
+        int num_block_rows = (int)A.block_row_starts.size()-1;
+        for(int br=0;br<num_block_rows;br++){
+            double acc[S][R] = {};
+            for(int t=A.block_row_starts[br];t<A.block_row_starts[br+1];t++){
+                const double* b = A.values+(long)t*R*C;
+                const double* x = X+(long)A.block_col_index[t]*C;
+                for(int s=0;s<S;s++){
+                    for(int r=0;r<R;r++){
+                        for(int c=0;c<C;c++) acc[s][r]+=b[r*C+c]*x[s*ldx+c];
+                    }
+                }
+            }
+            for(int s=0;s<S;s++){
+                for(int r=0;r<R;r++) Y[s*ldy+(long)br*R+r]+=acc[s][r];
+            }
+        }
+    }
+
+    //four rows at a time so every tile is loaded once per four rows, then the rest one by one
+    template<int R, int C>
+    static void spmm_kernel(const BlockSparseMatrix& A, const double* X, long ldx, int n, double* Y, long ldy){
+        int s=0;
+        for(;s+4<=n;s+=4) spmm_rows<R,C,4>(A, X+s*ldx, ldx, Y+s*ldy, ldy);
+        for(;s<n;s++) spmm_rows<R,C,1>(A, X+s*ldx, ldx, Y+s*ldy, ldy);
+    }
+
+    template<int R>
+    static Kernel kernel_for(int C){
+        switch(C){
+            case 1: return &spmm_kernel<R,1>;
+            case 2: return &spmm_kernel<R,2>;
+            case 4: return &spmm_kernel<R,4>;
+            case 8: return &spmm_kernel<R,8>;
+        }
+        return NULL;
+    }
+
+    static Kernel kernel_for(int R, int C){
+        switch(R){
+            case 1: return kernel_for<1>(C);
+            case 2: return kernel_for<2>(C);
+            case 4: return kernel_for<4>(C);
+            case 8: return kernel_for<8>(C);
+        }
+        return NULL;
+    }
+
+    BlockSparseMatrix(const BlockSparseMatrix&);
+    BlockSparseMatrix& operator=(const BlockSparseMatrix&);
+
+public:
+
+    //compresses the row major rows x cols matrix w
+    BlockSparseMatrix(const double* w, int rows, int cols, int block_rows=4, int block_cols=4){
+        kernel = kernel_for(block_rows, block_cols);
+        if(kernel==NULL){
+            cerr<<"Error. Block sparse blocks must be 1, 2, 4 or 8 rows by 1, 2, 4 or 8 columns\n";
+            throw invalid_argument("unsupported block size\n");
+        }
+        this->rows=rows;
+        this->cols=cols;
+        this->block_rows=block_rows;
+        this->block_cols=block_cols;
+
+        int grid_rows = (rows+block_rows-1)/block_rows, grid_cols = (cols+block_cols-1)/block_cols;
+        vector<double> tiles;
+        block_row_starts.push_back(0);
+        vector<double> tile(block_rows*block_cols);
+        for(int br=0;br<grid_rows;br++){
+            for(int bc=0;bc<grid_cols;bc++){
+                bool nonzero=false;
+                for(int r=0;r<block_rows;r++){
+                    for(int c=0;c<block_cols;c++){
+                        int j = br*block_rows+r, k = bc*block_cols+c;
+                        double v = (j<rows && k<cols) ? w[(long)j*cols+k] : 0;
+                        tile[r*block_cols+c]=v;
+                        nonzero = nonzero || v!=0;
+                    }
+                }
+                if(!nonzero) continue;
+                tiles.insert(tiles.end(), tile.begin(), tile.end());
+                block_col_index.push_back(bc);
+            }
+            block_row_starts.push_back((int)block_col_index.size());
+        }
+        values = (double*)Backend::aligned_malloc(sizeof(double)*max((size_t)1, tiles.size()), DATA_ALIGNMENT);
+        if(!tiles.empty()) memcpy(values, tiles.data(), sizeof(double)*tiles.size());
+    }
+
+    int get_rows() const {return rows;}
+    int get_cols() const {return cols;}
+    long get_num_blocks() const {return (long)block_col_index.size();}
+
+    //fraction of the matrix covered by stored tiles, the work of a multiply relative to dense
+    double get_density() const {return (double)get_num_blocks()*block_rows*block_cols/max(1L, (long)rows*cols);}
+
+    long get_bytes() const {
+        return get_num_blocks()*(block_rows*block_cols*sizeof(double)+sizeof(int)) + block_row_starts.size()*sizeof(int);
+    }
+
+    //y += A x
+    void spmv(const double* x, double* y) const {kernel(*this, x, 0, 1, y, 0);}
+
+    //Y[s] += A X[s] for the n rows of X (row length ldx) and Y (row length ldy)
+    void spmm(const double* X, long ldx, int n, double* Y, long ldy) const {kernel(*this, X, ldx, n, Y, ldy);}
+
+    ~BlockSparseMatrix(){
+        Backend::aligned_free(values);
+    }
+};
+
+/*
+ * Inference model of a pruned network: every connection is a BlockSparseMatrix, activations are kept in rows padded
+ * to a multiple of SPARSE_PAD so the kernels never need bounds checks. Padding inputs are zero on the first layer and
+ * activation(0) on hidden layers, which is harmless since the weights reading them are zero.
+ */
+class SparseMLP{
+
+private:
+    int num_layers;
+    vector<int> sizes;
+    vector<int> strides;
+    Network::ACTIVATION activation;
+    vector<BlockSparseMatrix*> weights;
+    vector<vector<double>> biases; //padded to the stride of the layer they belong to
+
+    static const int SPARSE_PAD = 8;
+
+    SparseMLP(const SparseMLP&);
+    SparseMLP& operator=(const SparseMLP&);
+
+public:
+
+    //scratch space for one scoring thread, padded activations for up to capacity rows
+    class Workspace{
+
+    private:
+        int capacity;
+        Workspace(const Workspace&);
+        Workspace& operator=(const Workspace&);
+
+    public:
+        double* buffers[2]; //ping-pong buffers for the input and output of the current layer
+
+        Workspace(const SparseMLP& net, int rows=1){
+            int widest = *max_element(net.strides.begin(), net.strides.end());
+            capacity=rows;
+            buffers[0] = (double*)Backend::aligned_malloc(sizeof(double)*rows*widest, DATA_ALIGNMENT);
+            buffers[1] = (double*)Backend::aligned_malloc(sizeof(double)*rows*widest, DATA_ALIGNMENT);
+        }
+
+        int get_capacity() const {return capacity;}
+
+        ~Workspace(){
+            Backend::aligned_free(buffers[0]);
+            Backend::aligned_free(buffers[1]);
+        }
+    };
+
+    //compresses the (pruned) weights of net into block_rows x block_cols tiles
+    SparseMLP(const MLPNetwork& net, int block_rows=4, int block_cols=4){
+        num_layers = net.get_num_layers();
+        sizes = net.get_sizes();
+        activation = net.get_activation();
+        for(int x : sizes) strides.push_back((x+SPARSE_PAD-1)/SPARSE_PAD*SPARSE_PAD);
+        for(int i=0;i<num_layers-1;i++){
+            weights.push_back(new BlockSparseMatrix(net.get_weights(i), sizes.at(i+1), sizes.at(i), block_rows, block_cols));
+            vector<double> b(strides.at(i+1), 0);
+            memcpy(b.data(), net.get_biases(i), sizeof(double)*sizes.at(i+1));
+            biases.push_back(b);
+        }
+    }
+
+    int get_input_size() const {return sizes.front();}
+    int get_output_size() const {return sizes.back();}
+
+    //stored tiles over all weights, the work of a forward pass relative to dense
+    double get_density() const {
+        double stored=0, total=0;
+        for(int i=0;i<num_layers-1;i++){
+            stored += weights[i]->get_density()*sizes.at(i)*sizes.at(i+1);
+            total += (double)sizes.at(i)*sizes.at(i+1);
+        }
+        return stored/total;
+    }
+
+    //bytes of tiles, indices and biases
+    long get_parameter_bytes() const {
+        long bytes=0;
+        for(int i=0;i<num_layers-1;i++) bytes += weights[i]->get_bytes() + sizeof(double)*sizes.at(i+1);
+        return bytes;
+    }
+
+    //same contract as MLPNetwork::forward_batch: num_rows contiguous inputs in, num_rows contiguous output layers out
+    void forward_batch(const double* inputs, int num_rows, double* outputs, Workspace& ws) const {
+
+        if(num_rows>ws.get_capacity()){
+            cerr<<"Error. Workspace holds "<<ws.get_capacity()<<" rows but forward_batch was given "<<num_rows<<endl;
+            throw invalid_argument("workspace too small for batch\n");
+        }
+
+        bool classification = sizes.back()>1;
+        for(int r=0;r<num_rows;r++){
+            double* x = ws.buffers[0]+(long)r*strides.at(0);
+            memcpy(x, inputs+(long)r*sizes.at(0), sizeof(double)*sizes.at(0));
+            for(int k=sizes.at(0);k<strides.at(0);k++) x[k]=0;
+        }
+
+        for(int i=0;i<num_layers-1;i++){
+            const double* in = ws.buffers[i%2];
+            double* out = ws.buffers[(i+1)%2];
+            long out_stride = strides.at(i+1);
+            for(int r=0;r<num_rows;r++) memcpy(out+r*out_stride, biases[i].data(), sizeof(double)*out_stride);
+            weights[i]->spmm(in, strides.at(i), num_rows, out, out_stride);
+            if(i<num_layers-2) MLPNetwork::apply_activation(activation, out, (int)(num_rows*out_stride));
+        }
+
+        const double* last = ws.buffers[(num_layers-1)%2];
+        for(int r=0;r<num_rows;r++){
+            double* o = outputs+(long)r*sizes.back();
+            memcpy(o, last+(long)r*strides.back(), sizeof(double)*sizes.back());
+            if(classification) MLPNetwork::softmax(o, sizes.back());
+        }
+    }
+
+    //index of the most probable class of one input vector
+    int classify_index(const double* input, Workspace& ws) const {
+        vector<double> out(sizes.back());
+        forward_batch(input, 1, out.data(), ws);
+        return (int)(max_element(out.begin(), out.end())-out.begin());
+    }
+
+    ~SparseMLP(){
+        for(BlockSparseMatrix* w : weights) delete w;
+    }
+};
+
+#endif /* Pruned_h */
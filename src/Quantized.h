@@ -0,0 +1,349 @@
+/*
+ * Filename: Quantized.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a post-training int8 quantization pass that turns a trained MLPNetwork into an integer inference model.
+ */
+
+#ifndef Quantized_h
+#define Quantized_h
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+#include <immintrin.h>
+#endif
+
+#include "Network.h"
+
+using namespace std;
+
+/*
+ * Weights are stored as int8 with one scale per row (per output neuron), activations entering every layer are
+ * quantized to int8 with one scale per layer calibrated on a sample of a dataset. Dot products accumulate in int32
+ * and only the bias, activation function and softmax run in floating point.
+ */
+class QuantizedMLP{
+
+private:
+    int num_layers;
+    vector<int> sizes;
+    vector<int> strides; //row length of every layer rounded up to QUANT_ALIGNMENT so rows stay aligned
+    Network::ACTIVATION activation;
+
+    vector<int8_t*> weights;
+    vector<vector<float>> weight_scales; //weight_scales[i][j] is the scale of row j of weights[i]
+    vector<vector<int32_t>> row_sums;    //row_sums[i][j] is the sum of the int8 values in row j of weights[i]
+    vector<vector<float>> biases;
+    vector<float> activation_scales;     //activation_scales[i] is the scale of the values entering weights[i]
+
+    //the activation functions are monotonic, so quantize(activation(z)) is the number of level boundaries z lies above
+    //thresholds[i] holds the pre-activation value of every boundary between int8 levels of the output of weights[i],
+    //padded with infinity to 256 entries for a branchless binary search
+    vector<vector<double>> thresholds;
+
+    static const int QUANT_ALIGNMENT = 64;
+
+    QuantizedMLP(const QuantizedMLP&);
+    QuantizedMLP& operator=(const QuantizedMLP&);
+
+    //activations are stored offset by 128 as unsigned bytes, which is what the u8 x s8 multiply-add instructions expect
+    //the offset is taken back out with 128*(sum of the weight row) after the dot product
+    static vector<long> all_rows(Dataset& data){
+        vector<long> rows(data.getSize());
+        for(long i=0;i<(long)rows.size();i++) rows[i]=i;
+        return rows;
+    }
+
+    static uint8_t quantize(double x, double inv_scale){
+        double q = x*inv_scale;
+        if(!(q==q)) return 128;
+        q = q>127 ? 127 : (q<-127 ? -127 : q);
+        return (uint8_t)(int)(q+128.5);
+    }
+
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+    //sum of the 16 lanes, spelled out because gcc warns about the undefined upper half inside _mm512_reduce_add_epi32
+    static int32_t reduce_add(__m512i v){
+        alignas(64) int32_t lanes[16];
+        _mm512_store_si512(lanes, v);
+        int32_t sum=0;
+        for(int i=0;i<16;i++) sum+=lanes[i];
+        return sum;
+    }
+
+    //dot products of one weight row against four activation rows, 64 multiply-adds per instruction
+    static void dot4(const int8_t* w, const uint8_t* x, long stride, int n, int32_t* out){
+        __m512i a0=_mm512_setzero_si512(), a1=a0, a2=a0, a3=a0;
+        for(int k=0;k<n;k+=64){
+            __m512i wv = _mm512_load_si512(w+k);
+            a0 = _mm512_dpbusd_epi32(a0, _mm512_load_si512(x+k), wv);
+            a1 = _mm512_dpbusd_epi32(a1, _mm512_load_si512(x+stride+k), wv);
+            a2 = _mm512_dpbusd_epi32(a2, _mm512_load_si512(x+2*stride+k), wv);
+            a3 = _mm512_dpbusd_epi32(a3, _mm512_load_si512(x+3*stride+k), wv);
+        }
+        out[0]=reduce_add(a0);
+        out[1]=reduce_add(a1);
+        out[2]=reduce_add(a2);
+        out[3]=reduce_add(a3);
+    }
+
+    static int32_t dot(const int8_t* w, const uint8_t* x, int n){
+        __m512i acc=_mm512_setzero_si512();
+        for(int k=0;k<n;k+=64) acc = _mm512_dpbusd_epi32(acc, _mm512_load_si512(x+k), _mm512_load_si512(w+k));
+        return reduce_add(acc);
+    }
+#else
+    //int8 dot products with int32 accumulators, written so the compiler turns them into widening multiply-adds
+    static void dot4(const int8_t* __restrict w, const uint8_t* __restrict x, long stride, int n, int32_t* out){
+        int32_t a0=0, a1=0, a2=0, a3=0;
+        for(int k=0;k<n;k++){
+            int32_t v = w[k];
+            a0 += v*x[k];
+            a1 += v*x[stride+k];
+            a2 += v*x[2*stride+k];
+            a3 += v*x[3*stride+k];
+        }
+        out[0]=a0;
+        out[1]=a1;
+        out[2]=a2;
+        out[3]=a3;
+    }
+
+    static int32_t dot(const int8_t* __restrict w, const uint8_t* __restrict x, int n){
+        int32_t acc=0;
+        for(int k=0;k<n;k++) acc += (int32_t)w[k]*x[k];
+        return acc;
+    }
+#endif
+
+    static double inverse_activation(Network::ACTIVATION activation, double y){
+        switch(activation){
+            case Network::LOGISTIC:
+                if(y<=0) return -INFINITY;
+                if(y>=1) return INFINITY;
+                return log(y/(1-y));
+            case Network::TANH:
+                if(y<=-1) return -INFINITY;
+                if(y>=1) return INFINITY;
+                return atanh(y);
+            case Network::RELU:
+                return y<=0 ? -INFINITY : y;
+        }
+        return y;
+    }
+
+    void build_thresholds(){
+        for(int i=0;i<num_layers-2;i++){
+            vector<double> t(256, INFINITY);
+            //the boundary between level L and L+1 is (L+0.5)*scale
+            for(int level=-127;level<127;level++) t[level+127] = inverse_activation(activation, (level+0.5)*activation_scales[i+1]);
+            thresholds.push_back(t);
+        }
+    }
+
+    uint8_t activate_quantized(int i, double z) const {
+        const double* t = thresholds[i].data();
+        int pos=0;
+        for(int step=128;step>0;step>>=1) pos += (z>=t[pos+step-1]) ? step : 0;
+        return (uint8_t)(pos+1);
+    }
+
+    //runs the double precision network over inputs and records the largest magnitude entering every layer
+    void calibrate(const MLPNetwork& net, const double* inputs, long num_rows){
+
+        vector<double> max_abs(num_layers-1, 0);
+        vector<double> a(*max_element(sizes.begin(), sizes.end())), b(a.size());
+        for(long r=0;r<num_rows;r++){
+            const double* in = inputs+r*sizes.at(0);
+            for(int i=0;i<num_layers-1;i++){
+                for(int k=0;k<sizes.at(i);k++) if(!isnan(in[k])) max_abs[i]=fmax(max_abs[i], fabs(in[k]));
+                if(i==num_layers-2) break;
+
+                double* out = (i%2==0) ? a.data() : b.data();
+                Backend::gemv(Backend::NoTrans, sizes.at(i+1), sizes.at(i), 1, net.get_weights(i), sizes.at(i), in, 0, out);
+                Backend::axpy(sizes.at(i+1), 1, net.get_biases(i), out);
+                net.activation_func(out, sizes.at(i+1));
+                in = out;
+            }
+        }
+        for(int i=0;i<num_layers-1;i++) activation_scales.push_back(max_abs[i]>0 ? (float)(max_abs[i]/127) : 1.0f);
+    }
+
+public:
+
+    //scratch space for one scoring thread, int8 activations padded to the layer strides
+    class Workspace{
+
+    private:
+        int capacity;
+        Workspace(const Workspace&);
+        Workspace& operator=(const Workspace&);
+
+    public:
+        uint8_t* quantized[2]; //ping-pong buffers for the int8 input of the current and the next layer
+
+        Workspace(const QuantizedMLP& net, int rows=1){
+            int widest = *max_element(net.strides.begin(), net.strides.end());
+            capacity=rows;
+            quantized[0] = (uint8_t*)Backend::aligned_malloc((size_t)rows*widest, QUANT_ALIGNMENT);
+            quantized[1] = (uint8_t*)Backend::aligned_malloc((size_t)rows*widest, QUANT_ALIGNMENT);
+        }
+
+        int get_capacity() const {return capacity;}
+
+        ~Workspace(){
+            Backend::aligned_free(quantized[0]);
+            Backend::aligned_free(quantized[1]);
+        }
+    };
+
+    //quantizes net, calibrating the activation scales on up to num_calibration_rows entries of data drawn at random with seed
+    //(files are often sorted by class, so the first rows can all be one class), any Dataset works, sparse rows are scattered
+    QuantizedMLP(const MLPNetwork& net, Dataset& data, long num_calibration_rows=1000, unsigned seed=420)
+        : QuantizedMLP(net, data, all_rows(data), num_calibration_rows, seed) {}
+
+    //same, drawing the calibration entries from the given rows of data only (e.g. the training rows)
+    QuantizedMLP(const MLPNetwork& net, Dataset& data, const vector<long>& rows, long num_calibration_rows=1000, unsigned seed=420){
+
+        num_layers = net.get_num_layers();
+        sizes = net.get_sizes();
+        activation = net.get_activation();
+        for(int x : sizes) strides.push_back((x+QUANT_ALIGNMENT-1)/QUANT_ALIGNMENT*QUANT_ALIGNMENT);
+
+        if(data.getMeta().get_input_layer_size()!=sizes.front()){
+            cerr<<"Error. Calibration data has "<<data.getMeta().get_input_layer_size()<<" inputs but the network expects "<<sizes.front()<<endl;
+            throw invalid_argument("calibration data does not match network\n");
+        }
+
+        long num_rows = min(num_calibration_rows, (long)rows.size());
+        vector<double> sample((size_t)num_rows*sizes.front());
+        CounterPermutation pick(CounterRNG(seed, RNG_CALIBRATION), rows.size());
+        Entry scratch(sizes.front(), sizes.back());
+        for(long r=0;r<num_rows;r++){
+            Entry& e = data.getEntry(rows[pick(r)], scratch);
+            double* row = &sample[r*sizes.front()];
+            if(e.isSparse()){
+                memset(row, 0, sizeof(double)*sizes.front());
+                for(int k=0;k<e.nnz;k++) row[e.sparse_indices[k]] = e.sparse_values[k];
+            }
+            else memcpy(row, e.data, sizeof(double)*sizes.front());
+        }
+        calibrate(net, sample.data(), num_rows);
+        build_thresholds();
+
+        for(int i=0;i<num_layers-1;i++){
+            int rows = sizes.at(i+1), cols = sizes.at(i);
+            const double* w = net.get_weights(i);
+
+            int8_t* q = (int8_t*)Backend::aligned_malloc((size_t)rows*strides.at(i), QUANT_ALIGNMENT);
+            memset(q, 0, (size_t)rows*strides.at(i));
+            vector<float> scales(rows);
+            vector<int32_t> sums(rows, 0);
+            for(int j=0;j<rows;j++){
+                double max_abs=0;
+                for(int k=0;k<cols;k++) max_abs=fmax(max_abs, fabs(w[(long)j*cols+k]));
+                scales[j] = max_abs>0 ? (float)(max_abs/127) : 1.0f;
+                for(int k=0;k<cols;k++){
+                    int8_t v = (int8_t)(quantize(w[(long)j*cols+k], 1/(double)scales[j])-128);
+                    q[(long)j*strides.at(i)+k] = v;
+                    sums[j] += v;
+                }
+            }
+            weights.push_back(q);
+            weight_scales.push_back(scales);
+            row_sums.push_back(sums);
+            biases.push_back(vector<float>(net.get_biases(i), net.get_biases(i)+rows));
+        }
+    }
+
+    int get_input_size() const {return sizes.front();}
+    int get_output_size() const {return sizes.back();}
+
+    //bytes of int8 weights, scales and biases
+    long get_parameter_bytes() const {
+        long bytes=0;
+        for(int i=0;i<num_layers-1;i++) bytes += (long)sizes.at(i+1)*strides.at(i) + sizeof(float)*2*sizes.at(i+1);
+        return bytes;
+    }
+
+    //same contract as MLPNetwork::forward_batch: num_rows contiguous inputs in, num_rows contiguous output layers out
+    void forward_batch(const double* inputs, int num_rows, double* outputs, Workspace& ws) const {
+
+        if(num_rows>ws.get_capacity()){
+            cerr<<"Error. Workspace holds "<<ws.get_capacity()<<" rows but forward_batch was given "<<num_rows<<endl;
+            throw invalid_argument("workspace too small for batch\n");
+        }
+
+        bool classification = sizes.back()>1;
+
+        //quantize the input rows into the padded int8 buffer
+        double inv_scale = 1/(double)activation_scales.at(0);
+        for(int r=0;r<num_rows;r++){
+            uint8_t* q = ws.quantized[0]+(long)r*strides.at(0);
+            for(int k=0;k<sizes.at(0);k++) q[k] = quantize(inputs[(long)r*sizes.at(0)+k], inv_scale);
+            memset(q+sizes.at(0), 128, strides.at(0)-sizes.at(0));
+        }
+
+        for(int i=0;i<num_layers-1;i++){
+            int rows = sizes.at(i+1);
+            long stride = strides.at(i), out_stride = strides.at(i+1);
+            bool last = i==num_layers-2;
+            const uint8_t* in = ws.quantized[i%2];
+            uint8_t* next = ws.quantized[(i+1)%2];
+
+            //hidden layers go straight from the pre-activation to the next layer's int8 input, the last layer is written out as doubles
+            auto emit = [&](long r, int j, double z){
+                if(last) outputs[r*rows+j] = z;
+                else next[r*out_stride+j] = activate_quantized(i, z);
+            };
+
+            //four activation rows at a time against every weight row, the layer's weights stay in cache between row blocks
+            //and every output row is written front to back
+            int r=0;
+            for(;r+4<=num_rows;r+=4){
+                for(int j=0;j<rows;j++){
+                    int32_t acc[4];
+                    dot4(weights[i]+j*stride, in+r*stride, stride, (int)stride, acc);
+                    double scale = (double)weight_scales[i][j]*activation_scales[i];
+                    int32_t offset = 128*row_sums[i][j];
+                    for(int t=0;t<4;t++) emit(r+t, j, (acc[t]-offset)*scale + biases[i][j]);
+                }
+            }
+            for(;r<num_rows;r++){
+                for(int j=0;j<rows;j++){
+                    double scale = (double)weight_scales[i][j]*activation_scales[i];
+                    emit(r, j, (dot(weights[i]+j*stride, in+r*stride, (int)stride)-128*row_sums[i][j])*scale + biases[i][j]);
+                }
+            }
+
+            if(!last){
+                for(int r=0;r<num_rows;r++) memset(next+r*out_stride+rows, 128, out_stride-rows);
+            }
+            else if(classification){
+                for(int r=0;r<num_rows;r++) MLPNetwork::softmax(outputs+(long)r*rows, rows);
+            }
+        }
+    }
+
+    //index of the most probable class of one input vector
+    int classify_index(const double* input, Workspace& ws) const {
+        vector<double> out(sizes.back());
+        forward_batch(input, 1, out.data(), ws);
+        return (int)(max_element(out.begin(), out.end())-out.begin());
+    }
+
+    ~QuantizedMLP(){
+        for(int8_t* w : weights) Backend::aligned_free(w);
+    }
+
+};
+
+#endif /* Quantized_h */
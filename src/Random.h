@@ -0,0 +1,157 @@
+/*
+ * Filename: Random.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a counter based random number generator (Philox4x32-10) keyed by a seed, a purpose and a
+ * stream id, and the random permutations built on it. Draw i of a stream is a pure function of (seed, purpose, stream, i), so
+ * weight init, shuffles and fold assignment can be split across any number of threads and still give the same result.
+ */
+
+#ifndef Random_h
+#define Random_h
+
+#include <cstdint>
+#include <cmath>
+#include <stdexcept>
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+//what the draws of a generator are for, half of its key, so draws for different purposes never share a block even when
+//their seeds, streams and indices coincide (e.g. the init of layer 0 and the fold assignment with the default seeds)
+enum RNG_PURPOSE {RNG_INIT=1, RNG_DATA_SHUFFLE, RNG_FOLDS, RNG_EPOCH_SHUFFLE, RNG_WORKER_SHUFFLE, RNG_REPLAY_SAMPLE, RNG_REPLAY_SHUFFLE,
+                  RNG_SYNTHETIC, RNG_CALIBRATION};
+
+//Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"), the key is (seed, purpose) and the counter is
+//(index, stream, substream), so every (stream, substream) pair is an independent sequence of 2^64 blocks of 128 bits
+class CounterRNG{
+
+private:
+    uint32_t key[2];
+    uint32_t stream[2];
+
+    static inline void mulhilo(uint32_t a, uint32_t b, uint32_t& hi, uint32_t& lo){
+        uint64_t p = (uint64_t)a*b;
+        hi = (uint32_t)(p>>32);
+        lo = (uint32_t)p;
+    }
+
+public:
+
+    CounterRNG(uint32_t seed, RNG_PURPOSE purpose, uint32_t stream_id=0, uint32_t substream=0){
+        key[0] = seed;
+        key[1] = (uint32_t)purpose;
+        stream[0] = stream_id;
+        stream[1] = substream;
+    }
+
+    //written to checkpoints, so a run is never resumed with orderings drawn by another generator
+    static const char* name(){return "philox4x32-10 (seed, purpose)";}
+
+    //the 128 bit block at counter (index, stream, substream)
+    void block(uint64_t index, uint32_t out[4]) const {
+        uint32_t c0 = (uint32_t)index, c1 = (uint32_t)(index>>32), c2 = stream[0], c3 = stream[1];
+        uint32_t k0 = key[0], k1 = key[1];
+        for(int r=0;r<10;r++){
+            uint32_t hi0, lo0, hi1, lo1;
+            mulhilo(0xD2511F53u, c0, hi0, lo0);
+            mulhilo(0xCD9E8D57u, c2, hi1, lo1);
+            c0 = hi1^c1^k0;
+            c1 = lo1;
+            c2 = hi0^c3^k1;
+            c3 = lo0;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        out[0]=c0; out[1]=c1; out[2]=c2; out[3]=c3;
+    }
+
+    uint64_t bits(uint64_t index) const {
+        uint32_t b[4];
+        block(index, b);
+        return ((uint64_t)b[1]<<32)|b[0];
+    }
+
+    //uniform in [0, 1) with 53 random bits
+    double uniform(uint64_t index) const {
+        return (bits(index)>>11)*(1.0/9007199254740992.0);
+    }
+
+    double uniform(uint64_t index, double lo, double hi) const {
+        return lo+(hi-lo)*uniform(index);
+    }
+
+    //uniform in [0, n), the modulo bias is below n/2^64
+    uint64_t below(uint64_t index, uint64_t n) const {
+        return bits(index)%n;
+    }
+
+    //standard normal by Box-Muller on the two halves of one block
+    double normal(uint64_t index) const {
+        uint32_t b[4];
+        block(index, b);
+        double u1 = ((((uint64_t)b[1]<<32)|b[0])>>11)*(1.0/9007199254740992.0);
+        double u2 = ((((uint64_t)b[3]<<32)|b[2])>>11)*(1.0/9007199254740992.0);
+        return sqrt(-2*log(1-u1))*cos(6.283185307179586*u2);
+    }
+};
+
+//random permutation of [0, n) as a bijection evaluated one index at a time: a balanced Feistel network over the smallest
+//even number of bits covering n with round keys drawn from rng, cycle walking back into [0, n)
+class CounterPermutation{
+
+private:
+    static const int ROUNDS=6;
+    uint64_t n;
+    int half_bits;
+    uint64_t half_mask;
+    uint64_t round_keys[ROUNDS];
+
+    //splitmix64 finalizer as the round function, keyed by xor
+    static inline uint64_t mix(uint64_t x){
+        x = (x^(x>>30))*0xBF58476D1CE4E5B9ull;
+        x = (x^(x>>27))*0x94D049BB133111EBull;
+        return x^(x>>31);
+    }
+
+    inline uint64_t encrypt(uint64_t x) const {
+        uint64_t left = x>>half_bits, right = x&half_mask;
+        for(int r=0;r<ROUNDS;r++){
+            uint64_t next = left^(mix(right^round_keys[r])&half_mask);
+            left = right;
+            right = next;
+        }
+        return (left<<half_bits)|right;
+    }
+
+public:
+
+    CounterPermutation(const CounterRNG& rng, uint64_t n) : n(n){
+        half_bits=1;
+        while(half_bits<32 && (1ull<<(2*half_bits))<n) half_bits++;
+        half_mask = (1ull<<half_bits)-1;
+        for(int r=0;r<ROUNDS;r++) round_keys[r]=rng.bits(r);
+    }
+
+    //the position of i after the permutation, the domain is at most 4n so cycle walking takes a few steps on average
+    //i has to be in [0, n): the walk only ends on the cycle of an index inside the range
+    uint64_t operator()(uint64_t i) const {
+        if(i>=n) throw out_of_range("permutation index out of range\n");
+        do i = encrypt(i); while(i>=n);
+        return i;
+    }
+
+    //out[i] = in[perm(i)] for i in [0, n), split across up to num_threads threads
+    template<class T>
+    void gather(const T* in, T* out, int num_threads=1) const {
+        auto fill = [this, in, out](long begin, long end){
+            for(long i=begin;i<end;i++) out[i]=in[(*this)(i)];
+        };
+        if(num_threads>1) ThreadPool::shared(num_threads).parallel_for((long)n, fill, 4096, num_threads);
+        else fill(0, (long)n);
+    }
+};
+
+#endif /* Random_h */
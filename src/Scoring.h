@@ -0,0 +1,477 @@
+/*
+ * Filename: Scoring.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains the preprocessing saved next to a trained model and a streaming batch scorer that runs
+ * ARFF or CSV rows of any size through it and the network in constant memory, with reading, scoring and writing overlapped.
+ */
+
+#ifndef Scoring_h
+#define Scoring_h
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <stdexcept>
+
+#include "Network.h"
+
+using namespace std;
+
+#define SCORING_MAGIC "FNNPREP1"
+
+/*
+ * Everything besides the network that turns a raw row into its input layer: the header the model was trained on (with
+ * its feature hashing) and the z-score transform of its numeric attributes. train.out saves it as model.bin.prep.
+ * The file is a few keyword lines followed by the ARFF header:
+ *   FNNPREP1
+ *   class <label>
+ *   hash <label> <buckets>          one per hashed attribute
+ *   norm <n> followed by n lines of <shift> <scale>, in the order of the numeric attributes
+ *   @relation ...
+ */
+class ScoringSpec{
+
+private:
+    string classlabel;
+    ARFFMetaData meta;
+    NormalizationStats norm;
+
+    //data index of every numeric input, the indices ARFFDataset::normalize uses
+    static vector<int> numeric_indices(ARFFMetaData& meta){
+        vector<int> indices;
+        for(Attribute& a : meta.getAttributes()){
+            if(a.getType()==NUMERIC && a.getLabel()!=meta.get_classlabel()) indices.push_back(meta.calcNumericDataIndex(a.getLabel()));
+        }
+        return indices;
+    }
+
+public:
+
+    ScoringSpec(){}
+
+    //the preprocessing of a loaded (and possibly normalized) dataset
+    ScoringSpec(ARFFDataset& data){
+        classlabel = data.get_classlabel();
+        meta = data.getMeta();
+        norm = data.getNormalization();
+    }
+
+    ARFFMetaData& getMeta() {return meta;}
+    const NormalizationStats& getNormalization() const {return norm;}
+
+    //the label of the class attribute, which has to be CLASS in the program that loads the spec
+    const string& get_classlabel() const {return classlabel;}
+
+    void save(ostream& os){
+        os<<SCORING_MAGIC<<"\n";
+        os<<"class "<<classlabel<<"\n";
+        for(Attribute& a : meta.getAttributes()) if(a.isHashed()) os<<"hash "<<a.getLabel()<<" "<<a.getHashBuckets()<<"\n";
+        os<<"norm "<<norm.size()<<"\n";
+        char line[64];
+        for(int i=0;i<norm.size();i++){
+            snprintf(line, sizeof(line), "%.17g %.17g\n", norm.get_shift()[i], norm.get_scale()[i]);
+            os<<line;
+        }
+        string header;
+        ARFFRowWriter::writeHeader(meta, header);
+        os<<header;
+    }
+
+    void save(const string& filename){
+        ofstream outFile(filename.c_str());
+        if(!outFile){
+            cerr<<"unable to open preprocessing file: "<<filename<<endl;
+            throw invalid_argument("unable to open preprocessing file\n");
+        }
+        save(outFile);
+    }
+
+    //the class label a spec was saved with, for programs that set CLASS at runtime before calling load
+    static string read_classlabel(const string& filename){
+        ifstream inFile(filename.c_str());
+        string word, label;
+        while(inFile>>word && word[0]!='@'){
+            if(word=="class"){
+                inFile>>label;
+                break;
+            }
+        }
+        return label;
+    }
+
+    //reads a spec written by save, CLASS has to evaluate to the class label it was saved with
+    void load(istream& is){
+        string word;
+        if(!(is>>word) || word!=SCORING_MAGIC){
+            cerr<<"Error. Not a preprocessing file\n";
+            throw invalid_argument("bad preprocessing file\n");
+        }
+        meta = ARFFMetaData();
+        vector<double> shift, scale;
+        while(is>>word && word[0]!='@'){
+            if(word=="class") is>>classlabel;
+            else if(word=="hash"){
+                string label;
+                int buckets;
+                is>>label>>buckets;
+                meta.setHashBuckets(label, buckets);
+            }
+            else if(word=="norm"){
+                int n;
+                is>>n;
+                shift.resize(n);
+                scale.resize(n);
+                for(int i=0;i<n;i++) is>>shift[i]>>scale[i];
+            }
+        }
+        if(!is || classlabel!=CLASSLABEL){
+            cerr<<"Error. Preprocessing file is truncated or its class label \""<<classlabel<<"\" isn't CLASS\n";
+            throw invalid_argument("bad preprocessing file\n");
+        }
+        //the header starts at the @relation just read
+        string rest;
+        getline(is, rest);
+        stringstream header("@relation "+rest+"\n"+string(istreambuf_iterator<char>(is), istreambuf_iterator<char>())+"\n");
+        ARFFDataset::readHeader(header, meta);
+
+        norm = NormalizationStats(numeric_indices(meta));
+        if(!shift.empty()) norm.set_transform(shift, scale);
+        else norm = NormalizationStats();
+    }
+
+    void load(const string& filename){
+        ifstream inFile(filename.c_str());
+        if(!inFile){
+            cerr<<"unable to open preprocessing file: "<<filename<<endl;
+            throw invalid_argument("unable to open preprocessing file\n");
+        }
+        load(inFile);
+    }
+};
+
+struct ScoringOptions{
+    int num_threads;        //scoring threads, 0 for every core
+    int batch_rows;         //rows per forward_batch
+    long chunk_bytes;       //input read per chunk, rows never straddle chunks
+    int chunks_in_flight;   //chunks being read, scored or written at once, bounds the memory
+    bool probabilities;     //write every class probability instead of the predicted label
+
+    ScoringOptions(){
+        num_threads=0;
+        batch_rows=256;
+        chunk_bytes=4<<20;
+        chunks_in_flight=0;
+        probabilities=false;
+    }
+};
+
+struct ScoringStats{
+    long rows;
+    long bytes_read;
+    long chunks;
+    double seconds;
+    double writer_wait_secs; //time the writer waited for the next chunk to be scored, low when reading or writing is the bottleneck
+
+    ScoringStats(){
+        rows=0;
+        bytes_read=0;
+        chunks=0;
+        seconds=0;
+        writer_wait_secs=0;
+    }
+
+    void print(ostream& os) const {
+        os<<"rows "<<rows<<" chunks "<<chunks<<" time "<<seconds<<"s ("<<rows/max(1e-9, seconds)<<" rows/s, "
+          <<bytes_read/max(1e-9, seconds)/(1<<20)<<" MB/s) writer waited "<<writer_wait_secs<<"s"<<endl;
+    }
+};
+
+/*
+ * Scores a stream of rows with a trained network. A reader thread cuts the input into chunks at line boundaries, every
+ * scoring thread takes whole chunks, encodes and normalizes their rows, scores them batch_rows at a time and formats the
+ * predictions, and the calling thread writes the chunks back in input order. Chunks come from a fixed pool, so the memory
+ * only depends on the chunk size and the number of threads. The input is ARFF (its header is skipped, the rows have to
+ * follow the attribute order of the model's header) or headerless CSV in the same order, with or without the class column.
+ * Every input row gives one output line: the predicted label, every class probability in header order (probabilities), or
+ * the predicted value for regression.
+ */
+class StreamScorer{
+
+private:
+    struct Chunk{
+        long seq;
+        string text;
+        string out;
+        long rows;
+    };
+
+    const MLPNetwork& net;
+    ScoringSpec& spec;
+    ScoringOptions options;
+    vector<string> classlabels;
+
+    //the pool and the three stages' queues, guarded by lock
+    mutex lock;
+    condition_variable changed;
+    vector<Chunk> pool;
+    deque<Chunk*> free_chunks;
+    deque<Chunk*> to_score;
+    map<long, Chunk*> scored;
+    bool reading_done;
+    long num_chunks;
+    string error;
+
+    static bool is_comment(const char* begin, const char* end){
+        while(begin<end && isspace(*begin)) begin++;
+        return begin==end || *begin=='%';
+    }
+
+    static int count_fields(const char* begin, const char* end){
+        int n=1;
+        for(const char* p=begin;p<end;p++) n += *p==DATA_DELIM;
+        return n;
+    }
+
+    Chunk* take(deque<Chunk*>& queue, bool wait_for_reader){
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [&]{return !queue.empty() || (wait_for_reader && reading_done) || !error.empty();});
+        if(queue.empty() || !error.empty()) return NULL;
+        Chunk* c = queue.front();
+        queue.pop_front();
+        return c;
+    }
+
+    void fail(const string& message){
+        lock_guard<mutex> guard(lock);
+        if(error.empty()) error = message.empty() ? "scoring failed" : message;
+        changed.notify_all();
+    }
+
+    //cuts the input into chunks of about chunk_bytes ending at a line boundary, skipping an ARFF header
+    void read(FILE* in, ScoringStats& stats){
+        string carry;
+        bool in_header=false, checked_header=false;
+        long seq=0;
+        vector<char> buffer(options.chunk_bytes);
+        while(true){
+            Chunk* c = take(free_chunks, false);
+            if(c==NULL) return;
+            c->text.swap(carry);
+            carry.clear();
+            bool eof=false;
+            //read until the chunk holds at least one whole line, a line longer than chunk_bytes grows the chunk
+            while(true){
+                size_t n = fread(buffer.data(), 1, buffer.size(), in);
+                stats.bytes_read += n;
+                c->text.append(buffer.data(), n);
+                if(n<buffer.size()){
+                    eof=true;
+                    break;
+                }
+                if(c->text.find('\n')!=string::npos) break;
+            }
+            if(!eof){
+                size_t last = c->text.rfind('\n');
+                carry.assign(c->text, last+1, string::npos);
+                c->text.resize(last+1);
+            }
+
+            //an ARFF header is everything up to the @data line
+            if(!checked_header || in_header){
+                size_t pos=0;
+                while(pos<c->text.size()){
+                    size_t end = c->text.find('\n', pos);
+                    if(end==string::npos) end = c->text.size();
+                    const char* b = c->text.data()+pos;
+                    const char* e = c->text.data()+end;
+                    if(!is_comment(b, e)){
+                        while(b<e && isspace(*b)) b++;
+                        if(!checked_header) in_header = *b=='@';
+                        checked_header=true;
+                        if(!in_header) break;
+                        if(e-b>=5 && strncasecmp(b, "@data", 5)==0){
+                            in_header=false;
+                            pos = end+1;
+                            break;
+                        }
+                    }
+                    pos = end+1;
+                }
+                c->text.erase(0, min(pos, c->text.size()));
+            }
+
+            c->seq = seq++;
+            {
+                lock_guard<mutex> guard(lock);
+                to_score.push_back(c);
+                if(eof){
+                    reading_done=true;
+                    num_chunks=seq;
+                }
+                changed.notify_all();
+            }
+            if(eof) return;
+        }
+    }
+
+    void score_chunks(){
+        ARFFMetaData& meta = spec.getMeta();
+        const NormalizationStats& norm = spec.getNormalization();
+        int in_size = net.get_input_size(), out_size = net.get_output_size();
+        int num_attributes = (int)meta.getAttributes().size();
+        bool classification = out_size>1;
+        int batch = options.batch_rows;
+
+        MLPNetwork::Workspace ws(net, batch);
+        vector<double> inputs((long)batch*in_size), outputs((long)batch*out_size);
+        Entry scratch(meta.calcEntryVectorLength(), meta.calcExpectedVectorLength());
+        //the encoders for rows with and without the class field, picked by the field count of each row
+        ARFFRowEncoder with_class(meta, ARFFRowEncoder::CLASS_IGNORED), without_class(meta, ARFFRowEncoder::CLASS_ABSENT);
+        char number[32];
+
+        while(Chunk* c = take(to_score, true)){
+            c->out.clear();
+            c->rows=0;
+            const char* p = c->text.data();
+            const char* text_end = p+c->text.size();
+            while(p<text_end){
+                //up to batch rows into inputs
+                int n=0;
+                while(p<text_end && n<batch){
+                    const char* line_end = (const char*)memchr(p, '\n', text_end-p);
+                    if(line_end==NULL) line_end = text_end;
+                    const char* begin = p;
+                    const char* end = line_end;
+                    p = line_end<text_end ? line_end+1 : text_end;
+                    if(!ARFFRowEncoder::trim(begin, end) || is_comment(begin, end)) continue;
+
+                    int fields = count_fields(begin, end);
+                    if(fields==num_attributes) with_class.encode(begin, end, scratch);
+                    else if(fields==num_attributes-1) without_class.encode(begin, end, scratch);
+                    else{
+                        fail("row with "+to_string(fields)+" fields, the model's header has "+to_string(num_attributes)+" attributes: "+string(begin, end));
+                        return;
+                    }
+                    //missing numeric values become the training mean, which is 0 after the z-score
+                    double* x = &inputs[(long)n*in_size];
+                    memcpy(x, scratch.data, sizeof(double)*in_size);
+                    if(!norm.empty()) norm.apply(x);
+                    for(int k=0;k<in_size;k++) if(isnan(x[k])) x[k]=0;
+                    n++;
+                }
+                if(n==0) continue;
+
+                net.forward_batch(inputs.data(), n, outputs.data(), ws);
+                for(int r=0;r<n;r++){
+                    const double* o = &outputs[(long)r*out_size];
+                    if(!classification) c->out.append(number, ARFFRowWriter::formatDouble(o[0], number)-number);
+                    else if(options.probabilities){
+                        for(int j=0;j<out_size;j++){
+                            if(j>0) c->out.push_back(DATA_DELIM);
+                            c->out.append(number, ARFFRowWriter::formatDouble(o[j], number)-number);
+                        }
+                    }
+                    else c->out.append(classlabels[max_element(o, o+out_size)-o]);
+                    c->out.push_back('\n');
+                }
+                c->rows+=n;
+            }
+
+            lock_guard<mutex> guard(lock);
+            scored[c->seq]=c;
+            changed.notify_all();
+        }
+    }
+
+public:
+
+    StreamScorer(const MLPNetwork& net, ScoringSpec& spec, const ScoringOptions& options=ScoringOptions()) : net(net), spec(spec){
+        this->options=options;
+        if(this->options.num_threads<=0) this->options.num_threads = max(1u, thread::hardware_concurrency());
+        if(this->options.chunks_in_flight<=0) this->options.chunks_in_flight = 2*this->options.num_threads+2;
+        this->options.batch_rows = max(1, this->options.batch_rows);
+        this->options.chunk_bytes = max(1L, this->options.chunk_bytes);
+        if(net.get_input_size()!=spec.getMeta().calcEntryVectorLength() || net.get_output_size()!=spec.getMeta().calcExpectedVectorLength()){
+            cerr<<"Error. The model has "<<net.get_input_size()<<" inputs and "<<net.get_output_size()<<" outputs but its preprocessing encodes "
+                <<spec.getMeta().calcEntryVectorLength()<<" and "<<spec.getMeta().calcExpectedVectorLength()<<endl;
+            throw invalid_argument("model and preprocessing don't match\n");
+        }
+        classlabels = spec.getMeta().get_class_values();
+    }
+
+    //scores every row of in and writes one line per row to out, neither is closed
+    ScoringStats score(FILE* in, FILE* out){
+        auto start = chrono::steady_clock::now();
+        ScoringStats stats;
+        pool = vector<Chunk>(options.chunks_in_flight);
+        free_chunks.clear();
+        to_score.clear();
+        scored.clear();
+        for(Chunk& c : pool) free_chunks.push_back(&c);
+        reading_done=false;
+        num_chunks=-1;
+        error.clear();
+
+        ScoringStats read_stats;
+        thread reader([&]{
+            try{ read(in, read_stats); }
+            catch(exception& e){ fail(e.what()); }
+        });
+        vector<thread> scorers;
+        for(int t=0;t<options.num_threads;t++){
+            scorers.push_back(thread([this]{
+                try{ score_chunks(); }
+                catch(exception& e){ fail(e.what()); }
+            }));
+        }
+
+        //writes the chunks in input order and hands them back to the reader
+        for(long next=0;;next++){
+            Chunk* c=NULL;
+            {
+                unique_lock<mutex> guard(lock);
+                auto wait_start = chrono::steady_clock::now();
+                changed.wait(guard, [&]{return scored.count(next) || (reading_done && next>=num_chunks) || !error.empty();});
+                stats.writer_wait_secs += chrono::duration<double>(chrono::steady_clock::now()-wait_start).count();
+                if(!error.empty() || !scored.count(next)) break;
+                c = scored[next];
+                scored.erase(next);
+            }
+            if(fwrite(c->out.data(), 1, c->out.size(), out)!=c->out.size()){
+                fail("write failed");
+                break;
+            }
+            stats.rows+=c->rows;
+            stats.chunks++;
+            lock_guard<mutex> guard(lock);
+            free_chunks.push_back(c);
+            changed.notify_all();
+        }
+        fflush(out);
+
+        reader.join();
+        for(thread& t : scorers) t.join();
+        if(!error.empty()){
+            cerr<<"Error. "<<error<<endl;
+            throw runtime_error("scoring failed\n");
+        }
+        stats.bytes_read = read_stats.bytes_read;
+        stats.seconds = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+        return stats;
+    }
+};
+
+#endif /* Scoring_h */
@@ -0,0 +1,188 @@
+/*
+ * Filename: Socket.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains the blocking socket helpers shared by the inference server and distributed training:
+ * full reads and writes, and listening on or connecting to a unix domain or TCP address.
+ */
+
+#ifndef Socket_h
+#define Socket_h
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <poll.h>
+#include <cerrno>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+using namespace std;
+
+static bool read_full(int fd, void* buf, size_t n){
+    char* p = (char*)buf;
+    while(n>0){
+        ssize_t r = read(fd, p, n);
+        if(r<=0) return false;
+        p+=r;
+        n-=r;
+    }
+    return true;
+}
+
+static bool write_full(int fd, const void* buf, size_t n){
+    const char* p = (const char*)buf;
+    while(n>0){
+        ssize_t w = write(fd, p, n);
+        if(w<=0) return false;
+        p+=w;
+        n-=w;
+    }
+    return true;
+}
+
+/*
+ * Addresses are "host:port" for TCP (an empty host listens on every interface) and anything else, optionally
+ * prefixed with "unix:", is the path of a unix domain socket. TCP sockets have Nagle's algorithm turned off,
+ * the protocols built on these send a request and wait for the answer.
+ */
+class SocketAddress{
+
+private:
+
+    static bool is_tcp(const string& address, string& host, string& port){
+        if(address.compare(0, 5, "unix:")==0 || address.find('/')!=string::npos) return false;
+        size_t colon = address.rfind(':');
+        if(colon==string::npos) return false;
+        host = address.substr(0, colon);
+        port = address.substr(colon+1);
+        return !port.empty() && port.find_first_not_of("0123456789")==string::npos;
+    }
+
+    static string unix_path(const string& address){
+        return address.compare(0, 5, "unix:")==0 ? address.substr(5) : address;
+    }
+
+    //fd of a unix socket with addr filled in for path
+    static int unix_socket(const string& path, sockaddr_un& addr){
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if(path.size()>=sizeof(addr.sun_path)){
+            cerr<<"Error. Socket path "<<path<<" is too long\n";
+            throw invalid_argument("invalid socket path\n");
+        }
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path)-1);
+        return socket(AF_UNIX, SOCK_STREAM, 0);
+    }
+
+    static addrinfo* resolve(const string& host, const string& port, bool passive){
+        addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        if(passive) hints.ai_flags = AI_PASSIVE;
+        addrinfo* info = NULL;
+        if(getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints, &info)!=0 || info==NULL){
+            cerr<<"Error. Unable to resolve "<<host<<":"<<port<<endl;
+            throw invalid_argument("unable to resolve address\n");
+        }
+        return info;
+    }
+
+    static void no_delay(int fd){
+        int one=1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+public:
+
+    //a listening socket for address, replaces a stale unix socket file
+    static int listen_on(const string& address, int backlog=128){
+        string host, port;
+        int fd;
+        bool ok;
+        if(is_tcp(address, host, port)){
+            addrinfo* info = resolve(host, port, true);
+            fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+            int one=1;
+            if(fd>=0) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            ok = fd>=0 && ::bind(fd, info->ai_addr, info->ai_addrlen)==0;
+            freeaddrinfo(info);
+        }
+        else{
+            sockaddr_un addr;
+            fd = unix_socket(unix_path(address), addr);
+            unlink(addr.sun_path);
+            ok = fd>=0 && ::bind(fd, (sockaddr*)&addr, sizeof(addr))==0;
+        }
+        if(!ok || listen(fd, backlog)<0){
+            if(fd>=0) close(fd);
+            cerr<<"Error. Unable to listen on "<<address<<endl;
+            throw runtime_error("unable to listen on socket\n");
+        }
+        return fd;
+    }
+
+    //accepts one connection on a socket from listen_on, -1 on failure or when nothing connects before the deadline
+    static int accept_on(int fd, chrono::steady_clock::time_point deadline=chrono::steady_clock::time_point::max()){
+        while(deadline!=chrono::steady_clock::time_point::max()){
+            long ms = chrono::duration_cast<chrono::milliseconds>(deadline-chrono::steady_clock::now()).count();
+            if(ms<=0){
+                errno=ETIMEDOUT;
+                return -1;
+            }
+            pollfd p = {fd, POLLIN, 0};
+            int ready = poll(&p, 1, (int)min(ms, 1000L));
+            if(ready>0) break;
+            if(ready<0 && errno!=EINTR) return -1;
+        }
+        int client = accept(fd, NULL, NULL);
+        if(client>=0){
+            sockaddr_storage addr;
+            socklen_t len = sizeof(addr);
+            if(getsockname(client, (sockaddr*)&addr, &len)==0 && addr.ss_family!=AF_UNIX) no_delay(client);
+        }
+        return client;
+    }
+
+    //connects to address, retrying for up to timeout_secs while nothing listens there yet
+    static int connect_to(const string& address, double timeout_secs=0){
+        string host, port;
+        bool tcp = is_tcp(address, host, port);
+        auto deadline = chrono::steady_clock::now()+chrono::duration<double>(timeout_secs);
+        while(true){
+            int fd;
+            bool ok;
+            if(tcp){
+                addrinfo* info = resolve(host.empty() ? "127.0.0.1" : host, port, false);
+                fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+                ok = fd>=0 && connect(fd, info->ai_addr, info->ai_addrlen)==0;
+                freeaddrinfo(info);
+                if(ok) no_delay(fd);
+            }
+            else{
+                sockaddr_un addr;
+                fd = unix_socket(unix_path(address), addr);
+                ok = fd>=0 && connect(fd, (sockaddr*)&addr, sizeof(addr))==0;
+            }
+            if(ok) return fd;
+            if(fd>=0) close(fd);
+            if(chrono::steady_clock::now()>=deadline){
+                cerr<<"Error. Unable to connect to "<<address<<endl;
+                throw runtime_error("unable to connect\n");
+            }
+            this_thread::sleep_for(chrono::milliseconds(20));
+        }
+    }
+};
+
+#endif /* Socket_h */
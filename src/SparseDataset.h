@@ -0,0 +1,409 @@
+/*
+ * Filename: SparseDataset.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains an in-memory ARFF dataset for sparse data that reads sparse ARFF rows and stores the
+ * "one hot encoded" inputs in compressed sparse row form.
+ */
+
+#ifndef SparseDataset_h
+#define SparseDataset_h
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+
+#include "Dataset.h"
+
+using namespace std;
+
+/*
+ * Row i's nonzero inputs are indices[row_starts[i], row_starts[i+1]) with the matching values, indices ascending.
+ * Rows are read in the sparse format {index value, ...} where index is the 0 based attribute and omitted attributes
+ * are 0, or a nominal attribute's first value, as the ARFF spec has it. Dense rows are accepted too.
+ * getEntry hands out a sparse view of the row (Entry::setSparse) that MLPNetwork trains on and scores directly,
+ * so memory, loading and the first layer all scale with the number of nonzeros instead of the input layer size.
+ */
+class SparseARFFDataset : public Dataset{
+
+private:
+
+    struct Column{
+        bool is_class;
+        bool numeric;
+        int data_index;                 //first index in the one hot encoded data array
+        int num_values;
+        int hash_buckets;
+        int first_slot;                 //slot of the first listed value, which omitted nominal attributes take
+        unordered_map<string, int> codes;
+    };
+
+    ARFFMetaData meta;
+    vector<Column> columns;             //every attribute in file order, the class included
+    vector<int> categorical;            //columns of the categorical inputs
+    int class_column;                   //-1 without a class attribute
+    int input_size;
+
+    vector<long> row_starts;
+    vector<int> indices;
+    vector<double> values;
+    vector<string> class_values;        //looked up once, the metadata searches every attribute for them
+    vector<int> class_codes;            //nominal class, -1 if missing
+    vector<double> targets;             //numeric class
+    vector<double> scales;              //per numeric column, set by normalize
+
+    static void trim(const char*& begin, const char*& end){
+        while(begin<end && isspace(*begin)) begin++;
+        while(end>begin && isspace(end[-1])) end--;
+    }
+
+    static double parseValue(const char* begin, const char* end){
+        if((size_t)(end-begin)==strlen(NUM_MISSING_VAL) && memcmp(begin, NUM_MISSING_VAL, end-begin)==0) return nan("");
+        string s(begin, end);
+        char* stop;
+        float val = strtof(s.c_str(), &stop);
+        if(stop==s.c_str()){
+            cerr<<"Error. Unable to read numeric value \""<<s<<"\"\n";
+            throw invalid_argument("invalid numeric value\n");
+        }
+        return val;
+    }
+
+    //first value of a one hot block set to 1, -1 if none is (a missing value)
+    static int activeSlot(const double* block, int num_values){
+        for(int v=0;v<num_values;v++) if(block[v]==1) return v;
+        return -1;
+    }
+
+    void endRow(){
+        row_starts.push_back((long)indices.size());
+    }
+
+    //parses the sparse row between the braces of [begin, end) and appends it
+    void addSparseLine(const char* begin, const char* end, vector<pair<int,double>>& row, vector<long>& seen){
+        long r = getSize();
+        row.clear();
+        int class_code = class_column>=0 && !columns[class_column].numeric ? 0 : -1;
+        double target = 0;
+
+        begin++;
+        if(end>begin && end[-1]=='}') end--;
+        while(begin<end){
+            const char* field_end = begin;
+            while(field_end<end && *field_end!=DATA_DELIM) field_end++;
+            const char* p = begin;
+            const char* q = field_end;
+            begin = field_end<end ? field_end+1 : end;
+            trim(p, q);
+            if(p==q) continue;
+
+            char* stop;
+            long attribute = strtol(p, &stop, 10);
+            if(stop==p || attribute<0 || attribute>=(long)columns.size()){
+                cerr<<"Error. Invalid attribute index in sparse row \""<<string(p, q)<<"\"\n";
+                throw invalid_argument("invalid sparse row\n");
+            }
+            p = stop;
+            trim(p, q);
+            const Column& c = columns[attribute];
+
+            if(c.numeric){
+                double x = parseValue(p, q);
+                if(c.is_class) target = x;
+                else if(x!=0) row.push_back(make_pair(c.data_index, x));
+                continue;
+            }
+            auto code = c.codes.find(string(p, q));
+            int slot = code==c.codes.end() ? -1 : code->second;
+            if(slot<0 && c.hash_buckets>0 && string(p, q)!=STR_MISSING_VAL) slot = Attribute::hashSlot(p, q-p, c.hash_buckets);
+            if(c.is_class) class_code = slot;
+            else{
+                seen[attribute] = r;
+                if(slot>=0) row.push_back(make_pair(c.data_index+slot, 1.0));
+            }
+        }
+
+        //omitted nominal attributes take their first value
+        for(int a : categorical) if(seen[a]!=r) row.push_back(make_pair(columns[a].data_index+columns[a].first_slot, 1.0));
+        sort(row.begin(), row.end());
+
+        for(const pair<int,double>& x : row){
+            indices.push_back(x.first);
+            values.push_back(x.second);
+        }
+        if(class_column>=0){
+            if(columns[class_column].numeric) targets.push_back(target);
+            else class_codes.push_back(class_code);
+        }
+        endRow();
+    }
+
+public:
+
+    SparseARFFDataset(){
+        class_column=-1;
+        input_size=0;
+        row_starts.push_back(0);
+    }
+
+    SparseARFFDataset(ARFFMetaData& meta) : SparseARFFDataset() {
+        setMeta(meta);
+    }
+
+    //copies the nonzeros of every entry of a dense dataset
+    SparseARFFDataset(ARFFDataset& data) : SparseARFFDataset() {
+        setMeta(data.getMeta());
+        for(Entry& e : data.getData()) addEntry(e);
+    }
+
+    void setMeta(ARFFMetaData& meta){
+        this->meta=meta;
+        columns.clear();
+        categorical.clear();
+        class_column=-1;
+        row_starts = vector<long>(1, 0);
+        indices.clear();
+        values.clear();
+        class_codes.clear();
+        targets.clear();
+        scales.clear();
+
+        int data_index=0;
+        for(Attribute& a : this->meta.getAttributes()){
+            Column c;
+            c.is_class = a.getLabel()==CLASSLABEL;
+            c.numeric = a.getType()==NUMERIC;
+            c.num_values = a.getEncodedSize();
+            c.hash_buckets = a.getHashBuckets();
+            if(!c.numeric) for(int v=0;v<(int)a.getValues().size();v++) c.codes[a.getValues()[v]] = a.isHashed() ? a.getSlot(a.getValues()[v]) : v;
+            c.first_slot = a.isHashed() && !a.getValues().empty() ? a.getSlot(a.getValues()[0]) : 0;
+            c.data_index = c.is_class ? 0 : data_index;
+            if(c.is_class){
+                class_column = (int)columns.size();
+                class_values = a.getValues();
+            }
+            else{
+                data_index += c.num_values;
+                if(!c.numeric) categorical.push_back((int)columns.size());
+            }
+            columns.push_back(c);
+        }
+        input_size = data_index;
+    }
+
+    ARFFMetaData& getMeta() override {return meta;}
+
+    long getSize() override {return (long)row_starts.size()-1;}
+
+    string get_classlabel() override {return meta.get_classlabel();}
+
+    //sparse datasets don't keep entries, use getEntry instead
+    vector<Entry>& getData() override {
+        cerr<<"Error. SparseARFFDataset does not store entries, use getEntry\n";
+        throw logic_error("sparse datasets have no entries\n");
+    }
+
+    //appends the nonzeros of e, which can be dense or a sparse view
+    void addEntry(Entry& e) override {
+        if(e.isSparse()){
+            indices.insert(indices.end(), e.sparse_indices, e.sparse_indices+e.nnz);
+            values.insert(values.end(), e.sparse_values, e.sparse_values+e.nnz);
+        }
+        else{
+            for(int i=0;i<e.get_data_size();i++){
+                if(e.data[i]!=0){
+                    indices.push_back(i);
+                    values.push_back(e.data[i]);
+                }
+            }
+        }
+        if(class_column>=0){
+            const Column& c = columns[class_column];
+            if(c.numeric) targets.push_back(e.expected[0]);
+            else class_codes.push_back(activeSlot(e.expected, c.num_values));
+        }
+        endRow();
+    }
+
+    long getNonzeros(long i) const {return row_starts[i+1]-row_starts[i];}
+    long getNonzeros() const {return (long)indices.size();}
+
+    //sets up scratch (sized for the dataset's metadata) as a sparse view of row i, only its expected array is written
+    Entry& getEntry(long i, Entry& scratch) override {
+        long start = row_starts[i];
+        scratch.setSparse(indices.data()+start, values.data()+start, (int)(row_starts[i+1]-start));
+        if(class_column>=0){
+            const Column& c = columns[class_column];
+            if(c.numeric) scratch.expected[0] = targets[i];
+            else{
+                for(int v=0;v<c.num_values;v++) scratch.expected[v]=0;
+                if(class_codes[i]>=0) scratch.expected[class_codes[i]]=1;
+            }
+        }
+        scratch.setClass(getEntryClass(i));
+        return scratch;
+    }
+
+    string getEntryClass(long i) override {
+        if(class_column<0) return "";
+        if(columns[class_column].numeric){
+            ostringstream os;
+            os<<(float)targets[i];
+            return os.str();
+        }
+        return class_codes[i]<0 ? "" : class_values.at(class_codes[i]);
+    }
+
+    void prefetchEntry(long i) override {
+        __builtin_prefetch(indices.data()+row_starts[i]);
+        __builtin_prefetch(values.data()+row_starts[i]);
+    }
+
+    //writes row i into a dense array of input layer size
+    void densify(long i, double* data) const {
+        for(int j=0;j<input_size;j++) data[j]=0;
+        for(long k=row_starts[i];k<row_starts[i+1];k++) data[indices[k]]=values[k];
+    }
+
+    //bytes used by the rows, compare with getSize()*(input+output layer size)*sizeof(double) for the dense layout
+    long getMemoryBytes() const {
+        return (long)(row_starts.capacity()*sizeof(long) + indices.capacity()*sizeof(int) + values.capacity()*sizeof(double)
+                      + class_codes.capacity()*sizeof(int) + targets.capacity()*sizeof(double));
+    }
+
+    //replace missing numeric values with the mean (implicit zeros included) and missing categorical values with the mode
+    void replaceMissingValues(){
+        int n = input_size;
+        vector<int> owner(n, -1); //column of every data index
+        for(int a=0;a<(int)columns.size();a++){
+            if(columns[a].is_class) continue;
+            for(int v=0;v<columns[a].num_values;v++) owner[columns[a].data_index+v]=a;
+        }
+
+        vector<double> sums(n, 0);
+        vector<long> present(n, 0);
+        for(long k=0;k<(long)indices.size();k++){
+            if(isnan(values[k])) continue;
+            sums[indices[k]]+=values[k];
+            present[indices[k]]++;
+        }
+        long rows = getSize();
+
+        vector<long> nans(columns.size(), 0);
+        for(long k=0;k<(long)indices.size();k++) if(isnan(values[k])) nans[owner[indices[k]]]++;
+
+        vector<int> new_indices;
+        vector<double> new_values;
+        vector<long> new_starts(1, 0);
+        vector<long> seen(columns.size(), -1);
+        new_indices.reserve(indices.size());
+        new_values.reserve(values.size());
+        vector<pair<int,double>> row;
+        for(long i=0;i<rows;i++){
+            row.clear();
+            for(long k=row_starts[i];k<row_starts[i+1];k++){
+                int a = owner[indices[k]];
+                seen[a]=i;
+                double x = values[k];
+                if(isnan(x)){
+                    x = sums[indices[k]]/max(1L, rows-nans[a]);
+                    if(x==0) continue;
+                }
+                row.push_back(make_pair(indices[k], x));
+            }
+            for(int a : categorical){
+                if(seen[a]==i) continue;
+                const Column& c = columns[a];
+                int mode = (int)(max_element(present.begin()+c.data_index, present.begin()+c.data_index+c.num_values)-present.begin());
+                row.push_back(make_pair(mode, 1.0));
+            }
+            sort(row.begin(), row.end());
+            for(const pair<int,double>& x : row){
+                new_indices.push_back(x.first);
+                new_values.push_back(x.second);
+            }
+            new_starts.push_back((long)new_indices.size());
+        }
+        indices.swap(new_indices);
+        values.swap(new_values);
+        row_starts.swap(new_starts);
+    }
+
+    //divides every numeric attribute by its standard deviation (implicit zeros included) without centering it
+    //centering would turn every zero into a nonzero, so unlike ARFFDataset::normalize this keeps the data sparse
+    void normalize(){
+        int n = input_size;
+        vector<double> sums(n, 0), squares(n, 0);
+        for(long k=0;k<(long)indices.size();k++){
+            if(isnan(values[k])) continue;
+            sums[indices[k]]+=values[k];
+            squares[indices[k]]+=values[k]*values[k];
+        }
+        long rows = max(1L, getSize());
+        vector<double> factor(n, 1);
+        scales.clear();
+        for(const Column& c : columns){
+            if(c.is_class || !c.numeric) continue;
+            double mean = sums[c.data_index]/rows;
+            double sd = sqrt(max(0.0, squares[c.data_index]/rows-mean*mean));
+            factor[c.data_index] = sd>0 ? 1/sd : 1;
+            scales.push_back(factor[c.data_index]);
+        }
+        for(long k=0;k<(long)indices.size();k++) values[k]*=factor[indices[k]];
+    }
+
+    //the factor every numeric attribute was multiplied by, in attribute order, empty before normalize
+    const vector<double>& getScales() const {return scales;}
+
+    //load an arff file with sparse or dense rows straight into compressed rows
+    static void loadARFF(string filename, SparseARFFDataset& data){
+        ifstream inFile;
+        inFile.open(filename.c_str());
+
+        if(!inFile) {
+            cerr<<"unable to open file: "<<filename<<endl;
+            return;
+        }
+
+        ARFFMetaData meta;
+        meta.setEncodingOptions(data.getMeta());
+        ARFFDataset::readHeader(inFile, meta);
+        data.setMeta(meta);
+
+        //dense rows are encoded like ARFFDataset does and then compressed
+        ARFFRowEncoder encoder(data.getMeta());
+        Entry e(encoder.get_data_length(), encoder.get_expected_length());
+
+        vector<pair<int,double>> row;
+        vector<long> seen(data.columns.size(), -1);
+        string line;
+        while(getline(inFile,line)){
+            const char* begin = line.data();
+            const char* end = begin+line.size();
+            if(!ARFFRowEncoder::trim(begin, end)) continue;
+            while(begin<end && isspace(*begin)) begin++;
+            if(begin==end) continue;
+            if(*begin=='{') data.addSparseLine(begin, end, row, seen);
+            else{
+                encoder.encode(begin, end, e);
+                data.addEntry(e);
+            }
+        }
+        data.row_starts.shrink_to_fit();
+        data.indices.shrink_to_fit();
+        data.values.shrink_to_fit();
+    }
+
+};
+
+#endif /* SparseDataset_h */
@@ -0,0 +1,173 @@
+/*
+ * Filename: ThreadPool.h
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a persistent thread pool that splits a single kernel call (one layer's matvec or
+ * rank one update) into contiguous ranges run side by side, used for intra-op parallelism on wide layers.
+ */
+
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
+
+//weights (rows*cols of a layer) from which a layer's kernels are split across the pool, about 1024x1024
+#ifndef INTRA_OP_THRESHOLD
+#define INTRA_OP_THRESHOLD (1L<<20)
+#endif
+
+using namespace std;
+
+/*
+ * Workers sleep on a condition variable between calls, so an idle pool costs nothing. parallel_for hands part 0 of the
+ * range to the calling thread and parts 1..n-1 to the workers and returns once all of them are done. Only one call
+ * runs on the pool at a time: a call made while the pool is busy (another thread, or nested) just runs sequentially.
+ */
+class ThreadPool{
+
+private:
+    vector<thread> workers;
+    mutex m;
+    condition_variable start_cv;
+    condition_variable done_cv;
+    mutex busy;
+    atomic<int> num_threads;    //workers+1, written under busy but read without it (shared, parallel_for)
+
+    //the running call's range function, type erased without allocating
+    const void* task;
+    void (*invoke)(const void* task, long begin, long end);
+    long task_size;
+    long grain;
+    int num_parts;
+    long generation;
+    int remaining;
+    bool stopping;
+
+    //part p of [0, n) split into num_parts ranges, boundaries are multiples of grain
+    void part(int p, long& begin, long& end) const {
+        long blocks = (task_size+grain-1)/grain;
+        begin = min(task_size, blocks*p/num_parts*grain);
+        end = min(task_size, blocks*(p+1)/num_parts*grain);
+    }
+
+    //seen is the generation current when the worker was started, so it never picks up a call made before
+    void work(int id, long seen){
+        unique_lock<mutex> lock(m);
+        while(true){
+            start_cv.wait(lock, [this, seen]{return stopping || generation!=seen;});
+            if(stopping) return;
+            seen = generation;
+            if(id+1>=num_parts) continue;
+            lock.unlock();
+
+            long begin, end;
+            part(id+1, begin, end);
+            if(begin<end) invoke(task, begin, end);
+
+            lock.lock();
+            if(--remaining==0) done_cv.notify_one();
+        }
+    }
+
+    void stop(){
+        {
+            lock_guard<mutex> lock(m);
+            stopping=true;
+        }
+        start_cv.notify_all();
+        for(thread& w : workers) w.join();
+        workers.clear();
+    }
+
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    //busy has to be held
+    void resize_locked(int num_threads){
+        if(num_threads<1) num_threads=max(1, (int)thread::hardware_concurrency());
+        if(num_threads==get_num_threads()) return;
+        stop();
+        stopping=false;
+        for(int i=0;i<num_threads-1;i++) workers.emplace_back(&ThreadPool::work, this, i, generation);
+        this->num_threads=num_threads;
+    }
+
+public:
+
+    //num_threads counts the calling thread, so num_threads-1 workers are started
+    ThreadPool(int num_threads=1){
+        task=NULL;
+        invoke=NULL;
+        task_size=0;
+        grain=1;
+        num_parts=1;
+        generation=0;
+        remaining=0;
+        stopping=false;
+        this->num_threads=1;
+        resize(num_threads);
+    }
+
+    int get_num_threads() const {return num_threads.load();}
+
+    void resize(int num_threads){
+        lock_guard<mutex> busy_lock(busy);
+        resize_locked(num_threads);
+    }
+
+    //resizes to num_threads if the pool has fewer, checked under the same lock so concurrent calls never shrink it
+    void grow(int num_threads){
+        lock_guard<mutex> busy_lock(busy);
+        if(num_threads>get_num_threads()) resize_locked(num_threads);
+    }
+
+    //runs f(begin, end) over up to max_parts contiguous ranges of [0, n) in parallel, range boundaries are multiples of grain
+    template<class F>
+    void parallel_for(long n, const F& f, long grain=1, int max_parts=0){
+        unique_lock<mutex> busy_lock(busy, try_to_lock);
+        int parts = max_parts>0 ? min(max_parts, get_num_threads()) : get_num_threads();
+        parts = (int)min((long)parts, (n+grain-1)/max(1L, grain));
+        if(!busy_lock.owns_lock() || parts<=1){
+            f(0, n);
+            return;
+        }
+
+        {
+            lock_guard<mutex> lock(m);
+            task=&f;
+            invoke=[](const void* task, long begin, long end){(*(const F*)task)(begin, end);};
+            task_size=n;
+            this->grain=max(1L, grain);
+            num_parts=parts;
+            remaining=parts-1;
+            generation++;
+        }
+        start_cv.notify_all();
+
+        long begin, end;
+        part(0, begin, end);
+        if(begin<end) f(begin, end);
+
+        unique_lock<mutex> lock(m);
+        done_cv.wait(lock, [this]{return remaining==0;});
+    }
+
+    //one pool for the whole process, grown to num_threads if it has fewer
+    static ThreadPool& shared(int num_threads=1){
+        static ThreadPool pool;
+        if(num_threads>pool.get_num_threads()) pool.grow(num_threads);
+        return pool;
+    }
+
+    ~ThreadPool(){
+        stop();
+    }
+};
+
+#endif /* ThreadPool_h */
@@ -15,6 +15,7 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <cstdint>
 
 using namespace std;
 
@@ -24,17 +25,29 @@ private:
     vector<string> values;
     string label;
     string type;
+    int hash_buckets; //0 for the one hot encoding
+    vector<int> slot_values; //index of the first listed value in every hash bucket, -1 if none falls in it
+    
+    //makes value v the one its bucket stands for unless an earlier value already is
+    void claimSlot(int v){
+        int& first = slot_values[getSlot(values[v])];
+        if(first<0) first=v;
+    }
     
 public:
     
-    Attribute(){}
+    Attribute(){hash_buckets=0;}
     
-    Attribute(string label){this->label=label;}
+    Attribute(string label){
+        this->label=label;
+        hash_buckets=0;
+    }
     
     Attribute(string label, string type){
         this->label=label;
         this->type=type;
         values = vector<string>();
+        hash_buckets=0;
     }
     
     string getLabel(){return label;}
@@ -45,17 +58,63 @@ public:
     
     void setLabel(string label){this->label=label;}
     
-    void addValue(string val){values.push_back(val);}
+    void addValue(string val){
+        values.push_back(val);
+        if(isHashed()) claimSlot((int)values.size()-1);
+    }
     
     vector<string>& getValues(){return values;}
     
+    //categorical values are hashed into a fixed number of buckets instead of getting a slot each, 0 goes back to one hot
+    //the bucket of every listed value is looked up here once, so getSlotValue doesn't hash them again
+    void setHashBuckets(int buckets){
+        hash_buckets = buckets>0 ? buckets : 0;
+        slot_values.assign(hash_buckets, -1);
+        for(int v=0;v<(int)values.size() && isHashed();v++) claimSlot(v);
+    }
+    
+    int getHashBuckets() const {return hash_buckets;}
+    
+    bool isHashed() const {return hash_buckets>0;}
+    
+    //number of slots the attribute takes in the encoded input array
+    int getEncodedSize() const {
+        if(type==NUMERIC) return 1;
+        return isHashed() ? hash_buckets : (int)values.size();
+    }
+    
+    //64 bit FNV-1a of the value modulo buckets, the same on every platform so models and data stay compatible
+    static int hashSlot(const char* value, size_t length, int buckets){
+        uint64_t h = 14695981039346656037ULL;
+        for(size_t i=0;i<length;i++){
+            h ^= (unsigned char)value[i];
+            h *= 1099511628211ULL;
+        }
+        return (int)(h%(uint64_t)buckets);
+    }
+    
+    //slot of value within the attribute's block of the encoded input, -1 if it has none
+    //hashed attributes give any value (also ones the header doesn't list) a slot
+    int getSlot(const string& value) const {
+        if(isHashed()) return hashSlot(value.data(), value.size(), hash_buckets);
+        for(int i=0;i<(int)values.size();i++) if(values[i]==value) return i;
+        return -1;
+    }
+    
+    //the value a slot stands for, for hashed attributes the first listed value that falls in the bucket ("" if none does)
+    string getSlotValue(int slot) const {
+        if(!isHashed()) return values.at(slot);
+        int v = slot_values.at(slot);
+        return v<0 ? "" : values[v];
+    }
+    
     
     friend ostream& operator<<(ostream& os, const Attribute& obj){
         os<<"Label: "<<obj.label<<endl;
         os<<"Type: "<<obj.type<<endl;
         if(obj.type==CATEGORICAL){
             os<<"Values : {";
-            for(int i=0; i<obj.values.size()-1;i++){
+            for(int i=0; i<(int)obj.values.size()-1;i++){
                 os<<obj.values.at(i)<<", ";
                 
             }
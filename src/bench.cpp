@@ -0,0 +1,114 @@
+/*
+ * Filename: bench.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a benchmark of the compute backend the library was built with (make bench BACKEND=...),
+ * timing the raw kernels and an MLP's training and inference on a given topology so the backends can be compared.
+ */
+
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+
+#define CLASS "class"
+#include "Network.h"
+
+using namespace std;
+
+//fastest of a few runs of f, in seconds per call
+template<class F>
+double time_call(F f, int calls){
+    double best=1e30;
+    for(int rep=0;rep<5;rep++){
+        auto start = chrono::steady_clock::now();
+        for(int i=0;i<calls;i++) f();
+        best = min(best, chrono::duration<double>(chrono::steady_clock::now()-start).count()/calls);
+    }
+    return best;
+}
+
+void report(const string& name, double seconds, double flops){
+    cout<<"  "<<left<<setw(22)<<name<<right<<setw(12)<<seconds*1e6<<" us"<<setw(10)<<flops/seconds*1e-9<<" GFLOP/s"<<endl;
+}
+
+//usage: bench [layer sizes...], the default topology is 256 1024 1024 10
+int main(int argc, char** argv){
+
+    vector<int> sizes;
+    for(int i=1;i<argc;i++) sizes.push_back(atoi(argv[i]));
+    if(sizes.size()<2) sizes = {256, 1024, 1024, 10};
+    int batch_size = 64;
+    int calls = 20;
+
+    int widest=0;
+    for(int s : sizes) widest=max(widest, s);
+    mt19937 gen(420);
+    uniform_real_distribution<double> dist(-1, 1);
+    auto random_array = [&](long n){
+        double* a = (double*)Backend::aligned_malloc(sizeof(double)*n);
+        for(long i=0;i<n;i++) a[i]=dist(gen);
+        return a;
+    };
+
+    cout<<"backend "<<Backend::name()<<", topology";
+    for(int s : sizes) cout<<" "<<s;
+    cout<<", batch "<<batch_size<<endl;
+    cout<<fixed<<setprecision(2);
+
+    //the kernels on the widest layer shape
+    int m = widest, n = widest;
+    double* A = random_array((long)m*n);
+    double* X = random_array((long)batch_size*n);
+    double* Y = random_array((long)batch_size*m);
+    report("gemv", time_call([&]{Backend::gemv(Backend::NoTrans, m, n, 1, A, n, X, 0, Y);}, calls), 2.0*m*n);
+    report("gemv transposed", time_call([&]{Backend::gemv(Backend::Trans, m, n, 1, A, n, Y, 0, X);}, calls), 2.0*m*n);
+    report("ger", time_call([&]{Backend::ger(m, n, 1e-9, Y, X, A, n);}, calls), 2.0*m*n);
+    report("gemv^T then ger", time_call([&]{
+        Backend::gemv(Backend::Trans, m, n, 1, A, n, Y, 0, X);
+        Backend::ger(m, n, 1e-9, Y, X+n, A, n);
+    }, calls), 4.0*m*n);
+    report("fused gemv^T + ger", time_call([&]{Backend::gemv_trans_ger(m, n, 1e-9, Y, X, X+n, A, n);}, calls), 4.0*m*n);
+    report("gemm (batch x w^T)", time_call([&]{Backend::gemm(Backend::NoTrans, Backend::Trans, batch_size, m, n, 1, X, n, A, n, 0, Y, m);}, calls),
+           2.0*batch_size*m*n);
+    report("axpy", time_call([&]{Backend::axpy(n, 1e-9, X, Y);}, calls*100), 2.0*n);
+    report("tanh", time_call([&]{Backend::tanh(n, X, Y);}, calls*100), n);
+    Backend::aligned_free(A);
+    Backend::aligned_free(X);
+    Backend::aligned_free(Y);
+
+    //the network end to end, on random rows with random one hot targets
+    long weights=0;
+    for(size_t i=1;i<sizes.size();i++) weights+=(long)sizes[i-1]*sizes[i];
+    int in_size = sizes.front(), out_size = sizes.back();
+    int num_rows = 256;
+    vector<Entry> rows;
+    for(int i=0;i<num_rows;i++){
+        rows.emplace_back(in_size, out_size);
+        for(int j=0;j<in_size;j++) rows.back().data[j]=dist(gen);
+        for(int j=0;j<out_size;j++) rows.back().expected[j]=0;
+        rows.back().expected[i%out_size]=1;
+    }
+    double* inputs = random_array((long)num_rows*in_size);
+    vector<double> outputs((long)num_rows*out_size);
+
+    MLPNetwork net(sizes, 0.01, Network::TANH);
+    MLPNetwork::Workspace ws(net, batch_size);
+    report("train row", time_call([&]{for(Entry& e : rows) net.train(e);}, 1)/num_rows, 6.0*weights);
+    report("forward row", time_call([&]{for(int i=0;i<num_rows;i++) net.forward(inputs+(long)i*in_size, ws);}, 1)/num_rows, 2.0*weights);
+    report("forward batch row", time_call([&]{
+        for(int i=0;i<num_rows;i+=batch_size) net.forward_batch(inputs+(long)i*in_size, batch_size, &outputs[(long)i*out_size], ws);
+    }, 1)/num_rows, 2.0*weights);
+
+    //every backend trains the same network from the same rows, so this only differs by rounding between them
+    double checksum=0;
+    for(size_t i=0;i<outputs.size();i++) checksum+=outputs[i]*(i%7+1);
+    cout<<setprecision(12)<<"  output checksum "<<checksum<<endl;
+
+    Backend::aligned_free(inputs);
+    return 0;
+}
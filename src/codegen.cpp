@@ -0,0 +1,55 @@
+/*
+ * Filename: codegen.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a small command line tool that turns a model saved by train.out into a standalone C++ scoring header.
+ */
+
+
+#include <iostream>
+#include <string>
+
+//without a CLASS definition the class label is "class", or the one a .prep file was saved with
+std::string class_label = "class";
+#ifndef CLASS
+#define CLASS class_label
+#endif
+#include "Codegen.h"
+#include "Scoring.h"
+
+using namespace std;
+
+int main(int argc, char** argv){
+
+    if(argc<4){
+        cerr<<"usage: "<<argv[0]<<" model.bin data.arff|model.bin.prep model.h [namespace]\n";
+        cerr<<"data.arff is the file the model was trained on, or model.bin.prep the preprocessing train.out saved with it,\n"
+            <<"its header (with feature hashing) and normalization are baked into model.h\n";
+        return 1;
+    }
+
+    string modelfile = argv[1];
+    string filename = argv[2];
+    string headerfile = argv[3];
+    string name = argc>4 ? argv[4] : "model";
+
+    MLPNetwork net(modelfile);
+    if(filename.size()>5 && filename.compare(filename.size()-5, 5, ".prep")==0){
+        class_label = ScoringSpec::read_classlabel(filename);
+        ScoringSpec spec;
+        spec.load(filename);
+        ModelExporter::write_header(net, spec.getMeta(), spec.getNormalization(), name, headerfile);
+    }
+    else{
+        //the same preprocessing as train.out, so the normalization is the one the model was trained with
+        ARFFDataset data;
+        ARFFDataset::loadARFF(filename, data);
+        data.replaceMissingValuesByClass();
+        data.normalize();
+        ModelExporter::write_header(net, data.getMeta(), data.getNormalization(), name, headerfile);
+    }
+    cout<<"wrote "<<headerfile<<" ("<<net.get_input_size()<<" inputs, "<<net.get_output_size()<<" outputs)"<<endl;
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * Filename: distrib.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains the command line entry point for distributed training, which runs a parameter server,
+ * a single worker, or (by default) a server and all of its workers as processes on this machine.
+ */
+
+
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <chrono>
+#include <set>
+#include <csignal>
+#include <sys/wait.h>
+
+#ifndef CLASS
+#define CLASS "class"
+#endif
+#include "Distributed.h"
+
+using namespace std;
+
+struct WorkerArgs{
+    string filename;
+    string modelfile;
+    int num_workers;
+    int num_epochs;
+    double learningrate;
+    vector<int> hidden_layer_sizes;
+};
+
+//every worker loads and preprocesses the whole file the same way, holds out the last fifth and trains on every
+//num_workers-th row of the rest
+int run_worker(const WorkerArgs& args, const string& address, int rank, const DistributedOptions& options){
+
+    ARFFDataset data;
+    ARFFDataset::loadARFF(args.filename, data);
+    data.replaceMissingValuesByClass();
+    data.normalize();
+    data.shuffle();
+
+    long num_train = data.getSize()*4/5;
+    vector<long> shard;
+    for(long i=rank;i<num_train;i+=args.num_workers) shard.push_back(i);
+
+    MLPNetwork net(args.hidden_layer_sizes, data.getMeta(), args.learningrate, Network::LOGISTIC);
+    DistributedWorker worker(net, address, rank, options);
+    worker.train(data, shard, args.num_epochs);
+    cout<<"worker "<<rank<<": ";
+    worker.get_stats().print(cout);
+
+    //the replicas agree after the last round, so one of them is enough to test and save
+    if(rank==0){
+        if(data.getMeta().get_output_layer_size()>1){
+            vector<string> classlabels = data.getMeta().get_class_values();
+            long correct=0;
+            for(long i=num_train;i<data.getSize();i++) if(net.classify(data.getData()[i], classlabels)==data.getData()[i].getClass()) correct++;
+            cout<<"test accuracy "<<(double)correct/max(1L, data.getSize()-num_train)<<endl;
+        }
+        if(!args.modelfile.empty()){
+            net.save(args.modelfile);
+            cout<<"saved "<<args.modelfile<<endl;
+        }
+    }
+    return 0;
+}
+
+int run_server(const string& address, int num_workers, const DistributedOptions& options){
+    ParameterServer server(address, num_workers, options.accept_timeout_secs);
+    server.serve();
+    cout<<"server: ";
+    server.get_stats().print(cout);
+    return 0;
+}
+
+int main(int argc, char** argv){
+
+    if(argc<2){
+        cerr<<"usage: "<<argv[0]<<" [data.arff] [--workers n] [--address path|host:port] [--serve | --rank r] [--epochs n] [--lr x]\n"
+            <<"       [--hidden n,n,...] [--sync-rows n] [--compression none|float|topk] [--topk-fraction f] [--model model.bin]\n"
+            <<"without --serve or --rank the server and every worker run as processes on this machine\n";
+        return 1;
+    }
+
+    WorkerArgs args;
+    args.num_workers=2;
+    args.num_epochs=10;
+    args.learningrate=0.1;
+    string address = "/tmp/fnn-distrib.sock";
+    bool serve=false;
+    int rank=-1;
+    DistributedOptions options;
+
+    for(int i=1;i<argc;i++){
+        string arg = argv[i];
+        if(arg=="--serve") serve=true;
+        else if(i+1<argc && arg=="--workers") args.num_workers=atoi(argv[++i]);
+        else if(i+1<argc && arg=="--address") address=argv[++i];
+        else if(i+1<argc && arg=="--rank") rank=atoi(argv[++i]);
+        else if(i+1<argc && arg=="--epochs") args.num_epochs=atoi(argv[++i]);
+        else if(i+1<argc && arg=="--lr") args.learningrate=atof(argv[++i]);
+        else if(i+1<argc && arg=="--sync-rows") options.sync_rows=atoi(argv[++i]);
+        else if(i+1<argc && arg=="--topk-fraction") options.topk_fraction=atof(argv[++i]);
+        else if(i+1<argc && arg=="--model") args.modelfile=argv[++i];
+        else if(i+1<argc && arg=="--hidden"){
+            stringstream sizes(argv[++i]);
+            string size;
+            while(getline(sizes, size, ',')) args.hidden_layer_sizes.push_back(atoi(size.c_str()));
+        }
+        else if(i+1<argc && arg=="--compression"){
+            string c = argv[++i];
+            if(c=="none") options.compression=COMPRESS_NONE;
+            else if(c=="float") options.compression=COMPRESS_FLOAT;
+            else if(c=="topk") options.compression=COMPRESS_TOPK;
+            else{
+                cerr<<"unknown compression: "<<c<<endl;
+                return 1;
+            }
+        }
+        else if(arg[0]!='-' && args.filename.empty()) args.filename=arg;
+        else{
+            cerr<<"unknown argument: "<<arg<<endl;
+            return 1;
+        }
+    }
+    if(args.hidden_layer_sizes.empty()) args.hidden_layer_sizes = {100, 100};
+
+    if(serve) return run_server(address, args.num_workers, options);
+    if(args.filename.empty()){
+        cerr<<"Error. Workers need a data file\n";
+        return 1;
+    }
+    if(rank>=0) return run_worker(args, address, rank, options);
+
+    //everything on this machine: one process for the server and one per worker
+    auto start = chrono::steady_clock::now();
+    set<pid_t> children;
+    for(int r=-1;r<args.num_workers;r++){
+        pid_t pid = fork();
+        if(pid==0){
+            cout.flush();
+            int status = r<0 ? run_server(address, args.num_workers, options) : run_worker(args, address, r, options);
+            cout.flush();
+            _exit(status);
+        }
+        children.insert(pid);
+    }
+    //as soon as one process fails the others would wait for it forever (the server for its connection, the workers
+    //for the server's rounds), so they are killed
+    int failed=0;
+    while(!children.empty()){
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if(pid<0){
+            if(errno==EINTR) continue;
+            break;
+        }
+        children.erase(pid);
+        if(!WIFEXITED(status) || WEXITSTATUS(status)!=0){
+            if(failed++==0) for(pid_t other : children) kill(other, SIGTERM);
+        }
+    }
+    cout<<args.num_workers<<" workers, compression "<<UpdateCodec::name(options.compression)<<", "
+        <<chrono::duration<double>(chrono::steady_clock::now()-start).count()<<"s including loading"<<endl;
+    return failed ? 1 : 0;
+}
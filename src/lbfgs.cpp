@@ -0,0 +1,98 @@
+/*
+ * Filename: lbfgs.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a comparison of per-row SGD and full batch L-BFGS training under cross validation on the bundled datasets.
+ */
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+//CLASS only has to be a string expression, so the report can switch class labels between datasets at runtime
+std::string class_label;
+#define CLASS class_label
+#include "LBFGS.h"
+
+using namespace std;
+
+struct BundledDataset{
+    string filename;
+    string classlabel;
+};
+
+//per-row SGD like cross_validate's own, but timed without the loss evaluation that follows every run
+struct SGDRuns{
+    int num_epochs;
+    int random_state;
+    LBFGSTrainer evaluator;
+    long runs=0;
+    double seconds=0, total_loss=0;
+
+    SGDRuns(int num_epochs, int random_state) : num_epochs(num_epochs), random_state(random_state){}
+
+    function<void(Network&, Dataset&, const vector<long>&)> cv_trainer(){
+        return [this](Network& net, Dataset& data, const vector<long>& train_rows){
+            MLPNetwork& mlp = dynamic_cast<MLPNetwork&>(net);
+            vector<long> rows = train_rows;
+            Entry scratch(data.getMeta().get_input_layer_size(), data.getMeta().get_output_layer_size());
+            auto start = chrono::steady_clock::now();
+            for(int i=0;i<num_epochs;i++){
+                FoldPlan::shuffle_indices(rows, CounterRNG(random_state, RNG_EPOCH_SHUFFLE, runs, i));
+                for(long row : rows) mlp.train(data.getEntry(row, scratch));
+            }
+            seconds+=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+            vector<double> params(mlp.get_num_parameters()), grad(params.size());
+            mlp.get_parameters(params.data());
+            total_loss+=evaluator.loss_and_gradient(mlp, data, train_rows, params.data(), grad.data());
+            runs++;
+        };
+    }
+};
+
+//arguments: max_iterations, gradient_tolerance and loss_tolerance of L-BFGS, LBFGSOptions' defaults if not given
+int main(int argc, char** argv){
+
+    vector<BundledDataset> datasets = {{"hypothyroid.arff", "'Class'"}, {"letter.arff", "'class'"}};
+    vector<int> hidden_layer_sizes = {32, 32};
+    int num_folds = 5;
+    int num_epochs = 20;
+    double learningrate = 0.01;
+    LBFGSOptions lbfgs_options;
+    if(argc>1) lbfgs_options.max_iterations = atoi(argv[1]);
+    if(argc>2) lbfgs_options.gradient_tolerance = atof(argv[2]);
+    if(argc>3) lbfgs_options.loss_tolerance = atof(argv[3]);
+
+    for(BundledDataset& d : datasets){
+
+        class_label = d.classlabel;
+        ARFFDataset data;
+        ARFFDataset::loadARFF(d.filename, data);
+        data.replaceMissingValuesByClass();
+        data.normalize();
+
+        MLPNetwork net(hidden_layer_sizes, data.getMeta(), learningrate, Network::TANH);
+        CVOptions options(num_folds);
+        SGDRuns sgd_runs(num_epochs, options.random_state);
+        options.trainer = sgd_runs.cv_trainer();
+        auto sgd = Network::cross_validate(data, net, num_epochs, learningrate, options);
+
+        //L-BFGS is timed until it gets as low as the mean training loss of the SGD runs
+        double sgd_loss = sgd_runs.total_loss/sgd_runs.runs;
+        lbfgs_options.target_loss = sgd_loss;
+        LBFGSTrainer trainer(lbfgs_options);
+        options.trainer = trainer.cv_trainer();
+        auto lbfgs = Network::cross_validate(data, net, num_epochs, learningrate, options);
+        const LBFGSStats& stats = trainer.get_stats();
+
+        cout<<d.filename<<endl;
+        cout<<"  sgd    "<<num_epochs<<" epochs accuracy "<<sgd[ACCURACY]<<" train time "<<sgd_runs.seconds<<"s training loss "<<sgd_loss<<endl;
+        cout<<"  l-bfgs accuracy "<<lbfgs[ACCURACY]<<" train time "<<stats.seconds<<"s, time to the sgd loss "<<stats.seconds_to_target
+            <<"s ("<<stats.reached_target<<" of "<<stats.runs<<" runs got there)"<<endl<<"  ";
+        stats.print(cout);
+    }
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * Filename: loadgen.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ * 
+ * Description: This file contains a closed loop load generator that drives the inference server with concurrent clients.
+ */
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+
+#include "InferenceServer.h"
+
+using namespace std;
+
+int main(int argc, char** argv){
+    
+    string socket_path = "/tmp/fnn.sock";
+    int num_clients = 8, requests_per_client = 10000;
+    
+    for(int i=1;i+1<argc;i+=2){
+        string arg = argv[i];
+        if(arg=="--socket") socket_path=argv[i+1];
+        else if(arg=="--clients") num_clients=atoi(argv[i+1]);
+        else if(arg=="--requests") requests_per_client=atoi(argv[i+1]);
+        else{
+            cerr<<"usage: "<<argv[0]<<" [--socket path] [--clients n] [--requests n_per_client]\n";
+            return 1;
+        }
+    }
+    
+    int input_size = (int)InferenceClient(socket_path).info().at(0);
+    
+    vector<vector<double>> latencies(num_clients);
+    vector<thread> clients;
+    auto start = chrono::steady_clock::now();
+    
+    for(int c=0;c<num_clients;c++){
+        clients.push_back(thread([&, c]{
+            InferenceClient client(socket_path);
+            mt19937 rng(c);
+            normal_distribution<double> dist(0,1);
+            vector<double> input(input_size);
+            
+            for(int r=0;r<requests_per_client;r++){
+                for(double& x : input) x=dist(rng);
+                auto sent = chrono::steady_clock::now();
+                client.score(input);
+                latencies[c].push_back(chrono::duration<double, micro>(chrono::steady_clock::now()-sent).count());
+            }
+        }));
+    }
+    for(thread& t : clients) t.join();
+    
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    
+    vector<double> all;
+    for(auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+    sort(all.begin(), all.end());
+    if(all.empty()){
+        cerr<<"no request finished"<<endl;
+        return 1;
+    }
+    
+    cout<<"client: requests "<<all.size()<<" p50 "<<all[all.size()/2]<<"us p99 "<<all[(size_t)(all.size()*0.99)]
+        <<"us throughput "<<all.size()/elapsed<<" req/s"<<endl;
+    cout<<"server: ";
+    LatencyStats::print(cout, InferenceClient(socket_path).stats());
+    
+    return 0;
+}
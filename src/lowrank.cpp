@@ -0,0 +1,141 @@
+/*
+ * Filename: lowrank.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a report of the ranks, accuracy and throughput of truncated SVD compressed networks against the dense network on the bundled datasets.
+ */
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+//CLASS only has to be a string expression, so the report can switch class labels between datasets at runtime
+std::string class_label;
+#define CLASS class_label
+#include "LowRank.h"
+
+using namespace std;
+
+struct BundledDataset{
+    string filename;
+    string classlabel;
+    double learningrate;
+    double max_deviation; //rows with an input further than this from the attribute's median are dropped, 0 keeps them all
+};
+
+//EEG-Eye-State has a few recording glitches hundreds of times outside the normal range, left in they blow up the standard
+//deviations and squash every other row into a sliver of the z-score, and the network only learns the majority class
+long drop_outliers(ARFFDataset& data, double max_deviation){
+    if(max_deviation<=0) return 0;
+    vector<int> indices;
+    for(Attribute& a : data.getMeta().getAttributes()){
+        if(a.getType()==NUMERIC && a.getLabel()!=CLASSLABEL) indices.push_back(data.getMeta().calcNumericDataIndex(a.getLabel()));
+    }
+    vector<double> medians;
+    for(int index : indices){
+        vector<double> values;
+        for(Entry& e : data.getData()) if(!isnan(e.data[index])) values.push_back(e.data[index]);
+        nth_element(values.begin(), values.begin()+values.size()/2, values.end());
+        medians.push_back(values.empty() ? 0 : values[values.size()/2]);
+    }
+    vector<Entry> kept;
+    for(Entry& e : data.getData()){
+        bool keep=true;
+        for(int k=0;k<(int)indices.size();k++) keep = keep && !(fabs(e.data[indices[k]]-medians[k])>max_deviation);
+        if(keep) kept.push_back(move(e));
+    }
+    long dropped = data.getSize()-(long)kept.size();
+    data.getData().swap(kept);
+    return dropped;
+}
+
+//fastest of a few passes over the test rows, in batches of batch_size and one row at a time
+template<class Forward>
+void time_passes(long num_test, int batch_size, Forward forward, double& batch_time, double& row_time){
+    batch_time=1e30;
+    row_time=1e30;
+    for(int rep=0;rep<5;rep++){
+        auto start = chrono::steady_clock::now();
+        for(long i=0;i<num_test;i+=batch_size) forward(i, (int)min((long)batch_size, num_test-i));
+        auto mid = chrono::steady_clock::now();
+        for(long i=0;i<num_test;i++) forward(i, 1);
+        auto end = chrono::steady_clock::now();
+        batch_time = min(batch_time, chrono::duration<double>(mid-start).count());
+        row_time = min(row_time, chrono::duration<double>(end-mid).count());
+    }
+}
+
+int main(){
+
+    //EEG also needs a smaller step, at 0.01 the wide tanh layers saturate and it stays at the majority class
+    vector<BundledDataset> datasets = {{"hypothyroid.arff", "'Class'", 0.01, 0}, {"letter.arff", "'class'", 0.01, 0},
+                                       {"EEG-Eye-State.arff", "eyeDetection", 0.001, 1000}};
+    vector<int> hidden_layer_sizes = {256, 256};
+    vector<double> budgets = {0.0025, 0.005, 0.01, 0.02};
+    int num_epochs = 5;
+    int batch_size = 256;
+
+    for(BundledDataset& d : datasets){
+
+        class_label = d.classlabel;
+        ARFFDataset data;
+        ARFFDataset::loadARFF(d.filename, data);
+        long dropped = drop_outliers(data, d.max_deviation);
+        data.replaceMissingValuesByClass();
+        data.normalize();
+        data.shuffle();
+
+        //train on 70%, pick the ranks on the next 10% and report on the last 20%
+        long num_entries = data.getSize();
+        long num_train = num_entries*7/10, num_valid = num_entries*8/10;
+
+        MLPNetwork net(hidden_layer_sizes, data.getMeta(), d.learningrate, Network::TANH);
+        for(int i=0;i<num_epochs;i++){
+            for(long j=0;j<num_train;j++) net.train(data.getData()[j]);
+        }
+
+        int in_size = net.get_input_size(), out_size = net.get_output_size();
+        long num_test = num_entries-num_valid;
+        vector<double> inputs(num_test*in_size), outputs(num_test*out_size);
+        for(long i=0;i<num_test;i++) memcpy(&inputs[i*in_size], data.getData()[num_valid+i].data, sizeof(double)*in_size);
+
+        MLPNetwork::Workspace dense_ws(net, batch_size);
+        double dense_batch, dense_row;
+        time_passes(num_test, batch_size, [&](long i, int n){net.forward_batch(&inputs[i*in_size], n, &outputs[i*out_size], dense_ws);},
+                    dense_batch, dense_row);
+        double dense_error = LowRankCompressor::error(net, data, num_valid, num_entries);
+
+        auto start = chrono::steady_clock::now();
+        vector<LayerSVD> svds = LowRankCompressor::decompose(net);
+        double svd_time = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+
+        cout<<d.filename<<endl;
+        if(dropped>0) cout<<"  dropped "<<dropped<<" rows with an input more than "<<d.max_deviation<<" from its median"<<endl;
+        cout<<"  dense test error "<<dense_error<<" rows/s batch "<<num_test/dense_batch<<" single "<<num_test/dense_row
+            <<", svd of every connection "<<svd_time<<"s"<<endl;
+
+        for(double budget : budgets){
+            start = chrono::steady_clock::now();
+            vector<int> ranks = LowRankCompressor::choose_ranks(net, svds, data, num_train, num_valid, budget);
+            double search_time = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+
+            LowRankMLP lnet(net, svds, ranks);
+            LowRankMLP::Workspace low_ws(lnet, batch_size);
+            double low_batch, low_row;
+            time_passes(num_test, batch_size, [&](long i, int n){lnet.forward_batch(&inputs[i*in_size], n, &outputs[i*out_size], low_ws);},
+                        low_batch, low_row);
+            double low_error = LowRankCompressor::error(lnet, data, num_valid, num_entries);
+
+            cout<<" validation budget "<<budget<<" test error "<<low_error<<" delta "<<low_error-dense_error
+                <<" speedup batch "<<dense_batch/low_batch<<" single "<<dense_row/low_row<<", rank search "<<search_time<<"s"<<endl;
+            lnet.print_report(cout);
+        }
+    }
+
+    return 0;
+}
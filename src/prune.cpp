@@ -0,0 +1,169 @@
+/*
+ * Filename: prune.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a report of the accuracy and throughput of magnitude pruned block sparse networks against the dense network on the bundled datasets.
+ */
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+//CLASS only has to be a string expression, so the report can switch class labels between datasets at runtime
+std::string class_label;
+#define CLASS class_label
+#include "Pruned.h"
+
+using namespace std;
+
+struct BundledDataset{
+    string filename;
+    string classlabel;
+    double learningrate;
+    double max_deviation; //rows with an input further than this from the attribute's median are dropped, 0 keeps them all
+};
+
+//EEG-Eye-State has a few recording glitches hundreds of times outside the normal range, left in they blow up the standard
+//deviations and squash every other row into a sliver of the z-score, and the network only learns the majority class
+long drop_outliers(ARFFDataset& data, double max_deviation){
+    if(max_deviation<=0) return 0;
+    vector<int> indices;
+    for(Attribute& a : data.getMeta().getAttributes()){
+        if(a.getType()==NUMERIC && a.getLabel()!=CLASSLABEL) indices.push_back(data.getMeta().calcNumericDataIndex(a.getLabel()));
+    }
+    vector<double> medians;
+    for(int index : indices){
+        vector<double> values;
+        for(Entry& e : data.getData()) if(!isnan(e.data[index])) values.push_back(e.data[index]);
+        nth_element(values.begin(), values.begin()+values.size()/2, values.end());
+        medians.push_back(values.empty() ? 0 : values[values.size()/2]);
+    }
+    vector<Entry> kept;
+    for(Entry& e : data.getData()){
+        bool keep=true;
+        for(int k=0;k<(int)indices.size();k++) keep = keep && !(fabs(e.data[indices[k]]-medians[k])>max_deviation);
+        if(keep) kept.push_back(move(e));
+    }
+    long dropped = data.getSize()-(long)kept.size();
+    data.getData().swap(kept);
+    return dropped;
+}
+
+//fraction of rows whose most probable output is the actual class
+double accuracy(const double* outputs, int output_size, vector<Entry>& data, long start, long end){
+    long correct=0;
+    for(long i=start;i<end;i++){
+        const double* o = outputs+(i-start)*output_size;
+        int predicted = (int)(max_element(o, o+output_size)-o);
+        if(data[i].expected[predicted]==1) correct++;
+    }
+    return (double)correct/(end-start);
+}
+
+//fastest of a few passes over the test rows, in batches of batch_size and one row at a time
+template<class Forward, class ForwardRow>
+void time_passes(long num_test, int batch_size, Forward forward, ForwardRow forward_row, double& batch_time, double& row_time){
+    batch_time=1e30;
+    row_time=1e30;
+    for(int rep=0;rep<5;rep++){
+        auto start = chrono::steady_clock::now();
+        for(long i=0;i<num_test;i+=batch_size) forward(i, (int)min((long)batch_size, num_test-i));
+        auto mid = chrono::steady_clock::now();
+        for(long i=0;i<num_test;i++) forward_row(i);
+        auto end = chrono::steady_clock::now();
+        batch_time = min(batch_time, chrono::duration<double>(mid-start).count());
+        row_time = min(row_time, chrono::duration<double>(end-mid).count());
+    }
+}
+
+int main(){
+
+    //EEG also needs a smaller step, at 0.01 the wide tanh layers saturate and it stays at the majority class
+    vector<BundledDataset> datasets = {{"hypothyroid.arff", "'Class'", 0.01, 0}, {"letter.arff", "'class'", 0.01, 0},
+                                       {"EEG-Eye-State.arff", "eyeDetection", 0.001, 1000}};
+    vector<int> hidden_layer_sizes = {256, 256};
+    vector<double> sparsities = {0.5, 0.7, 0.8, 0.9, 0.95};
+    vector<int> blocks = {1, 4};
+    int num_epochs = 5;
+    int fine_tune_epochs = 1;
+    int batch_size = 256;
+
+    for(BundledDataset& d : datasets){
+
+        class_label = d.classlabel;
+        ARFFDataset data;
+        ARFFDataset::loadARFF(d.filename, data);
+        long dropped = drop_outliers(data, d.max_deviation);
+        data.replaceMissingValuesByClass();
+        data.normalize();
+        data.shuffle();
+
+        long num_entries = data.getSize();
+        long num_train = num_entries*4/5;
+
+        MLPNetwork net(hidden_layer_sizes, data.getMeta(), d.learningrate, Network::TANH);
+        for(int i=0;i<num_epochs;i++){
+            for(long j=0;j<num_train;j++) net.train(data.getData()[j]);
+        }
+        stringstream trained;
+        net.save(trained);
+
+        int in_size = net.get_input_size(), out_size = net.get_output_size();
+        long num_test = num_entries-num_train;
+        vector<double> inputs(num_test*in_size), outputs(num_test*out_size);
+        for(long i=0;i<num_test;i++) memcpy(&inputs[i*in_size], data.getData()[num_train+i].data, sizeof(double)*in_size);
+
+        MLPNetwork::Workspace dense_ws(net, batch_size);
+        double dense_batch, dense_row;
+        time_passes(num_test, batch_size,
+                    [&](long i, int n){net.forward_batch(&inputs[i*in_size], n, &outputs[i*out_size], dense_ws);},
+                    [&](long i){memcpy(&outputs[i*out_size], net.forward(&inputs[i*in_size], dense_ws), sizeof(double)*out_size);},
+                    dense_batch, dense_row);
+        double dense_acc = accuracy(outputs.data(), out_size, data.getData(), num_train, num_entries);
+
+        cout<<d.filename<<endl;
+        if(dropped>0) cout<<"  dropped "<<dropped<<" rows with an input more than "<<d.max_deviation<<" from its median"<<endl;
+        cout<<"  dense accuracy "<<dense_acc<<" rows/s batch "<<num_test/dense_batch<<" single "<<num_test/dense_row<<endl;
+
+        for(int block : blocks){
+            double batch_breakeven=-1, row_breakeven=-1;
+            for(double sparsity : sparsities){
+                trained.clear();
+                trained.seekg(0);
+                MLPNetwork pruned(trained);
+                PruneMask masks = Pruner::prune(pruned, sparsity, block, block);
+                Pruner::fine_tune(pruned, data, masks, fine_tune_epochs, num_train);
+
+                SparseMLP snet(pruned, block, block);
+                SparseMLP::Workspace sparse_ws(snet, batch_size);
+                double sparse_batch, sparse_row;
+                time_passes(num_test, batch_size,
+                            [&](long i, int n){snet.forward_batch(&inputs[i*in_size], n, &outputs[i*out_size], sparse_ws);},
+                            [&](long i){snet.forward_batch(&inputs[i*in_size], 1, &outputs[i*out_size], sparse_ws);},
+                            sparse_batch, sparse_row);
+                double sparse_acc = accuracy(outputs.data(), out_size, data.getData(), num_train, num_entries);
+                if(batch_breakeven<0 && sparse_batch<dense_batch) batch_breakeven=sparsity;
+                if(row_breakeven<0 && sparse_row<dense_row) row_breakeven=sparsity;
+
+                cout<<"  "<<block<<"x"<<block<<" sparsity "<<sparsity<<" accuracy "<<sparse_acc<<" delta "<<sparse_acc-dense_acc
+                    <<" speedup batch "<<dense_batch/sparse_batch<<" single "<<dense_row/sparse_row
+                    <<" parameter bytes "<<snet.get_parameter_bytes()<<endl;
+            }
+            cout<<"  "<<block<<"x"<<block<<" beats dense from sparsity: batch ";
+            if(batch_breakeven<0) cout<<"never";
+            else cout<<batch_breakeven;
+            cout<<", single row ";
+            if(row_breakeven<0) cout<<"never";
+            else cout<<row_breakeven;
+            cout<<endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * Filename: quantize.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ * 
+ * Description: This file contains a report comparing the int8 quantized network against the double precision network on the bundled datasets.
+ */
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+//CLASS only has to be a string expression, so the report can switch class labels between datasets at runtime
+std::string class_label;
+#define CLASS class_label
+#include "Quantized.h"
+
+using namespace std;
+
+struct BundledDataset{
+    string filename;
+    string classlabel;
+    double learningrate;
+    double max_deviation; //rows with an input further than this from the attribute's median are dropped, 0 keeps them all
+};
+
+//EEG-Eye-State has a few recording glitches hundreds of times outside the normal range, left in they blow up the standard
+//deviations and squash every other row into a sliver of the z-score, and the network only learns the majority class
+long drop_outliers(ARFFDataset& data, double max_deviation){
+    if(max_deviation<=0) return 0;
+    vector<int> indices;
+    for(Attribute& a : data.getMeta().getAttributes()){
+        if(a.getType()==NUMERIC && a.getLabel()!=CLASSLABEL) indices.push_back(data.getMeta().calcNumericDataIndex(a.getLabel()));
+    }
+    vector<double> medians;
+    for(int index : indices){
+        vector<double> values;
+        for(Entry& e : data.getData()) if(!isnan(e.data[index])) values.push_back(e.data[index]);
+        nth_element(values.begin(), values.begin()+values.size()/2, values.end());
+        medians.push_back(values.empty() ? 0 : values[values.size()/2]);
+    }
+    vector<Entry> kept;
+    for(Entry& e : data.getData()){
+        bool keep=true;
+        for(int k=0;k<(int)indices.size();k++) keep = keep && !(fabs(e.data[indices[k]]-medians[k])>max_deviation);
+        if(keep) kept.push_back(move(e));
+    }
+    long dropped = data.getSize()-(long)kept.size();
+    data.getData().swap(kept);
+    return dropped;
+}
+
+//fraction of rows whose most probable output is the actual class
+double accuracy(const double* outputs, int output_size, vector<Entry>& data, long start, long end){
+    long correct=0;
+    for(long i=start;i<end;i++){
+        const double* o = outputs+(i-start)*output_size;
+        int predicted = (int)(max_element(o, o+output_size)-o);
+        if(data[i].expected[predicted]==1) correct++;
+    }
+    return (double)correct/(end-start);
+}
+
+int main(){
+    
+    //EEG also needs a smaller step, at 0.01 the tanh layers saturate and it stays at the majority class
+    vector<BundledDataset> datasets = {{"hypothyroid.arff", "'Class'", 0.01, 0}, {"letter.arff", "'class'", 0.01, 0},
+                                       {"EEG-Eye-State.arff", "eyeDetection", 0.001, 1000}};
+    vector<int> hidden_layer_sizes = {128, 128};
+    int num_epochs = 5;
+    int batch_size = 256;
+    
+    for(BundledDataset& d : datasets){
+        
+        class_label = d.classlabel;
+        ARFFDataset data;
+        ARFFDataset::loadARFF(d.filename, data);
+        long dropped = drop_outliers(data, d.max_deviation);
+        data.replaceMissingValuesByClass();
+        data.normalize();
+        data.shuffle();
+        
+        long num_entries = data.getSize();
+        long num_train = num_entries*4/5;
+        
+        MLPNetwork net(hidden_layer_sizes, data.getMeta(), d.learningrate, Network::TANH);
+        for(int i=0;i<num_epochs;i++){
+            for(long j=0;j<num_train;j++) net.train(data.getData()[j]);
+        }
+        
+        //calibrate on a sample of the training rows only
+        vector<long> train_rows(num_train);
+        for(long j=0;j<num_train;j++) train_rows[j]=j;
+        QuantizedMLP qnet(net, data, train_rows, 1000);
+        
+        int in_size = net.get_input_size(), out_size = net.get_output_size();
+        long num_test = num_entries-num_train;
+        vector<double> inputs(num_test*in_size), dense_out(num_test*out_size), quant_out(num_test*out_size);
+        for(long i=0;i<num_test;i++) memcpy(&inputs[i*in_size], data.getData()[num_train+i].data, sizeof(double)*in_size);
+        
+        MLPNetwork::Workspace dense_ws(net, batch_size);
+        QuantizedMLP::Workspace quant_ws(qnet, batch_size);
+        
+        //score the test rows a few times in batches and keep the time of the fastest pass
+        double dense_time=1e30, quant_time=1e30;
+        for(int rep=0;rep<5;rep++){
+            auto start = chrono::steady_clock::now();
+            for(long i=0;i<num_test;i+=batch_size) net.forward_batch(&inputs[i*in_size], (int)min((long)batch_size, num_test-i), &dense_out[i*out_size], dense_ws);
+            auto mid = chrono::steady_clock::now();
+            for(long i=0;i<num_test;i+=batch_size) qnet.forward_batch(&inputs[i*in_size], (int)min((long)batch_size, num_test-i), &quant_out[i*out_size], quant_ws);
+            auto end = chrono::steady_clock::now();
+            dense_time = min(dense_time, chrono::duration<double>(mid-start).count());
+            quant_time = min(quant_time, chrono::duration<double>(end-mid).count());
+        }
+        
+        long agree=0;
+        for(long i=0;i<num_test;i++){
+            const double* a = &dense_out[i*out_size];
+            const double* b = &quant_out[i*out_size];
+            if(max_element(a, a+out_size)-a == max_element(b, b+out_size)-b) agree++;
+        }
+        
+        double dense_acc = accuracy(dense_out.data(), out_size, data.getData(), num_train, num_entries);
+        double quant_acc = accuracy(quant_out.data(), out_size, data.getData(), num_train, num_entries);
+        long dense_bytes=0;
+        for(int i=0;i<net.get_num_layers()-1;i++) dense_bytes += sizeof(double)*(net.get_sizes().at(i)+1)*net.get_sizes().at(i+1);
+        
+        cout<<d.filename<<endl;
+        if(dropped>0) cout<<"  dropped "<<dropped<<" rows with an input more than "<<d.max_deviation<<" from its median"<<endl;
+        cout<<"  accuracy double "<<dense_acc<<" int8 "<<quant_acc<<" delta "<<quant_acc-dense_acc<<" agreement "<<(double)agree/num_test<<endl;
+        cout<<"  rows/s double "<<num_test/dense_time<<" int8 "<<num_test/quant_time<<" speedup "<<dense_time/quant_time<<endl;
+        cout<<"  parameter bytes double "<<dense_bytes<<" int8 "<<qnet.get_parameter_bytes()<<endl;
+    }
+    
+    return 0;
+}
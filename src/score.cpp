@@ -0,0 +1,72 @@
+/*
+ * Filename: score.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains the command line batch scorer, which streams an ARFF or CSV file of any size through a model saved by train.out.
+ */
+
+
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+//the class label is read from the model's preprocessing file, so one build scores any model
+std::string class_label;
+#define CLASS class_label
+#include "Scoring.h"
+
+using namespace std;
+
+int main(int argc, char** argv){
+
+    if(argc<4){
+        cerr<<"usage: "<<argv[0]<<" model.bin input.arff|input.csv|- output|- [--prep model.bin.prep] [--threads n] [--batch n]\n"
+            <<"       [--chunk-mb n] [--probabilities]\n"
+            <<"writes one line per input row: the predicted label, the class probabilities or the predicted value\n";
+        return 1;
+    }
+
+    string modelfile = argv[1];
+    string infile = argv[2];
+    string outfile = argv[3];
+    string prepfile = modelfile+".prep";
+    ScoringOptions options;
+    for(int i=4;i<argc;i++){
+        string arg = argv[i];
+        if(arg=="--probabilities") options.probabilities=true;
+        else if(i+1<argc && arg=="--prep") prepfile=argv[++i];
+        else if(i+1<argc && arg=="--threads") options.num_threads=atoi(argv[++i]);
+        else if(i+1<argc && arg=="--batch") options.batch_rows=atoi(argv[++i]);
+        else if(i+1<argc && arg=="--chunk-mb") options.chunk_bytes=(long)(atof(argv[++i])*(1<<20));
+        else{
+            cerr<<"unknown argument: "<<arg<<endl;
+            return 1;
+        }
+    }
+
+    class_label = ScoringSpec::read_classlabel(prepfile);
+    ScoringSpec spec;
+    spec.load(prepfile);
+    MLPNetwork net(modelfile);
+    StreamScorer scorer(net, spec, options);
+
+    FILE* in = infile=="-" ? stdin : fopen(infile.c_str(), "rb");
+    FILE* out = outfile=="-" ? stdout : fopen(outfile.c_str(), "wb");
+    if(in==NULL || out==NULL){
+        cerr<<"unable to open "<<(in==NULL ? infile : outfile)<<endl;
+        return 1;
+    }
+    //the scorer writes whole chunks, a large stdio buffer turns them into few write calls
+    setvbuf(out, NULL, _IOFBF, 1<<20);
+
+    ScoringStats stats = scorer.score(in, out);
+    if(in!=stdin) fclose(in);
+    if(out!=stdout && fclose(out)!=0){
+        cerr<<"Error. Unable to write "<<outfile<<endl;
+        return 1;
+    }
+    stats.print(cerr);
+    return 0;
+}
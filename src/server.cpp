@@ -0,0 +1,76 @@
+/*
+ * Filename: server.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ * 
+ * Description: This file contains the command line entry point for the micro-batching inference server.
+ */
+
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+
+#include "InferenceServer.h"
+
+using namespace std;
+
+int main(int argc, char** argv){
+    
+    if(argc<2){
+        cerr<<"usage: "<<argv[0]<<" model.bin [--socket path | --stdio] [--max-batch n] [--budget-us n] [--report-secs n] [--autotune [cache]]\n";
+        return 1;
+    }
+    
+    string socket_path = "/tmp/fnn.sock";
+    bool stdio = false;
+    int max_batch = 64, budget_us = 500, report_secs = 0;
+    bool autotune = false;
+    string cache_file = AUTOTUNE_CACHE;
+    
+    for(int i=2;i<argc;i++){
+        string arg = argv[i];
+        if(arg=="--stdio") stdio=true;
+        else if(i+1<argc && arg=="--socket") socket_path=argv[++i];
+        else if(i+1<argc && arg=="--max-batch") max_batch=atoi(argv[++i]);
+        else if(i+1<argc && arg=="--budget-us") budget_us=atoi(argv[++i]);
+        else if(i+1<argc && arg=="--report-secs") report_secs=atoi(argv[++i]);
+        else if(arg=="--autotune"){
+            autotune=true;
+            if(i+1<argc && argv[i+1][0]!='-') cache_file=argv[++i];
+        }
+        else{
+            cerr<<"unknown argument: "<<arg<<endl;
+            return 1;
+        }
+    }
+    
+    if(max_batch<1){
+        cerr<<"--max-batch must be at least 1"<<endl;
+        return 1;
+    }
+    
+    string modelfile = argv[1];
+    MLPNetwork net(modelfile);
+    
+    //batches are scored on the batcher thread, so only single threaded configs are tried
+    ExecutionConfig config;
+    if(autotune){
+        config = Autotuner::tune(net, cache_file, 1);
+        cerr<<"autotune: "<<config.describe()<<endl;
+        if(config.kernel!=KERNEL_GEMV) max_batch = max(1, config.batch_size);
+    }
+    
+    InferenceServer server(net, max_batch, budget_us);
+    server.set_execution(config);
+    
+    if(stdio) server.serve_stdio(report_secs);
+    else{
+        cerr<<"listening on "<<socket_path<<endl;
+        server.serve_unix(socket_path, report_secs);
+    }
+    
+    LatencyStats::print(cerr, server.get_stats().snapshot());
+    return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ * Filename: alloc_test.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a test that counts heap allocations (operator new and the malloc family) around warmed up
+ * training and inference loops and fails if any of them allocates.
+ */
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <malloc.h>
+
+#include "../Network.h"
+
+using namespace std;
+
+//counted on every thread, the pool threads of intra-op training included
+static atomic<long> allocations(0);
+static atomic<bool> counting(false);
+
+static inline void count(){
+    if(counting.load(memory_order_relaxed)) allocations.fetch_add(1, memory_order_relaxed);
+}
+
+//glibc's own entry points, so the wrappers below can interpose the malloc family
+extern "C" void* __libc_malloc(size_t);
+extern "C" void* __libc_calloc(size_t, size_t);
+extern "C" void* __libc_realloc(void*, size_t);
+extern "C" void* __libc_memalign(size_t, size_t);
+extern "C" void __libc_free(void*);
+
+extern "C" void* malloc(size_t n){count(); return __libc_malloc(n);}
+extern "C" void* calloc(size_t n, size_t size){count(); return __libc_calloc(n, size);}
+extern "C" void* realloc(void* p, size_t n){count(); return __libc_realloc(p, n);}
+extern "C" void* aligned_alloc(size_t alignment, size_t n){count(); return __libc_memalign(alignment, n);}
+extern "C" int posix_memalign(void** p, size_t alignment, size_t n){
+    count();
+    *p = __libc_memalign(alignment, n);
+    return *p ? 0 : ENOMEM;
+}
+
+void* operator new(size_t n){
+    count();
+    void* p = __libc_malloc(n>0 ? n : 1);
+    if(!p) throw bad_alloc();
+    return p;
+}
+void* operator new[](size_t n){return operator new(n);}
+void operator delete(void* p) noexcept {__libc_free(p);}
+void operator delete[](void* p) noexcept {__libc_free(p);}
+void operator delete(void* p, size_t) noexcept {__libc_free(p);}
+void operator delete[](void* p, size_t) noexcept {__libc_free(p);}
+
+static int failures=0;
+
+//runs f warmup times untimed, then iterations times with allocations counted
+template<class F>
+static void expect_no_allocations(const string& name, int iterations, const F& f){
+    for(int i=0;i<3;i++) f(i);
+    allocations=0;
+    counting=true;
+    for(int i=0;i<iterations;i++) f(i);
+    counting=false;
+    long n = allocations;
+    cout<<(n==0 ? "ok   " : "FAIL ")<<name<<": "<<n<<" allocations in "<<iterations<<" iterations"<<endl;
+    if(n!=0) failures++;
+}
+
+static void fill(Entry& e, int row){
+    for(int i=0;i<e.get_data_size();i++) e.data[i] = ((row*31+i*17)%200)/100.0-1;
+    for(int i=0;i<e.get_expected_size();i++) e.expected[i] = (row%e.get_expected_size()==i);
+}
+
+int main(){
+
+    const int rows=64, batch=32;
+    vector<string> classlabels = {"a", "b", "c", "d"};
+
+    MLPNetwork net({20, 64, 32, 4}, 0.05, Network::TANH);
+    MLPNetwork wide({20, 256, 4}, 0.05, Network::LOGISTIC);
+    MLPNetwork regression({20, 16, 1}, 0.05, Network::RELU);
+
+    vector<Entry> entries, targets;
+    for(int r=0;r<rows;r++){
+        entries.emplace_back(20, 4);
+        fill(entries.back(), r);
+        targets.emplace_back(20, 1);
+        fill(targets.back(), r);
+        targets.back().expected[0] = entries.back().data[0];
+    }
+    vector<double> inputs((long)batch*20), outputs((long)batch*4);
+    for(int i=0;i<batch;i++) memcpy(inputs.data()+(long)i*20, entries[i].data, sizeof(double)*20);
+
+    expect_no_allocations("train", 1000, [&](int i){net.train(entries[i%rows]);});
+
+    expect_no_allocations("train regression", 1000, [&](int i){regression.train(targets[i%rows]);});
+
+    net.set_intra_op_threads(2, 1);
+    expect_no_allocations("train with intra-op threads", 1000, [&](int i){net.train(entries[i%rows]);});
+    net.set_intra_op_threads(1);
+
+    volatile long checksum=0;
+    expect_no_allocations("classify", 1000, [&](int i){checksum += net.classify(entries[i%rows], classlabels).size();});
+
+    MLPNetwork::Workspace ws(net, batch);
+    expect_no_allocations("classify with workspace", 1000, [&](int i){checksum += net.classify(entries[i%rows], classlabels, ws).size();});
+
+    expect_no_allocations("predict", 1000, [&](int i){checksum += regression.predict(targets[i%rows])>0;});
+
+    expect_no_allocations("forward_batch", 200, [&](int){net.forward_batch(inputs.data(), batch, outputs.data());});
+
+    expect_no_allocations("forward_batch with workspace", 200, [&](int){net.forward_batch(inputs.data(), batch, outputs.data(), ws);});
+
+    //the thread's local workspaces are kept per network, so switching networks every call doesn't replan
+    expect_no_allocations("local workspaces of alternating networks", 1000, [&](int i){
+        if(i%2) checksum += net.classify(entries[i%rows], classlabels).size();
+        else checksum += wide.classify(entries[i%rows], classlabels).size();
+    });
+
+    expect_no_allocations("alternating forward_batch", 200, [&](int i){
+        if(i%2) net.forward_batch(inputs.data(), batch, outputs.data());
+        else wide.forward_batch(inputs.data(), batch, outputs.data());
+    });
+
+    if(failures>0){
+        cout<<failures<<" loops allocated"<<endl;
+        return 1;
+    }
+    cout<<"no allocations in steady state"<<endl;
+    return 0;
+}
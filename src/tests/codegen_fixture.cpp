@@ -0,0 +1,84 @@
+/*
+ * Filename: codegen_fixture.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains the first step of the code generation test: it writes a classification and a regression
+ * dataset with numeric, categorical and hashed attributes and missing values, trains a network on each and saves the
+ * models with their preprocessing for codegen.out. It also writes the rows the generated headers are checked on.
+ */
+
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#define CLASS "class"
+#include "../Scoring.h"
+
+using namespace std;
+
+static const char* COLORS[] = {"red", "green", "blue"};
+
+//one row, the zip codes are drawn from far more values than the header lists, so most rows use unlisted ones
+//every 7th row misses a numeric value, every 11th the color and every 13th the zip
+static string row(int r, bool regression){
+    CounterRNG rng(7, RNG_SYNTHETIC, regression);
+    double x1 = rng.normal(4*r)*2+1, x2 = rng.uniform(4*r+1, -3, 5);
+    int color = (int)rng.below(4*r+2, 3);
+    int zip = 10000+(int)rng.below(4*r+3, 500);
+    ostringstream os;
+    os.precision(6);
+    if(r%7==0) os<<"?"; else os<<x1;
+    os<<","<<x2<<",";
+    if(r%11==0) os<<"?"; else os<<COLORS[color];
+    os<<",";
+    if(r%13==0) os<<"?"; else os<<zip;
+    os<<",";
+    double signal = x1-0.5*x2+(color==1 ? 2 : 0)+(zip%3)*0.7;
+    if(regression) os<<signal;
+    else os<<(signal<0 ? "a" : signal<2.5 ? "b" : "c");
+    return os.str();
+}
+
+static void write_arff(const string& filename, int first, int rows, bool regression){
+    ofstream out(filename.c_str());
+    out<<"@relation codegen_"<<(regression ? "regression" : "classification")<<"\n";
+    out<<"@attribute x1 numeric\n@attribute x2 numeric\n@attribute color {red,green,blue}\n";
+    //the header lists a few zip codes, the hashed encoding gives every other one a bucket too
+    out<<"@attribute zip {10000,10001,10002,10003,10004}\n";
+    out<<(regression ? "@attribute class numeric\n" : "@attribute class {a,b,c}\n");
+    out<<"@data\n";
+    for(int r=first;r<first+rows;r++) out<<row(r, regression)<<"\n";
+}
+
+static void train(const string& name, bool regression){
+
+    write_arff(name+".arff", 0, 1500, regression);
+    write_arff(name+"_rows.arff", 100000, 500, regression);
+
+    ARFFDataset data;
+    data.getMeta().setHashBuckets("zip", 16);
+    ARFFDataset::loadARFF(name+".arff", data);
+    if(regression) data.replaceMissingValues();
+    else data.replaceMissingValuesByClass();
+    data.normalize();
+    data.shuffle();
+
+    MLPNetwork net({12, 8}, data.getMeta(), 0.05, regression ? Network::RELU : Network::TANH);
+    for(int epoch=0;epoch<10;epoch++){
+        for(Entry& e : data.getData()) net.train(e);
+    }
+    net.save(name+".bin");
+    ScoringSpec(data).save(name+".bin.prep");
+    cout<<"trained "<<name<<".bin ("<<net.get_input_size()<<" inputs, "<<net.get_output_size()<<" outputs)"<<endl;
+}
+
+//the files go to the directory given as the first argument
+int main(int argc, char** argv){
+    string dir = argc>1 ? string(argv[1])+"/" : "";
+    train(dir+"codegen_class", false);
+    train(dir+"codegen_reg", true);
+    return 0;
+}
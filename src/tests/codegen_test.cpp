@@ -0,0 +1,129 @@
+/*
+ * Filename: codegen_test.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains the second step of the code generation test: it scores the held out rows of both fixture
+ * datasets with the headers codegen.out generated and with MLPNetwork and fails unless they agree.
+ */
+
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+#define CLASS "class"
+#include "../Scoring.h"
+#include "codegen_class.h"
+#include "codegen_reg.h"
+
+using namespace std;
+
+/*
+ * The encoded inputs have to be bit for bit the same and the classes exactly the same. The outputs may differ by the order
+ * of the additions in the layer sums (the BLAS kernels pick their own), so they only have to agree to within 1e-12 absolute
+ * (relative for regression values larger than 1), the largest distance in units in the last place is reported as well.
+ */
+#define OUTPUT_TOLERANCE 1e-12
+
+static long ulps(double a, double b){
+    int64_t x, y;
+    memcpy(&x, &a, sizeof(double));
+    memcpy(&y, &b, sizeof(double));
+    if(x<0) x = INT64_MIN-x;
+    if(y<0) y = INT64_MIN-y;
+    return x>y ? x-y : y-x;
+}
+
+struct Agreement{
+    long rows=0, missing_rows=0, encode_mismatches=0, label_mismatches=0, output_mismatches=0, max_ulps=0;
+    double max_error=0;
+
+    void compare_outputs(const double* expected, const double* actual, int n){
+        bool mismatch=false;
+        for(int i=0;i<n;i++){
+            double error = fabs(expected[i]-actual[i])/max(1.0, fabs(expected[i]));
+            max_error = max(max_error, error);
+            max_ulps = max(max_ulps, ulps(expected[i], actual[i]));
+            if(!(error<=OUTPUT_TOLERANCE)) mismatch=true;
+        }
+        if(mismatch) output_mismatches++;
+    }
+
+    bool report(const string& name) const {
+        bool ok = rows>0 && missing_rows>0 && encode_mismatches==0 && label_mismatches==0 && output_mismatches==0;
+        cout<<(ok ? "ok   " : "FAIL ")<<name<<": "<<rows<<" rows ("<<missing_rows<<" with missing values), "<<encode_mismatches
+            <<" encodings differ, "<<label_mismatches<<" predictions differ, "<<output_mismatches<<" outputs off by more than "
+            <<OUTPUT_TOLERANCE<<", max error "<<max_error<<" ("<<max_ulps<<" ulp)"<<endl;
+        return ok;
+    }
+};
+
+//runs every row of rowfile through the library and through the generated encode, forward and classify_row/predict_row
+template<class Encode, class Forward, class Score, class Reference>
+static bool check(const string& name, Encode encode, Forward forward, Score score, Reference reference){
+
+    ScoringSpec spec;
+    spec.load(name+".bin.prep");
+    MLPNetwork net(name+".bin");
+    MLPNetwork::Workspace ws(net);
+    ARFFRowEncoder encoder(spec.getMeta(), ARFFRowEncoder::CLASS_IGNORED);
+    Entry e(encoder.get_data_length(), encoder.get_expected_length());
+    int in_size = net.get_input_size(), out_size = net.get_output_size();
+    vector<double> input(in_size), output(out_size);
+
+    ifstream rows((name+"_rows.arff").c_str());
+    string line;
+    while(getline(rows, line) && line!="@data");
+
+    Agreement agreement;
+    while(getline(rows, line)){
+        if(line.empty()) continue;
+        encoder.encode(line.data(), line.data()+line.size(), e);
+        if(!spec.getNormalization().empty()) spec.getNormalization().apply(e.data);
+        for(int k=0;k<in_size;k++) if(isnan(e.data[k])) e.data[k]=0;
+
+        //the raw fields without the class, which is the last one
+        vector<string> fields;
+        size_t begin=0, end;
+        while((end=line.find(',', begin))!=string::npos){
+            fields.push_back(line.substr(begin, end-begin));
+            begin=end+1;
+        }
+        vector<const char*> values;
+        for(string& f : fields) values.push_back(f.c_str());
+        if(line.find('?')!=string::npos) agreement.missing_rows++;
+
+        encode(values.data(), input.data());
+        if(memcmp(input.data(), e.data, sizeof(double)*in_size)!=0) agreement.encode_mismatches++;
+        forward(input.data(), output.data());
+        agreement.compare_outputs(net.forward(e, ws), output.data(), out_size);
+        if(!reference(net, spec, e, score(values.data()))) agreement.label_mismatches++;
+        agreement.rows++;
+    }
+    return agreement.report(name);
+}
+
+//reads the files codegen_fixture.out and codegen.out wrote to the directory given as the first argument
+int main(int argc, char** argv){
+
+    string dir = argc>1 ? string(argv[1])+"/" : "";
+    bool ok = check(dir+"codegen_class", codegen_class::encode, codegen_class::forward, codegen_class::classify_row,
+        [](MLPNetwork& net, ScoringSpec& spec, Entry& e, const char* label){
+            return net.classify(e, spec.getMeta().get_class_values())==label;
+        });
+
+    ok = check(dir+"codegen_reg", codegen_reg::encode, codegen_reg::forward, codegen_reg::predict_row,
+        [](MLPNetwork& net, ScoringSpec&, Entry& e, double value){
+            double expected = net.predict(e);
+            return fabs(expected-value)<=OUTPUT_TOLERANCE*max(1.0, fabs(expected));
+        }) && ok;
+
+    if(!ok) return 1;
+    cout<<"generated headers agree with MLPNetwork"<<endl;
+    return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * Filename: compact_test.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a test that loads the same classification and regression files with ARFFDataset and
+ * CompactARFFDataset and fails unless every getEntry decodes to the dense entry (up to the float the record stores), before
+ * and after replacing missing values and normalizing, and unless getEntry decodes rows without allocating.
+ */
+
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cmath>
+#include <iomanip>
+
+#define CLASS "class"
+#include "../CompactDataset.h"
+
+using namespace std;
+
+//glibc's own entry points, so the replaced operators don't look like a malloc/delete mismatch to the compiler
+extern "C" void* __libc_malloc(size_t);
+extern "C" void __libc_free(void*);
+
+//operator new calls while counting is on
+static atomic<long> allocations(0);
+static atomic<bool> counting(false);
+
+void* operator new(size_t n){
+    if(counting.load(memory_order_relaxed)) allocations.fetch_add(1, memory_order_relaxed);
+    void* p = __libc_malloc(n>0 ? n : 1);
+    if(!p) throw bad_alloc();
+    return p;
+}
+void* operator new[](size_t n){return operator new(n);}
+void operator delete(void* p) noexcept {__libc_free(p);}
+void operator delete[](void* p) noexcept {__libc_free(p);}
+void operator delete(void* p, size_t) noexcept {__libc_free(p);}
+void operator delete[](void* p, size_t) noexcept {__libc_free(p);}
+
+static const char* COLORS[] = {"red", "green", "blue"};
+//longer than a string's inline buffer, so copying a label out by value would allocate
+static const char* CLASSES[] = {"below_one_threshold", "between_the_thresholds", "above_the_upper_threshold"};
+
+//numeric, categorical and hashed attributes with a few missing values, the class is categorical or numeric
+static void write_arff(const string& filename, bool regression, int rows){
+    ofstream out(filename.c_str());
+    out<<"@relation compact_test\n@attribute x1 numeric\n@attribute color {red,green,blue}\n@attribute x2 numeric\n";
+    out<<"@attribute zip {10000,10001,10002}\n";
+    out<<(regression ? "@attribute class numeric\n" : "@attribute class {below_one_threshold,between_the_thresholds,"
+        "above_the_upper_threshold}\n")<<"@data\n";
+    CounterRNG rng(32, RNG_SYNTHETIC, regression);
+    for(int r=0;r<rows;r++){
+        double x1 = rng.normal(4*r)*100+3, x2 = rng.uniform(4*r+1, -1, 1);
+        int color = (int)rng.below(4*r+2, 3);
+        out<<(r%7==0 ? string("?") : to_string(x1))<<","<<(r%11==0 ? "?" : COLORS[color])<<","<<x2<<",";
+        out<<(r%13==0 ? string("?") : to_string(10000+rng.below(4*r+3, 300)))<<",";
+        double signal = x1/100+x2+color;
+        //more digits than a float holds, the class label of a row has to keep all the float's digits
+        if(regression) out<<setprecision(12)<<signal*1234.5678<<setprecision(6)<<"\n";
+        else out<<CLASSES[signal<1 ? 0 : signal<2.5 ? 1 : 2]<<"\n";
+    }
+}
+
+static bool close_to(double expected, double actual, double tolerance){
+    if(isnan(expected) || isnan(actual)) return isnan(expected) && isnan(actual);
+    return fabs(expected-actual)<=tolerance*max(1.0, fabs(expected));
+}
+
+//compares every row, the records store floats so values only have to agree to float precision
+static long compare(const string& name, ARFFDataset& dense, CompactARFFDataset& compact, double tolerance){
+    int in_size = dense.getMeta().get_input_layer_size(), out_size = dense.getMeta().get_output_layer_size();
+    bool regression = out_size==1;
+    Entry scratch(in_size, out_size);
+    long mismatches = compact.getSize()==dense.getSize() ? 0 : max(1L, dense.getSize());
+    for(long i=0;i<min(dense.getSize(), compact.getSize());i++){
+        Entry& expected = dense.getData()[i];
+        Entry& actual = compact.getEntry(i, scratch);
+        bool ok = true;
+        for(int k=0;k<in_size;k++) ok = ok && close_to(expected.data[k], actual.data[k], tolerance);
+        for(int k=0;k<out_size;k++) ok = ok && close_to(expected.expected[k], actual.expected[k], tolerance);
+        //a numeric class reads back as the float the record holds, the dense label as the value in the file
+        if(regression) ok = ok && stof(actual.getClass())==(float)actual.expected[0] && stof(expected.getClass())==stof(actual.getClass());
+        else ok = ok && actual.getClass()==expected.getClass();
+        ok = ok && compact.getEntryClass(i)==actual.getClass();
+        if(!ok) mismatches++;
+    }
+
+    //decoding every row again with the same scratch entry must not allocate
+    counting=true;
+    allocations=0;
+    for(long i=0;i<compact.getSize();i++) compact.getEntry(i, scratch);
+    counting=false;
+
+    cout<<(mismatches==0 && allocations==0 ? "ok   " : "FAIL ")<<name<<": "<<dense.getSize()<<" rows, "<<mismatches<<" differ, "
+        <<allocations<<" allocations decoding them"<<endl;
+    return mismatches+allocations;
+}
+
+static long check(const string& filename, bool regression){
+    string name = regression ? "regression" : "classification";
+    write_arff(filename, regression, 3000);
+
+    ARFFDataset dense;
+    dense.getMeta().setHashBuckets("zip", 16);
+    ARFFDataset::loadARFF(filename, dense);
+    CompactARFFDataset compact;
+    compact.getMeta().setHashBuckets("zip", 16);
+    CompactARFFDataset::loadARFF(filename, compact);
+
+    long failures = compare(name+" loaded", dense, compact, 1e-7);
+    CompactARFFDataset copied(dense);
+    failures += compare(name+" copied from ARFFDataset", dense, copied, 1e-7);
+
+    //the means and standard deviations are computed in double from the stored floats
+    dense.replaceMissingValues();
+    compact.replaceMissingValues();
+    failures += compare(name+" missing values replaced", dense, compact, 1e-6);
+    dense.normalize();
+    compact.normalize();
+    failures += compare(name+" normalized", dense, compact, 1e-5);
+    return failures;
+}
+
+//writes its files to the directory given as the first argument
+int main(int argc, char** argv){
+    string dir = argc>1 ? string(argv[1])+"/" : "";
+    long failures = check(dir+"compact_class.arff", false);
+    failures += check(dir+"compact_reg.arff", true);
+    if(failures>0) return 1;
+    cout<<"CompactARFFDataset agrees with ARFFDataset"<<endl;
+    return 0;
+}
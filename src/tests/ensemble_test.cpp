@@ -0,0 +1,85 @@
+/*
+ * Filename: ensemble_test.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a test that checks MLPEnsemble::forward_batch against the average of its members'
+ * forward_batch and reports its speed against scoring the members one after the other.
+ */
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <memory>
+
+#include "../Ensemble.h"
+
+using namespace std;
+
+#define OUTPUT_TOLERANCE 1e-12
+
+//seconds per call of f, best of a few repetitions
+template<class F>
+static double time_call(int iterations, const F& f){
+    double best = numeric_limits<double>::infinity();
+    for(int rep=0;rep<5;rep++){
+        auto start = chrono::steady_clock::now();
+        for(int i=0;i<iterations;i++) f();
+        best = min(best, chrono::duration<double>(chrono::steady_clock::now()-start).count()/iterations);
+    }
+    return best;
+}
+
+static bool check(const string& name, const vector<int>& topology, Network::ACTIVATION activation, int num_members, int rows){
+
+    vector<unique_ptr<MLPNetwork>> members;
+    MLPEnsemble ensemble;
+    for(int k=0;k<num_members;k++){
+        members.emplace_back(new MLPNetwork(topology, 0.1, activation, 100+k));
+        ensemble.add(*members.back());
+    }
+
+    int in_size = topology.front(), out_size = topology.back();
+    CounterRNG rng(37, RNG_SYNTHETIC);
+    vector<double> inputs((long)rows*in_size);
+    for(long i=0;i<(long)inputs.size();i++) inputs[i] = rng.normal(i);
+
+    //the average of the members' own forward_batch
+    vector<double> expected((long)rows*out_size, 0), member_out((long)rows*out_size), actual((long)rows*out_size);
+    for(auto& m : members){
+        m->forward_batch(inputs.data(), rows, member_out.data());
+        for(long j=0;j<(long)expected.size();j++) expected[j]+=member_out[j]/num_members;
+    }
+    MLPEnsemble::Workspace ws(ensemble, rows);
+    ensemble.forward_batch(inputs.data(), rows, actual.data(), ws);
+
+    double max_error=0;
+    for(long j=0;j<(long)expected.size();j++) max_error = max(max_error, fabs(expected[j]-actual[j])/max(1.0, fabs(expected[j])));
+    bool ok = max_error<=OUTPUT_TOLERANCE;
+
+    double separate = time_call(20, [&]{
+        for(auto& m : members) m->forward_batch(inputs.data(), rows, member_out.data());
+    });
+    double stacked = time_call(20, [&]{ensemble.forward_batch(inputs.data(), rows, actual.data(), ws);});
+
+    cout<<(ok ? "ok   " : "FAIL ")<<name<<": "<<num_members<<" members, "<<rows<<" rows, max error "<<max_error
+        <<", ensemble "<<stacked*1e3<<"ms against "<<separate*1e3<<"ms for separate passes ("<<separate/stacked<<"x)"<<endl;
+    return ok;
+}
+
+int main(){
+    //the fold models of a 10 fold cross validation on letter with one hidden layer of 64
+    bool ok = check("letter", {16, 64, 26}, Network::TANH, 10, 256);
+    ok = check("letter single row", {16, 64, 26}, Network::TANH, 10, 1) && ok;
+    ok = check("classification", {64, 128, 64, 10}, Network::TANH, 10, 512) && ok;
+    ok = check("regression", {64, 128, 64, 1}, Network::RELU, 5, 512) && ok;
+    //a wide first layer, where stacking it into one GEMM matters most
+    ok = check("wide inputs", {1024, 64, 10}, Network::LOGISTIC, 10, 512) && ok;
+    ok = check("single row", {64, 128, 64, 10}, Network::TANH, 10, 1) && ok;
+    if(!ok) return 1;
+    cout<<"ensemble outputs agree with the members' average"<<endl;
+    return 0;
+}
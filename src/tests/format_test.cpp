@@ -0,0 +1,99 @@
+/*
+ * Filename: format_test.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a fuzz test comparing ARFFRowWriter::formatDouble with snprintf("%g") on millions of values:
+ * random magnitudes over the whole double range, values next to every rounding boundary of six significant digits, integers,
+ * signed zeros, infinities and subnormals.
+ */
+
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <limits>
+
+#define CLASS "class"
+#include "../Dataset.h"
+
+using namespace std;
+
+static long compared=0, failures=0;
+
+static void check(double x){
+    char expected[64], actual[64];
+    snprintf(expected, sizeof(expected), "%g", x);
+    *ARFFRowWriter::formatDouble(x, actual) = '\0';
+    compared++;
+    if(strcmp(expected, actual)!=0){
+        if(failures<20) printf("FAIL %.17g: \"%s\" instead of \"%s\"\n", x, actual, expected);
+        failures++;
+    }
+}
+
+//x, its neighbours one and two ulp away and the negated values
+static void check_around(double x){
+    double below = nextafter(x, 0.0), above = nextafter(x, numeric_limits<double>::infinity());
+    double values[] = {x, below, above, nextafter(below, 0.0), nextafter(above, numeric_limits<double>::infinity())};
+    for(double v : values){
+        check(v);
+        check(-v);
+    }
+}
+
+int main(){
+
+    CounterRNG rng(38, RNG_SYNTHETIC);
+    uint64_t draw=0;
+
+    //random 17 digit values at every exponent formatDouble handles itself and a few beyond
+    for(long i=0;i<1000000;i++){
+        int e = (int)rng.below(draw++, 2*ARFFRowWriter::FORMAT_MAX_EXP+11)-ARFFRowWriter::FORMAT_MAX_EXP-5;
+        double mantissa = rng.uniform(draw++)*9+1;
+        int sign = rng.below(draw++, 2) ? 1 : -1;
+        check(mantissa*pow(10.0, e)*sign);
+    }
+
+    //the rounding boundaries: d.ddddd5 x 10^e for random digits, where the sixth digit rounds up or down, and the values
+    //just below the next power of ten, where rounding carries into a seventh digit and the exponent moves
+    for(long i=0;i<200000;i++){
+        int e = (int)rng.below(draw++, 2*ARFFRowWriter::FORMAT_MAX_EXP-9)-ARFFRowWriter::FORMAT_MAX_EXP+5;
+        long digits = 100000+(long)rng.below(draw++, 900000);
+        check_around((digits+0.5)*pow(10.0, e-5));
+    }
+    for(int e=-ARFFRowWriter::FORMAT_MAX_EXP;e<=ARFFRowWriter::FORMAT_MAX_EXP;e++){
+        double p = pow(10.0, e);
+        check_around(p);
+        check_around(p*(1-0.5e-6));
+        check_around(p*(1-0.5e-7));
+        check_around(p*9.999995);
+        check_around(p*9.9999949999999997);
+        check_around(p*0.999995);
+    }
+    check(99999.949999999997);
+
+    //integers, short decimals and the special values
+    for(long i=-100000;i<=100000;i++){
+        check((double)i);
+        check(i/1000.0);
+    }
+    double specials[] = {0.0, -0.0, numeric_limits<double>::infinity(), -numeric_limits<double>::infinity(),
+                         numeric_limits<double>::min(), numeric_limits<double>::denorm_min(), numeric_limits<double>::max(), 1e-5, 1e-4, 1e6};
+    for(double x : specials){
+        check(x);
+        check(-x);
+    }
+
+    char missing[8];
+    *ARFFRowWriter::formatDouble(NAN, missing) = '\0';
+    if(strcmp(missing, NUM_MISSING_VAL)!=0){
+        printf("FAIL NaN: \"%s\" instead of \"%s\"\n", missing, NUM_MISSING_VAL);
+        failures++;
+    }
+
+    printf("%s %ld values compared with %%g, %ld differ\n", failures==0 ? "ok  " : "FAIL", compared, failures);
+    return failures==0 ? 0 : 1;
+}
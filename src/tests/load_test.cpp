@@ -0,0 +1,81 @@
+/*
+ * Filename: load_test.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a test that loads the same file with loadARFF and with loadARFFParallel for several block
+ * sizes and thread counts, including blocks shorter than a line and a file without a final newline, and fails unless both
+ * give the same rows in the same order.
+ */
+
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#define CLASS "class"
+#include "../Dataset.h"
+
+using namespace std;
+
+static const char* COLORS[] = {"red", "green", "blue"};
+
+//rows of very different lengths, a few with missing values or a carriage return, and a few empty lines
+static void write_arff(const string& filename, int rows){
+    ofstream out(filename.c_str(), ios::binary);
+    out<<"@relation load_test\n@attribute x1 numeric\n@attribute color {red,green,blue}\n@attribute x2 numeric\n";
+    out<<"@attribute class {a,b}\n@data\n";
+    CounterRNG rng(28, RNG_SYNTHETIC);
+    for(int r=0;r<rows;r++){
+        string x1 = r%11==0 ? "?" : to_string(rng.normal(3*r)*1000);
+        //a long run of digits makes some lines longer than the small blocks
+        if(r%97==0 && r%11!=0) x1 += string(200, '0');
+        out<<x1<<","<<(r%13==0 ? "?" : COLORS[rng.below(3*r+1, 3)])<<","<<rng.uniform(3*r+2)<<",";
+        out<<(rng.uniform(3*r+2)<0.5 ? "a" : "b")<<(r%17==0 ? "\r" : "")<<(r+1<rows ? "\n" : "");
+        if(r%50==0) out<<"\n";
+    }
+}
+
+static bool same(double a, double b){return a==b || (isnan(a) && isnan(b));}
+
+static long compare(ARFFDataset& expected, ARFFDataset& actual){
+    if(expected.getSize()!=actual.getSize()) return max(1L, expected.getSize());
+    long mismatches=0;
+    for(long i=0;i<expected.getSize();i++){
+        Entry& e = expected.getData()[i];
+        Entry& a = actual.getData()[i];
+        bool ok = e.getClass()==a.getClass() && e.get_data_size()==a.get_data_size();
+        for(int k=0;ok && k<e.get_data_size();k++) ok = same(e.data[k], a.data[k]);
+        for(int k=0;ok && k<e.get_expected_size();k++) ok = same(e.expected[k], a.expected[k]);
+        if(!ok) mismatches++;
+    }
+    return mismatches;
+}
+
+//writes its file to the directory given as the first argument
+int main(int argc, char** argv){
+
+    string dir = argc>1 ? string(argv[1])+"/" : "";
+    string filename = dir+"load_test.arff";
+    write_arff(filename, 3000);
+
+    ARFFDataset expected;
+    ARFFDataset::loadARFF(filename, expected);
+
+    long failures=0;
+    for(size_t block_bytes : {(size_t)1, (size_t)64, (size_t)4096, (size_t)LOAD_BLOCK}){
+        for(int num_threads : {1, 3}){
+            ARFFDataset actual;
+            ARFFDataset::loadARFFParallel(filename, actual, num_threads, block_bytes);
+            long mismatches = compare(expected, actual);
+            cout<<(mismatches==0 ? "ok   " : "FAIL ")<<block_bytes<<" byte blocks on "<<num_threads<<" threads: "<<actual.getSize()
+                <<" rows, "<<mismatches<<" differ"<<endl;
+            failures+=mismatches;
+        }
+    }
+    if(failures>0) return 1;
+    cout<<"loadARFFParallel agrees with loadARFF"<<endl;
+    return 0;
+}
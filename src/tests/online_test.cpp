@@ -0,0 +1,147 @@
+/*
+ * Filename: online_test.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a test that appends two deltas with missing values and shifted statistics to a normalized
+ * dataset with OnlineTrainer and fails unless every row of the history, mapped to the current normalization, is its raw row
+ * with missing values imputed from the statistics at the time it was appended and normalized with the final transform, and
+ * unless the network still computes the same function of the raw rows.
+ */
+
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <cmath>
+
+#define CLASS "class"
+#include "../Online.h"
+
+using namespace std;
+
+#define TOLERANCE 1e-9
+
+static const char* COLORS[] = {"red", "green", "blue"};
+
+//segment s moves x1 by 50*s and makes color s the most common one, deltas have missing values
+static void write_arff(const string& filename, int segment, int rows){
+    ofstream out(filename.c_str());
+    out<<"@relation online_test\n@attribute x1 numeric\n@attribute color {red,green,blue}\n@attribute x2 numeric\n";
+    out<<"@attribute class numeric\n@data\n";
+    CounterRNG rng(31, RNG_SYNTHETIC, segment);
+    for(int r=0;r<rows;r++){
+        double x1 = rng.normal(4*r)*100+50*segment, x2 = rng.uniform(4*r+1, -1, 1)*(1+segment);
+        int color = rng.uniform(4*r+2)<0.7 ? segment : (int)rng.below(4*r+2, 3);
+        bool missing = segment>0;
+        out<<(missing && r%7==0 ? string("?") : to_string(x1))<<","<<(missing && r%5==0 ? "?" : COLORS[color])<<",";
+        out<<(missing && r%9==0 ? string("?") : to_string(x2))<<","<<x1/100+x2+color<<"\n";
+    }
+}
+
+static bool close_to(double expected, double actual){
+    return fabs(expected-actual)<=TOLERANCE*max(1.0, fabs(expected));
+}
+
+int main(int argc, char** argv){
+
+    string dir = argc>1 ? string(argv[1])+"/" : "";
+    const int NUM_SEGMENTS = 3;
+    const int ROWS[NUM_SEGMENTS] = {400, 150, 150};
+
+    //every segment loaded once more and left raw, the reference
+    vector<ARFFDataset> raw(NUM_SEGMENTS);
+    for(int s=0;s<NUM_SEGMENTS;s++){
+        string filename = dir+"online_"+to_string(s)+".arff";
+        write_arff(filename, s, ROWS[s]);
+        ARFFDataset::loadARFF(filename, raw[s]);
+    }
+
+    ARFFDataset data;
+    ARFFDataset::loadARFF(dir+"online_0.arff", data);
+    data.normalize();
+    NormalizationStats first = data.getNormalization();
+
+    //the same network twice, reference keeps the first normalization
+    vector<int> hidden = {8};
+    MLPNetwork net(hidden, data.getMeta(), 0.01, Network::TANH, 7);
+    MLPNetwork reference(hidden, data.getMeta(), 0.01, Network::TANH, 7);
+
+    OnlineTrainer trainer(data, net);
+    for(int s=1;s<NUM_SEGMENTS;s++){
+        ARFFDataset delta;
+        ARFFDataset::loadARFF(dir+"online_"+to_string(s)+".arff", delta);
+        trainer.update(delta, 0);
+    }
+
+    ARFFMetaData& meta = data.getMeta();
+    const vector<int>& numeric = first.get_indices();
+    vector<tuple<int, int>> blocks;
+    for(Attribute& a : meta.getAttributes()){
+        if(a.getType()==CATEGORICAL && a.getLabel()!=CLASSLABEL) blocks.push_back(meta.calcCategoricalIndexRange(a.getLabel()));
+    }
+
+    //imputed raw rows: missing numeric values become the mean and categorical ones the mode of the segments so far
+    vector<vector<double>> rows;
+    vector<double> sums(numeric.size(), 0);
+    vector<long> counts(numeric.size(), 0);
+    vector<vector<long>> value_counts;
+    for(auto& b : blocks) value_counts.push_back(vector<long>(get<1>(b)-get<0>(b), 0));
+    for(int s=0;s<NUM_SEGMENTS;s++){
+        for(Entry& e : raw[s].getData()){
+            for(int i=0;i<(int)numeric.size();i++) if(!isnan(e.data[numeric[i]])){sums[i]+=e.data[numeric[i]]; counts[i]++;}
+            for(int b=0;b<(int)blocks.size();b++){
+                for(int k=get<0>(blocks[b]);k<get<1>(blocks[b]);k++) if(e.data[k]==1) value_counts[b][k-get<0>(blocks[b])]++;
+            }
+        }
+        for(Entry& e : raw[s].getData()){
+            vector<double> row(e.data, e.data+e.get_data_size());
+            for(int i=0;i<(int)numeric.size();i++) if(isnan(row[numeric[i]])) row[numeric[i]] = sums[i]/counts[i];
+            for(int b=0;b<(int)blocks.size();b++){
+                if(!e.isMissing(get<0>(blocks[b]), get<1>(blocks[b]))) continue;
+                int mode = (int)(max_element(value_counts[b].begin(), value_counts[b].end())-value_counts[b].begin());
+                row[get<0>(blocks[b])+mode] = 1;
+            }
+            rows.push_back(row);
+        }
+    }
+
+    //the final transform is the z-score of every value that isn't missing
+    vector<double> mean(numeric.size()), std(numeric.size(), 0);
+    for(int i=0;i<(int)numeric.size();i++) mean[i] = sums[i]/counts[i];
+    for(int s=0;s<NUM_SEGMENTS;s++){
+        for(Entry& e : raw[s].getData()){
+            for(int i=0;i<(int)numeric.size();i++){
+                double x = e.data[numeric[i]];
+                if(!isnan(x)) std[i] += (x-mean[i])*(x-mean[i])/counts[i];
+            }
+        }
+    }
+    for(int i=0;i<(int)numeric.size();i++) std[i] = sqrt(std[i]);
+
+    long wrong_rows=0, wrong_outputs=0;
+    Entry scratch(meta.get_input_layer_size(), meta.get_output_layer_size());
+    Entry original(meta.get_input_layer_size(), meta.get_output_layer_size());
+    for(long r=0;r<(long)rows.size();r++){
+        Entry& e = trainer.getEntry(r, scratch);
+        vector<double> expected = rows[r];
+        for(int i=0;i<(int)numeric.size();i++) expected[numeric[i]] = (expected[numeric[i]]-mean[i])/std[i];
+        bool ok = true;
+        for(int k=0;k<e.get_data_size();k++) ok = ok && close_to(expected[k], e.data[k]);
+        if(!ok) wrong_rows++;
+
+        //the network moved onto the new transform computes what it did on the first one
+        copy(rows[r].begin(), rows[r].end(), original.data);
+        first.apply(original.data);
+        if(!close_to(reference.predict(original), net.predict(e))) wrong_outputs++;
+    }
+
+    cout<<(wrong_rows==0 ? "ok   " : "FAIL ")<<rows.size()<<" rows in "<<NUM_SEGMENTS<<" segments, "<<wrong_rows
+        <<" differ from the imputed raw rows under the final normalization"<<endl;
+    cout<<(wrong_outputs==0 ? "ok   " : "FAIL ")<<wrong_outputs<<" network outputs changed by the new normalization"<<endl;
+    if(wrong_rows+wrong_outputs>0) return 1;
+    cout<<"OnlineTrainer maps the history to the current normalization"<<endl;
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Filename: sparse_test.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ *
+ * Description: This file contains a test that writes the same rows once as dense and once as sparse {index value} ARFF,
+ * loads them with ARFFDataset and SparseARFFDataset and fails unless every getEntry encodes the same inputs, targets and
+ * class, before and after replacing the missing values.
+ */
+
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#define CLASS "class"
+#include "../SparseDataset.h"
+
+using namespace std;
+
+static const char* COLORS[] = {"red", "green", "blue"};
+static const char* CLASSES[] = {"a", "b", "c"};
+
+static const char* HEADER =
+    "@relation sparse_test\n"
+    "@attribute x1 numeric\n@attribute x2 numeric\n@attribute color {red,green,blue}\n"
+    "@attribute zip {10000,10001,10002}\n@attribute x3 numeric\n@attribute class {a,b,c}\n@data\n";
+
+//one row as its field values, most numeric values are zero and most colors the first one so the sparse rows omit them,
+//the zip codes are drawn from more values than the header lists (the attribute is hashed) and a few values are missing
+static vector<string> row(int r){
+    CounterRNG rng(39, RNG_SYNTHETIC);
+    vector<string> fields;
+    for(int k=0;k<6;k++){
+        uint64_t draw = 8*(uint64_t)r+k;
+        ostringstream os;
+        if(k==0 || k==1 || k==4){
+            if(rng.uniform(draw)<0.6) os<<0;
+            else if(rng.uniform(draw+100000000)<0.05) os<<"?";
+            else os<<rng.normal(draw)*3;
+        }
+        else if(k==2) os<<(rng.uniform(draw)<0.05 ? "?" : COLORS[rng.uniform(draw+1)<0.6 ? 0 : rng.below(draw, 3)]);
+        else if(k==3) os<<(r%17==0 ? "?" : to_string(10000+rng.below(draw, 40)));
+        else os<<CLASSES[rng.below(draw, 3)];
+        fields.push_back(os.str());
+    }
+    return fields;
+}
+
+static void write_files(const string& dense_file, const string& sparse_file, int rows){
+    ofstream dense(dense_file.c_str()), sparse(sparse_file.c_str());
+    dense<<HEADER;
+    sparse<<HEADER;
+    for(int r=0;r<rows;r++){
+        vector<string> fields = row(r);
+        bool first=true;
+        sparse<<"{";
+        for(int k=0;k<(int)fields.size();k++){
+            dense<<(k ? "," : "")<<fields[k];
+            //the implicit values: zero for numeric attributes, the first listed value for nominal ones
+            if(fields[k]=="0" || fields[k]=="red" || fields[k]=="10000" || fields[k]=="a") continue;
+            sparse<<(first ? "" : ", ")<<k<<" "<<fields[k];
+            first=false;
+        }
+        dense<<"\n";
+        sparse<<"}\n";
+    }
+}
+
+static bool same(double a, double b){return a==b || (isnan(a) && isnan(b));}
+
+//compares every row of both datasets, returns the number of rows that differ
+static long compare(const string& name, ARFFDataset& dense, SparseARFFDataset& sparse){
+    long mismatches=0;
+    int in_size = dense.getMeta().get_input_layer_size(), out_size = dense.getMeta().get_output_layer_size();
+    Entry scratch(in_size, out_size), d(in_size, out_size);
+    vector<double> row(in_size);
+    if(sparse.getSize()!=dense.getSize()) mismatches = max(1L, dense.getSize());
+    for(long i=0;i<min(dense.getSize(), sparse.getSize());i++){
+        Entry& expected = dense.getEntry(i, d);
+        Entry& actual = sparse.getEntry(i, scratch);
+        fill(row.begin(), row.end(), 0.0);
+        for(int k=0;k<actual.nnz;k++) row[actual.sparse_indices[k]] = actual.sparse_values[k];
+        bool ok = actual.isSparse() && actual.getClass()==expected.getClass();
+        for(int k=0;k<in_size;k++) ok = ok && same(row[k], expected.data[k]);
+        for(int k=0;k<out_size;k++) ok = ok && same(actual.expected[k], expected.expected[k]);
+        if(!ok) mismatches++;
+    }
+    cout<<(mismatches==0 ? "ok   " : "FAIL ")<<name<<": "<<dense.getSize()<<" rows, "<<mismatches<<" differ"<<endl;
+    return mismatches;
+}
+
+//writes its files to the directory given as the first argument
+int main(int argc, char** argv){
+
+    string dir = argc>1 ? string(argv[1])+"/" : "";
+    string dense_file = dir+"sparse_dense.arff", sparse_file = dir+"sparse_sparse.arff";
+    write_files(dense_file, sparse_file, 2000);
+
+    ARFFDataset dense;
+    dense.getMeta().setHashBuckets("zip", 8);
+    ARFFDataset::loadARFF(dense_file, dense);
+    SparseARFFDataset sparse;
+    sparse.getMeta().setHashBuckets("zip", 8);
+    SparseARFFDataset::loadARFF(sparse_file, sparse);
+
+    long failures = compare("sparse rows", dense, sparse);
+
+    //the dense rows of the same file go through ARFFDataset's encoder
+    SparseARFFDataset from_dense;
+    from_dense.getMeta().setHashBuckets("zip", 8);
+    SparseARFFDataset::loadARFF(dense_file, from_dense);
+    failures += compare("dense rows", dense, from_dense);
+
+    dense.replaceMissingValues();
+    sparse.replaceMissingValues();
+    failures += compare("missing values replaced", dense, sparse);
+
+    if(failures>0) return 1;
+    cout<<"SparseARFFDataset agrees with ARFFDataset"<<endl;
+    return 0;
+}
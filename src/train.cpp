@@ -0,0 +1,83 @@
+/*
+ * Filename: train.cpp
+ * Created Date: 10/19/26
+ * Author: Harrison Paas
+ * 
+ * Description: This file contains a small command line tool that trains an MLP network on a whole ARFF file and saves it, with its preprocessing, for the inference server and the scoring tool.
+ */
+
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <sstream>
+
+#ifndef CLASS
+#define CLASS "class"
+#endif
+#include "Scoring.h"
+
+using namespace std;
+
+int main(int argc, char** argv){
+    
+    if(argc<3){
+        cerr<<"usage: "<<argv[0]<<" data.arff model.bin [num_epochs] [learningrate] [hidden layer sizes...]\n";
+        return 1;
+    }
+    
+    string filename = argv[1];
+    string modelfile = argv[2];
+    int num_epochs = argc>3 ? atoi(argv[3]) : 10;
+    double learningrate = argc>4 ? atof(argv[4]) : 0.1;
+    vector<int> hidden_layer_sizes;
+    for(int i=5;i<argc;i++) hidden_layer_sizes.push_back(atoi(argv[i]));
+    if(hidden_layer_sizes.empty()) hidden_layer_sizes = {100, 100};
+    
+    ARFFDataset data;
+    ARFFDataset::loadARFF(filename, data);
+    
+    data.replaceMissingValuesByClass();
+    data.normalize();
+    data.shuffle();
+    
+    MLPNetwork net(hidden_layer_sizes, data.getMeta(), learningrate, Network::LOGISTIC);
+    
+    //every epoch is checkpointed to model.bin.ckpt in the background, a rerun after a crash continues from the last one
+    Checkpointer checkpointer(modelfile+".ckpt");
+    TrainingState state;
+    int first_epoch=0;
+    if(checkpointer.load(state) && state.num_epochs==num_epochs){
+        istringstream model(string(state.model.begin(), state.model.end()));
+        net.restore(model);
+        first_epoch = state.epoch;
+        cout<<"resuming from epoch "<<first_epoch<<endl;
+    }
+    
+    for(int i=first_epoch;i<num_epochs;i++){
+        for(Entry& e : data.getData()) net.train(e);
+        
+        TrainingState& s = checkpointer.begin_snapshot();
+        s.num_folds=1;
+        s.random_state=0;
+        s.num_epochs=num_epochs;
+        s.fold=0;
+        s.epoch=i+1;
+        s.model.clear();
+        VectorStreamBuf buf(s.model);
+        ostream model(&buf);
+        net.save(model);
+        checkpointer.commit_snapshot(s);
+    }
+    
+    net.save(modelfile);
+    checkpointer.wait();
+    remove((modelfile+".ckpt").c_str());
+    
+    //the header and normalization score.out needs to turn raw rows into inputs for this model
+    ScoringSpec(data).save(modelfile+".prep");
+    cout<<"saved "<<modelfile<<" ("<<net.get_input_size()<<" inputs, "<<net.get_output_size()<<" outputs) and "<<modelfile<<".prep"<<endl;
+    
+    return 0;
+}